@@ -109,7 +109,7 @@ int Application::Run(int argc, char* argv[])
 	rs_desc.cull_mode = CullMode::NONE;
 	rs_desc.fill_mode = FillMode::SOLID;
 	rs_desc.front_winding_ccw = true;
-	rs_desc.multisample = true;
+	rs_desc.multisample = false;
 	rs_desc.scissor = false;
 
 	m_rs = m_device.create_rasterizer_state(rs_desc);
@@ -145,7 +145,7 @@ int Application::Run(int argc, char* argv[])
 
 	InputElement elements[] =
 	{
-		{ 3, DataType::FLOAT, false, 0, "POSITION" }
+		{ 3, DataType::FLOAT, false, 0, "POSITION", 0 }
 	};
 
 	memset(&ilcd, 0, sizeof(InputLayoutCreateDesc));
@@ -169,6 +169,22 @@ int Application::Run(int argc, char* argv[])
 
 	SDL_GL_GetDrawableSize(m_Window, &m_width, &m_height);
 
+	// Scaled blits can't target a multisampled default framebuffer, so the scene resolution is
+	// traded against GPU time instead of paying for MSAA at a fixed size.
+	DynamicResolutionDesc dr_desc;
+	dr_desc.width = m_width;
+	dr_desc.height = m_height;
+	dr_desc.color_format = TextureFormat::R8G8B8A8_UNORM;
+	dr_desc.depth_format = TextureFormat::D24_FLOAT_S8_UINT;
+	dr_desc.target_frame_ms = 1000.0f / 120.0f;
+	dr_desc.min_scale = 0.5f;
+	dr_desc.max_scale = 1.0f;
+
+	if (!m_resolution.init(&m_device, dr_desc))
+	{
+		return false;
+	}
+
 #if defined(TE_PLATFORM_EMSCRIPTEN)
     emscripten_set_main_loop_arg(ApplicationFrame, this, 0, 1);
 #elif defined(TE_PLATFORM_IPHONE)
@@ -191,8 +207,8 @@ void Application::Frame()
 {
     EventLoop();
 
-	m_device.bind_framebuffer(nullptr);
-	m_device.set_viewport(m_width, m_height, 0, 0);
+	m_device.begin_frame();
+	m_resolution.begin_scene();
 
 	float clear[] = { 0.0f, 0.0f, 0.0f, 1.0f };
 	m_device.clear_framebuffer(ClearTarget::ALL, clear);
@@ -205,6 +221,9 @@ void Application::Frame()
 	m_device.set_primitive_type(PrimitiveType::TRIANGLES);
 	m_device.draw(0, 3);
 
+	m_resolution.end_scene();
+	m_resolution.present(nullptr);
+
 	SDL_GL_SwapWindow(m_Window);
 }
 
@@ -215,9 +234,6 @@ bool Application::Init()
 	if (SDL_Init(flags) != 0)
 		return false;
 
-	SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
-	SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 8);
-  
     m_Window = SDL_CreateWindow("Application",
                                SDL_WINDOWPOS_CENTERED,
                                SDL_WINDOWPOS_CENTERED,
@@ -234,6 +250,10 @@ bool Application::Init()
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5);
 
+#if defined(GFX_ERROR_CHECK_ASYNC)
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+#endif
+
 	m_context = SDL_GL_CreateContext(m_Window);
 	SDL_GL_MakeCurrent(m_Window, m_context);
 
@@ -243,6 +263,7 @@ bool Application::Init()
 
 void Application::Shutdown()
 {
+	m_resolution.shutdown();
 	SDL_GL_DeleteContext(m_context);
     SDL_DestroyWindow(m_Window);
 }
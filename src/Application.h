@@ -1,4 +1,5 @@
 #include "RenderDevice.h"
+#include "DynamicResolution.h"
 #include <SDL.h>
 #include <SDL_opengl.h>
 
@@ -24,6 +25,7 @@ private:
     
 private:
 	RenderDevice m_device;
+	DynamicResolution m_resolution;
 	int m_width;
 	int m_height;
     bool m_IsRunning;
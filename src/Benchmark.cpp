@@ -0,0 +1,507 @@
+#include "Benchmark.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+
+const char* kBenchmarkVS = R"(layout (location = 0) in vec2 VS_IN_Position;
+
+layout (std140, binding = 0) uniform DrawData
+{
+    vec4 u_Transform;
+    vec4 u_Color;
+};
+
+out vec4 PS_IN_Color;
+
+void main()
+{
+    PS_IN_Color = u_Color;
+    gl_Position = vec4(VS_IN_Position * u_Transform.zw + u_Transform.xy, 0.0, 1.0);
+})";
+
+const char* kBenchmarkFlatFS = R"(in vec4 PS_IN_Color;
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = PS_IN_Color;
+})";
+
+const char* kBenchmarkShadedFS = R"(in vec4 PS_IN_Color;
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = PS_IN_Color * (0.5 + 0.5 * sin(gl_FragCoord.x * 0.1));
+})";
+
+float kQuadVerts[8] = {
+	-1.0f, -1.0f,
+	 1.0f, -1.0f,
+	 1.0f,  1.0f,
+	-1.0f,  1.0f
+};
+
+uint32_t kQuadIndices[6] = { 0, 1, 2, 2, 3, 0 };
+
+struct BenchmarkDrawData
+{
+	float transform[4];
+	float color[4];
+};
+
+static double percentile(const std::vector<double>& sorted, double fraction)
+{
+	size_t index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+	return sorted[index];
+}
+
+static void print_timings(const char* name, std::vector<double> timings)
+{
+	if (timings.empty())
+	{
+		printf("%-4s ms: unavailable\n", name);
+		return;
+	}
+
+	std::sort(timings.begin(), timings.end());
+
+	double sum = 0.0;
+
+	for (size_t i = 0; i < timings.size(); i++)
+		sum += timings[i];
+
+	printf("%-4s ms: min %.3f  avg %.3f  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+		   name,
+		   timings.front(),
+		   sum / timings.size(),
+		   percentile(timings, 0.5),
+		   percentile(timings, 0.95),
+		   percentile(timings, 0.99),
+		   timings.back());
+}
+
+Benchmark::Benchmark() : m_layout(nullptr),
+						 m_vertex_buffer(nullptr),
+						 m_index_buffer(nullptr),
+						 m_vertex_array(nullptr),
+						 m_uniforms(nullptr),
+						 m_color_target(nullptr),
+						 m_depth_target(nullptr),
+						 m_framebuffer(nullptr),
+						 m_timer_index(0),
+						 m_frame(0),
+						 m_state_calls(0),
+						 m_filtered_state_calls(0),
+						 m_draw_calls(0)
+{
+	m_settings.frames = 1000;
+	m_settings.warmup_frames = 60;
+	m_settings.width = 1280;
+	m_settings.height = 720;
+	m_settings.draws = 2000;
+	m_settings.budget_ms = 0.0f;
+
+	memset(&m_programs[0], 0, sizeof(m_programs));
+	memset(&m_shaders[0], 0, sizeof(m_shaders));
+	memset(&m_timers[0], 0, sizeof(m_timers));
+	memset(&m_timer_measured[0], 0, sizeof(m_timer_measured));
+}
+
+Benchmark::~Benchmark()
+{
+
+}
+
+int Benchmark::Run(int argc, char* argv[])
+{
+	if (!ParseArguments(argc, argv))
+		return 1;
+
+	if (!Init())
+	{
+		Shutdown();
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < m_settings.warmup_frames; i++)
+		Frame(false);
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (uint32_t i = 0; i < m_settings.frames; i++)
+		Frame(true);
+
+	// Wait for the GPU so the last timers resolve and the wall time includes all rendering.
+	Fence fence = {};
+	m_device.insert_fence(fence);
+
+	while (!m_device.fence_signaled(fence))
+		;
+
+	auto end = std::chrono::high_resolution_clock::now();
+	ReadTimers();
+
+	double seconds = std::chrono::duration<double>(end - start).count();
+	printf("wall    : %.3f s, %.1f fps\n", seconds, m_settings.frames / seconds);
+
+	int result = Report();
+	Shutdown();
+
+	return result;
+}
+
+bool Benchmark::ParseArguments(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (strcmp(arg, "--help") == 0)
+		{
+			printf("usage: %s [--frames N] [--warmup N] [--width N] [--height N] [--draws N] [--budget-ms MS] [--csv PATH]\n", argv[0]);
+			return false;
+		}
+
+		if (!value)
+		{
+			LOG_ERROR(std::string("Missing value for ") + arg);
+			return false;
+		}
+
+		if (strcmp(arg, "--frames") == 0)
+			m_settings.frames = (uint32_t)atoi(value);
+		else if (strcmp(arg, "--warmup") == 0)
+			m_settings.warmup_frames = (uint32_t)atoi(value);
+		else if (strcmp(arg, "--width") == 0)
+			m_settings.width = (uint32_t)atoi(value);
+		else if (strcmp(arg, "--height") == 0)
+			m_settings.height = (uint32_t)atoi(value);
+		else if (strcmp(arg, "--draws") == 0)
+			m_settings.draws = (uint32_t)atoi(value);
+		else if (strcmp(arg, "--budget-ms") == 0)
+			m_settings.budget_ms = (float)atof(value);
+		else if (strcmp(arg, "--csv") == 0)
+			m_settings.csv_path = value;
+		else
+		{
+			LOG_ERROR(std::string("Unknown argument ") + arg);
+			return false;
+		}
+
+		i++;
+	}
+
+	if (m_settings.frames == 0 || m_settings.width == 0 || m_settings.height == 0 || m_settings.width > UINT16_MAX || m_settings.height > UINT16_MAX)
+	{
+		LOG_ERROR("Invalid benchmark settings");
+		return false;
+	}
+
+	return true;
+}
+
+bool Benchmark::Init()
+{
+	if (!m_context.init(4, 5))
+		return false;
+
+	if (!m_device.init(&HeadlessContext::get_proc_address))
+		return false;
+
+	printf("renderer: %s\n", (const char*)glGetString(GL_RENDERER));
+
+	m_shaders[0] = m_device.create_shader(kBenchmarkVS, ShaderType::VERTEX);
+	m_shaders[1] = m_device.create_shader(kBenchmarkFlatFS, ShaderType::FRAGMENT);
+	m_shaders[2] = m_device.create_shader(kBenchmarkShadedFS, ShaderType::FRAGMENT);
+
+	if (!m_shaders[0] || !m_shaders[1] || !m_shaders[2])
+		return false;
+
+	for (int i = 0; i < 2; i++)
+	{
+		Shader* shaders[] = { m_shaders[0], m_shaders[1 + i] };
+		m_programs[i] = m_device.create_shader_program(shaders, 2);
+
+		if (!m_programs[i])
+			return false;
+	}
+
+	InputElement elements[] =
+	{
+		{ 2, DataType::FLOAT, false, 0, "POSITION", 0 }
+	};
+
+	InputLayoutCreateDesc ilcd = {};
+	ilcd.elements = elements;
+	ilcd.num_elements = 1;
+	ilcd.vertex_size = sizeof(float) * 2;
+
+	m_layout = m_device.create_input_layout(ilcd);
+
+	BufferCreateDesc bc = {};
+	bc.data = &kQuadVerts[0];
+	bc.data_type = DataType::FLOAT;
+	bc.size = sizeof(kQuadVerts);
+	bc.usage_type = BufferUsageType::STATIC;
+
+	m_vertex_buffer = m_device.create_vertex_buffer(bc);
+
+	bc.data = &kQuadIndices[0];
+	bc.data_type = DataType::UINT32;
+	bc.size = sizeof(kQuadIndices);
+
+	m_index_buffer = m_device.create_index_buffer(bc);
+
+	VertexArrayCreateDesc vcd = {};
+	vcd.vertex_buffer = m_vertex_buffer;
+	vcd.index_buffer = m_index_buffer;
+	vcd.layout = m_layout;
+
+	m_vertex_array = m_device.create_vertex_array(vcd);
+
+	UniformRingBufferCreateDesc ucd;
+	ucd.size_per_frame = m_settings.draws * (sizeof(BenchmarkDrawData) + m_device.UniformBufferAlignment());
+	ucd.num_frames = BENCHMARK_FRAMES_IN_FLIGHT;
+
+	m_uniforms = m_device.create_uniform_ring_buffer(ucd);
+
+	if (!m_layout || !m_vertex_buffer || !m_index_buffer || !m_vertex_array || !m_uniforms)
+		return false;
+
+	Texture2DCreateDesc tcd = {};
+	tcd.width = (uint16_t)m_settings.width;
+	tcd.height = (uint16_t)m_settings.height;
+	tcd.format = TextureFormat::R8G8B8A8_UNORM;
+	tcd.create_render_target_view = true;
+	tcd.mipmap_levels = 1;
+
+	m_color_target = m_device.create_texture_2d(tcd);
+
+	tcd.format = TextureFormat::D24_FLOAT_S8_UINT;
+
+	m_depth_target = m_device.create_texture_2d(tcd);
+
+	if (!m_color_target || !m_depth_target)
+		return false;
+
+	FramebufferCreateDesc fcd = {};
+	fcd.num_render_targets = 1;
+	fcd.render_targets[0] = m_color_target;
+	fcd.depth_target = m_depth_target;
+
+	m_framebuffer = m_device.create_framebuffer(fcd);
+
+	if (!m_framebuffer)
+		return false;
+
+	m_cpu_ms.reserve(m_settings.frames);
+	m_gpu_ms.reserve(m_settings.frames);
+
+	return true;
+}
+
+void Benchmark::Shutdown()
+{
+	if (m_framebuffer)
+		m_device.destroy_framebuffer(m_framebuffer);
+	else
+	{
+		if (m_color_target)
+			m_device.destroy_texture(m_color_target);
+
+		if (m_depth_target)
+			m_device.destroy_texture(m_depth_target);
+	}
+
+	if (m_uniforms)
+		m_device.destroy_uniform_ring_buffer(m_uniforms);
+
+	if (m_vertex_array)
+		m_device.destroy_vertex_array(m_vertex_array);
+
+	if (m_index_buffer)
+		m_device.destroy_index_buffer(m_index_buffer);
+
+	if (m_vertex_buffer)
+		m_device.destroy_vertex_buffer(m_vertex_buffer);
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (m_programs[i])
+			m_device.destroy_shader_program(m_programs[i]);
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (m_shaders[i])
+			m_device.destroy_shader(m_shaders[i]);
+	}
+
+	for (int i = 0; i < BENCHMARK_FRAMES_IN_FLIGHT + 1; i++)
+		m_device.release_gpu_timer(m_timers[i]);
+
+	m_framebuffer = nullptr;
+	m_color_target = nullptr;
+	m_depth_target = nullptr;
+	m_uniforms = nullptr;
+	m_vertex_array = nullptr;
+	m_index_buffer = nullptr;
+	m_vertex_buffer = nullptr;
+
+	m_context.shutdown();
+}
+
+// A grid of quads, alternating between two programs, drifting a little every frame so the
+// uniform data has to be rewritten.
+void Benchmark::Frame(bool measure)
+{
+	ReadTimers();
+
+	// Waiting for the GPU to free a uniform region is throttling, not CPU cost, so it is left out.
+	m_device.begin_uniform_ring_frame(m_uniforms);
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_device.begin_frame();
+
+	m_timer_measured[m_timer_index] = measure;
+	m_device.begin_gpu_timer(m_timers[m_timer_index]);
+
+	m_device.bind_framebuffer(m_framebuffer);
+	m_device.set_viewport(m_settings.width, m_settings.height, 0, 0);
+
+	float clear[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	m_device.clear_framebuffer(ClearTarget::ALL, clear);
+
+	m_device.set_primitive_type(PrimitiveType::TRIANGLES);
+
+	uint32_t columns = (uint32_t)ceil(sqrt((double)m_settings.draws));
+	float cell = 2.0f / columns;
+	float drift = 0.25f * cell * (float)sin(m_frame * 0.05);
+
+	m_queue.reset();
+
+	for (uint32_t i = 0; i < m_settings.draws; i++)
+	{
+		size_t offset = 0;
+		BenchmarkDrawData* data = (BenchmarkDrawData*)m_device.allocate_uniform_data(m_uniforms, sizeof(BenchmarkDrawData), &offset);
+
+		if (!data)
+			break;
+
+		uint32_t x = i % columns;
+		uint32_t y = i / columns;
+
+		data->transform[0] = -1.0f + (x + 0.5f) * cell + drift;
+		data->transform[1] = -1.0f + (y + 0.5f) * cell;
+		data->transform[2] = 0.4f * cell;
+		data->transform[3] = 0.4f * cell;
+		data->color[0] = (float)x / columns;
+		data->color[1] = (float)y / columns;
+		data->color[2] = 1.0f;
+		data->color[3] = 1.0f;
+
+		RenderQueueDraw draw = {};
+		draw.program = m_programs[i & 1];
+		draw.vertex_array = m_vertex_array;
+		draw.uniform_buffer = m_uniforms;
+		draw.uniform_slot = 0;
+		draw.uniform_offset = offset;
+		draw.uniform_size = sizeof(BenchmarkDrawData);
+		draw.index_count = 6;
+		draw.material_id = (uint16_t)(i & 1);
+
+		m_queue.push(draw, 0, false, (float)(i % 97) / 97.0f);
+	}
+
+	m_queue.sort();
+	m_queue.execute(m_device);
+
+	m_device.end_gpu_timer(m_timers[m_timer_index]);
+	m_device.end_uniform_ring_frame(m_uniforms);
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	m_timer_index = (m_timer_index + 1) % (BENCHMARK_FRAMES_IN_FLIGHT + 1);
+	m_frame++;
+
+	if (measure)
+	{
+		const DeviceFrameStats& stats = m_device.frame_stats();
+
+		m_cpu_ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		m_state_calls += stats.issued_state_calls;
+		m_filtered_state_calls += stats.filtered_state_calls;
+		m_draw_calls += stats.draw_calls;
+	}
+}
+
+void Benchmark::ReadTimers()
+{
+	for (uint32_t i = 0; i < BENCHMARK_FRAMES_IN_FLIGHT + 1; i++)
+	{
+		uint32_t index = (m_timer_index + i) % (BENCHMARK_FRAMES_IN_FLIGHT + 1);
+		double milliseconds;
+
+		if (m_device.gpu_timer_result(m_timers[index], milliseconds) && m_timer_measured[index])
+			m_gpu_ms.push_back(milliseconds);
+	}
+}
+
+int Benchmark::Report()
+{
+	printf("frames  : %u measured, %u warmup, %ux%u, %u draws\n", m_settings.frames, m_settings.warmup_frames, m_settings.width, m_settings.height, m_settings.draws);
+	printf("device  : %.1f draw calls, %.1f state calls, %.1f filtered state calls per frame\n",
+		   (double)m_draw_calls / m_settings.frames,
+		   (double)m_state_calls / m_settings.frames,
+		   (double)m_filtered_state_calls / m_settings.frames);
+
+	print_timings("cpu", m_cpu_ms);
+	print_timings("gpu", m_gpu_ms);
+
+	if (!m_settings.csv_path.empty())
+	{
+		FILE* file = fopen(m_settings.csv_path.c_str(), "w");
+
+		if (!file)
+			LOG_ERROR("Failed to open " + m_settings.csv_path);
+		else
+		{
+			fprintf(file, "frame,cpu_ms\n");
+
+			for (size_t i = 0; i < m_cpu_ms.size(); i++)
+				fprintf(file, "%zu,%.4f\n", i, m_cpu_ms[i]);
+
+			fclose(file);
+		}
+	}
+
+	if (m_settings.budget_ms > 0.0f)
+	{
+		std::vector<double> sorted = m_cpu_ms;
+		std::sort(sorted.begin(), sorted.end());
+
+		double p95 = percentile(sorted, 0.95);
+
+		if (p95 > m_settings.budget_ms)
+		{
+			printf("FAILED  : cpu p95 %.3f ms exceeds the %.3f ms budget\n", p95, m_settings.budget_ms);
+			return 2;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	Benchmark benchmark;
+	return benchmark.Run(argc, argv);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "HeadlessContext.h"
+#include "RenderQueue.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define BENCHMARK_FRAMES_IN_FLIGHT 3
+
+struct BenchmarkSettings
+{
+    uint32_t    frames;        // Measured frames.
+    uint32_t    warmup_frames; // Rendered before measuring, to get past shader compiles and first use costs.
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    draws;         // Draws submitted per frame.
+    float       budget_ms;     // Run fails if the 95th percentile CPU time exceeds this, 0 to disable.
+    std::string csv_path;      // Per-frame timings are written here if not empty.
+};
+
+// Renders a fixed number of frames of a synthetic scene into an offscreen Framebuffer through a
+// HeadlessContext, then prints CPU and GPU timing statistics. CPU time covers building, sorting and
+// submitting the frame's RenderQueue, so it tracks the cost of the renderer itself rather than
+// the speed of the GPU the run happens to land on.
+class Benchmark
+{
+public:
+    Benchmark();
+    ~Benchmark();
+    int Run(int argc, char* argv[]);
+
+private:
+    bool ParseArguments(int argc, char* argv[]);
+    bool Init();
+    void Shutdown();
+    void Frame(bool measure);
+    void ReadTimers();
+    int Report();
+
+private:
+    BenchmarkSettings  m_settings;
+    HeadlessContext    m_context;
+    RenderDevice       m_device;
+    RenderQueue        m_queue;
+    ShaderProgram*     m_programs[2];
+    Shader*            m_shaders[3];
+    InputLayout*       m_layout;
+    VertexBuffer*      m_vertex_buffer;
+    IndexBuffer*       m_index_buffer;
+    VertexArray*       m_vertex_array;
+    UniformRingBuffer* m_uniforms;
+    Texture2D*         m_color_target;
+    Texture2D*         m_depth_target;
+    Framebuffer*       m_framebuffer;
+    GpuTimer           m_timers[BENCHMARK_FRAMES_IN_FLIGHT + 1];
+    bool               m_timer_measured[BENCHMARK_FRAMES_IN_FLIGHT + 1];
+    uint32_t           m_timer_index;
+    uint32_t           m_frame;
+    std::vector<double> m_cpu_ms;
+    std::vector<double> m_gpu_ms;
+    uint64_t           m_state_calls;
+    uint64_t           m_filtered_state_calls;
+    uint64_t           m_draw_calls;
+};
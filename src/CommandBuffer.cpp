@@ -0,0 +1,199 @@
+#include "CommandBuffer.h"
+
+#include <string.h>
+
+static inline size_t align_packet_size(size_t size)
+{
+	return (size + (COMMAND_PACKET_ALIGNMENT - 1)) & ~size_t(COMMAND_PACKET_ALIGNMENT - 1);
+}
+
+CommandBuffer::CommandBuffer(size_t initial_capacity) : m_size(0),
+														m_command_count(0)
+{
+	m_data.resize(initial_capacity);
+}
+
+CommandBuffer::~CommandBuffer()
+{
+
+}
+
+void CommandBuffer::reset()
+{
+	m_size = 0;
+	m_command_count = 0;
+}
+
+void* CommandBuffer::allocate(uint16_t type, size_t payload_size)
+{
+	size_t packet_size = align_packet_size(sizeof(CommandHeader)) + align_packet_size(payload_size);
+
+	if (m_size + packet_size > m_data.size())
+	{
+		// Starts from the packet size so that an empty buffer grows too.
+		size_t new_capacity = m_data.size() * 2 > packet_size ? m_data.size() * 2 : packet_size;
+
+		while (new_capacity < m_size + packet_size)
+			new_capacity *= 2;
+
+		m_data.resize(new_capacity);
+	}
+
+	CommandHeader* header = (CommandHeader*)(m_data.data() + m_size);
+	header->type = type;
+	header->padding = 0;
+	header->size = (uint32_t)packet_size;
+
+	m_size += packet_size;
+	m_command_count++;
+
+	return (uint8_t*)header + align_packet_size(sizeof(CommandHeader));
+}
+
+void CommandBuffer::draw(uint32_t first_index, uint32_t count)
+{
+	DrawCommand* cmd = allocate<DrawCommand>(GraphicsCommandType::Draw);
+	cmd->first_index = first_index;
+	cmd->count = count;
+}
+
+void CommandBuffer::draw_indexed(uint32_t index_count)
+{
+	DrawIndexedCommand* cmd = allocate<DrawIndexedCommand>(GraphicsCommandType::DrawIndexed);
+	cmd->index_count = index_count;
+}
+
+void CommandBuffer::draw_indexed_base_vertex(uint32_t index_count, uint32_t base_index, uint32_t base_vertex)
+{
+	DrawIndexedBaseVertexCommand* cmd = allocate<DrawIndexedBaseVertexCommand>(GraphicsCommandType::DrawIndexedBaseVertex);
+	cmd->index_count = index_count;
+	cmd->base_index = base_index;
+	cmd->base_vertex = base_vertex;
+}
+
+void CommandBuffer::draw_instanced(uint32_t first_index, uint32_t count, uint32_t instance_count)
+{
+	DrawInstancedCommand* cmd = allocate<DrawInstancedCommand>(GraphicsCommandType::DrawInstanced);
+	cmd->first_index = first_index;
+	cmd->count = count;
+	cmd->instance_count = instance_count;
+}
+
+void CommandBuffer::draw_indexed_instanced(uint32_t index_count, uint32_t instance_count)
+{
+	DrawIndexedInstancedCommand* cmd = allocate<DrawIndexedInstancedCommand>(GraphicsCommandType::DrawIndexedInstanced);
+	cmd->index_count = index_count;
+	cmd->instance_count = instance_count;
+}
+
+void CommandBuffer::draw_indexed_base_vertex_instanced(uint32_t index_count, uint32_t base_index, uint32_t base_vertex, uint32_t instance_count, uint32_t base_instance)
+{
+	DrawIndexedBaseVertexInstancedCommand* cmd = allocate<DrawIndexedBaseVertexInstancedCommand>(GraphicsCommandType::DrawIndexedBaseVertexInstanced);
+	cmd->index_count = index_count;
+	cmd->base_index = base_index;
+	cmd->base_vertex = base_vertex;
+	cmd->instance_count = instance_count;
+	cmd->base_instance = base_instance;
+}
+
+void CommandBuffer::bind_texture(Texture* texture, uint32_t shader_stage, uint32_t slot)
+{
+	BindTextureCommand* cmd = allocate<BindTextureCommand>(GraphicsCommandType::BindTexture);
+	cmd->texture = texture;
+	cmd->shader_stage = shader_stage;
+	cmd->slot = slot;
+}
+
+void CommandBuffer::bind_sampler_state(SamplerState* state, uint32_t shader_stage, uint32_t slot)
+{
+	BindSamplerStateCommand* cmd = allocate<BindSamplerStateCommand>(GraphicsCommandType::BindSamplerState);
+	cmd->state = state;
+	cmd->shader_stage = shader_stage;
+	cmd->slot = slot;
+}
+
+void CommandBuffer::bind_rasterizer_state(RasterizerState* state)
+{
+	BindRasterizerStateCommand* cmd = allocate<BindRasterizerStateCommand>(GraphicsCommandType::BindRasterizerState);
+	cmd->state = state;
+}
+
+void CommandBuffer::bind_depth_stencil_state(DepthStencilState* state)
+{
+	BindDepthStencilStateCommand* cmd = allocate<BindDepthStencilStateCommand>(GraphicsCommandType::BindDepthStencilState);
+	cmd->state = state;
+}
+
+void CommandBuffer::bind_blend_state(BlendState* state)
+{
+	BindBlendStateCommand* cmd = allocate<BindBlendStateCommand>(GraphicsCommandType::BindBlendState);
+	cmd->state = state;
+}
+
+void CommandBuffer::bind_vertex_array(VertexArray* vertex_array)
+{
+	BindVertexArrayCommand* cmd = allocate<BindVertexArrayCommand>(GraphicsCommandType::BindVertexArray);
+	cmd->vertex_array = vertex_array;
+}
+
+void CommandBuffer::bind_framebuffer(Framebuffer* framebuffer)
+{
+	BindFramebufferCommand* cmd = allocate<BindFramebufferCommand>(GraphicsCommandType::BindFramebuffer);
+	cmd->framebuffer = framebuffer;
+}
+
+void CommandBuffer::bind_uniform_buffer(UniformBuffer* buffer, uint32_t shader_stage, uint32_t slot)
+{
+	BindUniformBufferCommand* cmd = allocate<BindUniformBufferCommand>(GraphicsCommandType::BindUniformBuffer);
+	cmd->buffer = buffer;
+	cmd->shader_stage = shader_stage;
+	cmd->slot = slot;
+}
+
+void CommandBuffer::bind_uniform_buffer_range(UniformBuffer* buffer, uint32_t shader_stage, uint32_t slot, size_t offset, size_t size)
+{
+	BindUniformBufferRangeCommand* cmd = allocate<BindUniformBufferRangeCommand>(GraphicsCommandType::BindUniformBufferRange);
+	cmd->buffer = buffer;
+	cmd->shader_stage = shader_stage;
+	cmd->slot = slot;
+	cmd->offset = offset;
+	cmd->size = size;
+}
+
+void CommandBuffer::copy_uniform_data(UniformBuffer* buffer, const void* data, size_t offset, size_t size)
+{
+	CopyUniformDataCommand* cmd = (CopyUniformDataCommand*)allocate(GraphicsCommandType::CopyUniformData, sizeof(CopyUniformDataCommand) + size);
+	cmd->buffer = buffer;
+	cmd->offset = offset;
+	cmd->size = size;
+
+	memcpy(cmd + 1, data, size);
+}
+
+void CommandBuffer::bind_shader_program(ShaderProgram* program)
+{
+	BindShaderProgramCommand* cmd = allocate<BindShaderProgramCommand>(GraphicsCommandType::BindShaderProgram);
+	cmd->program = program;
+}
+
+void CommandBuffer::bind_pipeline_state_object(PipelineStateObject* pso)
+{
+	BindPipelineStateCommand* cmd = allocate<BindPipelineStateCommand>(GraphicsCommandType::BindPipelineState);
+	cmd->pso = pso;
+}
+
+void CommandBuffer::set_viewport(uint32_t width, uint32_t height, uint32_t top_left_x, uint32_t top_left_y)
+{
+	SetViewportCommand* cmd = allocate<SetViewportCommand>(GraphicsCommandType::SetViewport);
+	cmd->width = width;
+	cmd->height = height;
+	cmd->top_left_x = top_left_x;
+	cmd->top_left_y = top_left_y;
+}
+
+void CommandBuffer::clear_framebuffer(uint32_t clear_target, float* clear_color)
+{
+	ClearFramebufferCommand* cmd = allocate<ClearFramebufferCommand>(GraphicsCommandType::ClearFramebuffer);
+	cmd->clear_target = clear_target;
+	memcpy(&cmd->clear_color[0], clear_color, sizeof(float) * 4);
+}
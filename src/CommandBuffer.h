@@ -0,0 +1,199 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "gfx_types.h"
+
+// Commands are recorded as a tightly packed stream of POD packets: a CommandHeader followed
+// by the command payload. A CommandBuffer is owned by exactly one recording thread at a time,
+// so several workers can record into their own buffers in parallel without any locking. The
+// buffers are then handed to RenderDevice::submit_command_buffer on the thread that owns the
+// GL context, which replays them in order.
+
+#define COMMAND_PACKET_ALIGNMENT 8
+
+struct CommandHeader
+{
+    uint16_t type;
+    uint16_t padding;
+    uint32_t size; // Total packet size in bytes, header included.
+};
+
+struct DrawCommand
+{
+    uint32_t first_index;
+    uint32_t count;
+};
+
+struct DrawIndexedCommand
+{
+    uint32_t index_count;
+};
+
+struct DrawIndexedBaseVertexCommand
+{
+    uint32_t index_count;
+    uint32_t base_index;
+    uint32_t base_vertex;
+};
+
+struct DrawInstancedCommand
+{
+    uint32_t first_index;
+    uint32_t count;
+    uint32_t instance_count;
+};
+
+struct DrawIndexedInstancedCommand
+{
+    uint32_t index_count;
+    uint32_t instance_count;
+};
+
+struct DrawIndexedBaseVertexInstancedCommand
+{
+    uint32_t index_count;
+    uint32_t base_index;
+    uint32_t base_vertex;
+    uint32_t instance_count;
+    uint32_t base_instance;
+};
+
+struct BindTextureCommand
+{
+    Texture* texture;
+    uint32_t shader_stage;
+    uint32_t slot;
+};
+
+struct BindSamplerStateCommand
+{
+    SamplerState* state;
+    uint32_t      shader_stage;
+    uint32_t      slot;
+};
+
+struct BindRasterizerStateCommand
+{
+    RasterizerState* state;
+};
+
+struct BindDepthStencilStateCommand
+{
+    DepthStencilState* state;
+};
+
+struct BindBlendStateCommand
+{
+    BlendState* state;
+};
+
+struct BindVertexArrayCommand
+{
+    VertexArray* vertex_array;
+};
+
+struct BindFramebufferCommand
+{
+    Framebuffer* framebuffer;
+};
+
+struct BindUniformBufferCommand
+{
+    UniformBuffer* buffer;
+    uint32_t       shader_stage;
+    uint32_t       slot;
+};
+
+struct BindUniformBufferRangeCommand
+{
+    UniformBuffer* buffer;
+    uint32_t       shader_stage;
+    uint32_t       slot;
+    size_t         offset;
+    size_t         size;
+};
+
+// The uniform data itself is stored inline, directly after this struct.
+struct CopyUniformDataCommand
+{
+    UniformBuffer* buffer;
+    size_t         offset;
+    size_t         size;
+};
+
+struct BindShaderProgramCommand
+{
+    ShaderProgram* program;
+};
+
+struct BindPipelineStateCommand
+{
+    PipelineStateObject* pso;
+};
+
+struct SetViewportCommand
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t top_left_x;
+    uint32_t top_left_y;
+};
+
+struct ClearFramebufferCommand
+{
+    uint32_t clear_target;
+    float    clear_color[4];
+};
+
+class CommandBuffer
+{
+public:
+    CommandBuffer(size_t initial_capacity = 64 * 1024);
+    ~CommandBuffer();
+
+    // Discards all recorded commands but keeps the allocated memory around for reuse.
+    void reset();
+
+    void draw(uint32_t first_index, uint32_t count);
+    void draw_indexed(uint32_t index_count);
+    void draw_indexed_base_vertex(uint32_t index_count, uint32_t base_index, uint32_t base_vertex);
+    void draw_instanced(uint32_t first_index, uint32_t count, uint32_t instance_count);
+    void draw_indexed_instanced(uint32_t index_count, uint32_t instance_count);
+    void draw_indexed_base_vertex_instanced(uint32_t index_count, uint32_t base_index, uint32_t base_vertex, uint32_t instance_count, uint32_t base_instance);
+    void bind_texture(Texture* texture, uint32_t shader_stage, uint32_t slot);
+    void bind_sampler_state(SamplerState* state, uint32_t shader_stage, uint32_t slot);
+    void bind_rasterizer_state(RasterizerState* state);
+    void bind_depth_stencil_state(DepthStencilState* state);
+    void bind_blend_state(BlendState* state);
+    void bind_vertex_array(VertexArray* vertex_array);
+    void bind_framebuffer(Framebuffer* framebuffer);
+    void bind_uniform_buffer(UniformBuffer* buffer, uint32_t shader_stage, uint32_t slot);
+    void bind_uniform_buffer_range(UniformBuffer* buffer, uint32_t shader_stage, uint32_t slot, size_t offset, size_t size);
+    void copy_uniform_data(UniformBuffer* buffer, const void* data, size_t offset, size_t size);
+    void bind_shader_program(ShaderProgram* program);
+    void bind_pipeline_state_object(PipelineStateObject* pso);
+    void set_viewport(uint32_t width, uint32_t height, uint32_t top_left_x, uint32_t top_left_y);
+    void clear_framebuffer(uint32_t clear_target, float* clear_color);
+
+    inline const uint8_t* begin() const { return m_data.data(); }
+    inline const uint8_t* end() const   { return m_data.data() + m_size; }
+    inline size_t size() const          { return m_size; }
+    inline uint32_t command_count() const { return m_command_count; }
+    inline bool empty() const           { return m_command_count == 0; }
+
+private:
+    // Reserves space for a packet of the given type and returns a pointer to its payload.
+    void* allocate(uint16_t type, size_t payload_size);
+
+    template <typename T>
+    inline T* allocate(uint16_t type)
+    {
+        return static_cast<T*>(allocate(type, sizeof(T)));
+    }
+
+private:
+    std::vector<uint8_t> m_data;
+    size_t               m_size;
+    uint32_t             m_command_count;
+};
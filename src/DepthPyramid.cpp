@@ -0,0 +1,298 @@
+#include "DepthPyramid.h"
+#include "RenderDevice.h"
+#include "logger.h"
+
+#include <string.h>
+
+#define PYRAMID_GROUP_SIZE 8
+
+const char* kDepthPyramidCopyCS = R"(layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (binding = 0) uniform sampler2D u_Depth;
+layout (r32f, binding = 0) writeonly uniform image2D u_Dst;
+
+layout (std140, binding = 0) uniform PyramidLevel
+{
+    ivec4 u_Sizes; // Destination size in xy, source size in zw.
+};
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+
+    if (any(greaterThanEqual(texel, u_Sizes.xy)))
+        return;
+
+    imageStore(u_Dst, texel, vec4(texelFetch(u_Depth, texel, 0).r));
+})";
+
+// Odd sized levels fold their last row and column into the last texel of the next level, so every
+// texel of a level is covered by exactly one texel of the next.
+const char* kDepthPyramidReduceCS = R"(layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (r32f, binding = 0) writeonly uniform image2D u_Dst;
+layout (r32f, binding = 1) readonly uniform image2D u_Src;
+
+layout (std140, binding = 0) uniform PyramidLevel
+{
+    ivec4 u_Sizes; // Destination size in xy, source size in zw.
+};
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+
+    if (any(greaterThanEqual(texel, u_Sizes.xy)))
+        return;
+
+    ivec2 first = texel * 2;
+    ivec2 last = first + 1 + ivec2(equal(texel, u_Sizes.xy - 1)) * (u_Sizes.zw & 1);
+    last = min(last, u_Sizes.zw - 1);
+
+    float depth = 0.0;
+
+    for (int y = first.y; y <= last.y; y++)
+    {
+        for (int x = first.x; x <= last.x; x++)
+            depth = max(depth, imageLoad(u_Src, ivec2(x, y)).r);
+    }
+
+    imageStore(u_Dst, texel, vec4(depth));
+})";
+
+static uint32_t level_count(uint32_t width, uint32_t height)
+{
+	uint32_t size = width > height ? width : height;
+	uint32_t levels = 1;
+
+	while (size > 1)
+	{
+		size >>= 1;
+		levels++;
+	}
+
+	return levels;
+}
+
+DepthPyramid::DepthPyramid() : m_device(nullptr),
+							   m_copy_program(nullptr),
+							   m_reduce_program(nullptr),
+							   m_texture(nullptr),
+							   m_uniform_buffer(nullptr),
+							   m_uniform_stride(0),
+							   m_width(0),
+							   m_height(0),
+							   m_levels(0),
+							   m_valid(false)
+{
+	memset(&m_shaders[0], 0, sizeof(m_shaders));
+	memset(&m_view_projection[0], 0, sizeof(m_view_projection));
+}
+
+DepthPyramid::~DepthPyramid()
+{
+
+}
+
+bool DepthPyramid::init(RenderDevice* device, uint16_t width, uint16_t height)
+{
+	if (width == 0 || height == 0)
+	{
+		LOG_ERROR("Invalid Depth Pyramid size");
+		return false;
+	}
+
+	if (!device->compute_supported())
+	{
+		LOG_ERROR("Depth Pyramid requires compute shaders");
+		return false;
+	}
+
+	m_device = device;
+
+	m_shaders[0] = device->create_shader(kDepthPyramidCopyCS, ShaderType::COMPUTE);
+	m_shaders[1] = device->create_shader(kDepthPyramidReduceCS, ShaderType::COMPUTE);
+
+	if (m_shaders[0] && m_shaders[1])
+	{
+		m_copy_program = device->create_shader_program(&m_shaders[0], 1);
+		m_reduce_program = device->create_shader_program(&m_shaders[1], 1);
+	}
+
+	if (!m_copy_program || !m_reduce_program)
+	{
+		LOG_ERROR("Failed to create Depth Pyramid programs");
+		shutdown();
+		return false;
+	}
+
+	// One range per level, so every pass binds its sizes without a buffer update in between.
+	uint32_t alignment = (uint32_t)device->UniformBufferAlignment();
+	m_uniform_stride = ((sizeof(int32_t) * 4 + alignment - 1) / alignment) * alignment;
+
+	BufferCreateDesc buffer_desc = {};
+
+	buffer_desc.size = m_uniform_stride * DEPTH_PYRAMID_MAX_LEVELS;
+	buffer_desc.usage_type = BufferUsageType::DYNAMIC;
+
+	m_uniform_buffer = device->create_uniform_buffer(buffer_desc);
+	m_uniform_data.resize(buffer_desc.size);
+
+	if (!m_uniform_buffer || !create_texture(width, height))
+	{
+		LOG_ERROR("Failed to create Depth Pyramid resources");
+		shutdown();
+		return false;
+	}
+
+	return true;
+}
+
+void DepthPyramid::shutdown()
+{
+	if (!m_device)
+		return;
+
+	if (m_texture)
+	{
+		m_device->destroy_texture(m_texture);
+		m_texture = nullptr;
+	}
+
+	if (m_uniform_buffer)
+	{
+		m_device->destroy_uniform_buffer(m_uniform_buffer);
+		m_uniform_buffer = nullptr;
+	}
+
+	if (m_copy_program)
+	{
+		m_device->destroy_shader_program(m_copy_program);
+		m_copy_program = nullptr;
+	}
+
+	if (m_reduce_program)
+	{
+		m_device->destroy_shader_program(m_reduce_program);
+		m_reduce_program = nullptr;
+	}
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (m_shaders[i])
+		{
+			m_device->destroy_shader(m_shaders[i]);
+			m_shaders[i] = nullptr;
+		}
+	}
+
+	m_valid = false;
+}
+
+bool DepthPyramid::resize(uint16_t width, uint16_t height)
+{
+	m_valid = false;
+
+	if (m_texture && width == m_texture->width && height == m_texture->height)
+		return true;
+
+	if (m_texture)
+	{
+		m_device->destroy_texture(m_texture);
+		m_texture = nullptr;
+	}
+
+	return create_texture(width, height);
+}
+
+void DepthPyramid::build(Framebuffer* framebuffer, uint32_t width, uint32_t height, const float* view_projection)
+{
+	// A failed resize leaves no texture to build into.
+	if (!m_texture)
+	{
+		m_valid = false;
+		return;
+	}
+
+	Texture* depth = framebuffer->depth_target;
+
+	if (!depth || depth->gl_texture_target != GL_TEXTURE_2D)
+	{
+		LOG_ERROR("Depth Pyramid needs a framebuffer with a 2D depth target");
+		m_valid = false;
+		return;
+	}
+
+	m_width = width < m_texture->width ? width : m_texture->width;
+	m_height = height < m_texture->height ? height : m_texture->height;
+	m_levels = level_count(m_width, m_height);
+
+	if (m_levels > DEPTH_PYRAMID_MAX_LEVELS)
+		m_levels = DEPTH_PYRAMID_MAX_LEVELS;
+
+	memcpy(&m_view_projection[0], view_projection, sizeof(m_view_projection));
+
+	// Sizes of every level, level 0 reads the depth target at the same size.
+	int32_t src_width = m_width;
+	int32_t src_height = m_height;
+
+	for (uint32_t i = 0; i < m_levels; i++)
+	{
+		int32_t sizes[4];
+
+		sizes[0] = i == 0 ? src_width : (src_width / 2 > 0 ? src_width / 2 : 1);
+		sizes[1] = i == 0 ? src_height : (src_height / 2 > 0 ? src_height / 2 : 1);
+		sizes[2] = src_width;
+		sizes[3] = src_height;
+
+		memcpy(&m_uniform_data[i * m_uniform_stride], &sizes[0], sizeof(sizes));
+
+		src_width = sizes[0];
+		src_height = sizes[1];
+	}
+
+	m_device->update_buffer(m_uniform_buffer, 0, m_uniform_stride * m_levels, m_uniform_data.data());
+
+	m_device->bind_shader_program(m_copy_program);
+	m_device->bind_texture(depth, ShaderType::COMPUTE, 0);
+	m_device->bind_image(m_texture, ShaderType::COMPUTE, 0, 0, ImageAccess::WRITE_ONLY);
+	m_device->bind_uniform_buffer_range(m_uniform_buffer, ShaderType::COMPUTE, 0, 0, sizeof(int32_t) * 4);
+	m_device->dispatch((m_width + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, (m_height + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+
+	m_device->bind_shader_program(m_reduce_program);
+
+	uint32_t level_width = m_width;
+	uint32_t level_height = m_height;
+
+	for (uint32_t i = 1; i < m_levels; i++)
+	{
+		level_width = level_width / 2 > 0 ? level_width / 2 : 1;
+		level_height = level_height / 2 > 0 ? level_height / 2 : 1;
+
+		m_device->memory_barrier(BarrierType::SHADER_IMAGE);
+
+		m_device->bind_image(m_texture, ShaderType::COMPUTE, 0, i, ImageAccess::WRITE_ONLY);
+		m_device->bind_image(m_texture, ShaderType::COMPUTE, 1, i - 1, ImageAccess::READ_ONLY);
+		m_device->bind_uniform_buffer_range(m_uniform_buffer, ShaderType::COMPUTE, 0, m_uniform_stride * i, sizeof(int32_t) * 4);
+		m_device->dispatch((level_width + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, (level_height + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+	}
+
+	// The culling pass reads the pyramid with texel fetches.
+	m_device->memory_barrier(BarrierType::TEXTURE_FETCH);
+
+	m_valid = true;
+}
+
+bool DepthPyramid::create_texture(uint16_t width, uint16_t height)
+{
+	Texture2DCreateDesc texture_desc = {};
+
+	texture_desc.width = width;
+	texture_desc.height = height;
+	texture_desc.format = TextureFormat::R32_FLOAT;
+	texture_desc.mipmap_levels = (uint16_t)level_count(width, height);
+
+	m_texture = m_device->create_texture_2d(texture_desc);
+
+	return m_texture != nullptr;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "gfx_types.h"
+
+class RenderDevice;
+
+#define DEPTH_PYRAMID_MAX_LEVELS 16
+
+// Hierarchical-Z buffer: an R32_FLOAT texture whose level 0 is a copy of a depth target and whose
+// every further level holds the farthest depth of the texels below it. An object whose nearest
+// depth is farther than the pyramid over its screen rect is hidden, which a few texel reads at
+// the right level can tell.
+//
+// Built from the depth target of the framebuffer a frame's opaque pass rendered to, and used to
+// cull the next frame's objects, projected with the view_projection the pyramid was built with.
+// Assumes the default depth convention where nearer is smaller.
+class DepthPyramid
+{
+public:
+    DepthPyramid();
+    ~DepthPyramid();
+
+    // width and height are the largest depth target size build will be called with.
+    bool init(RenderDevice* device, uint16_t width, uint16_t height);
+    void shutdown();
+    // Invalidates the pyramid until the next build.
+    bool resize(uint16_t width, uint16_t height);
+
+    // Reduces the bottom-left width x height region of the framebuffer's depth target, e.g. the
+    // render size of a DynamicResolution framebuffer, using compute shaders.
+    void build(Framebuffer* framebuffer, uint32_t width, uint32_t height, const float* view_projection);
+
+    inline bool valid() const { return m_valid; }
+    inline Texture2D* texture() const { return m_texture; }
+    // Size of the built region at level 0, and the number of levels it spans.
+    inline uint32_t width() const { return m_width; }
+    inline uint32_t height() const { return m_height; }
+    inline uint32_t levels() const { return m_levels; }
+    inline const float* view_projection() const { return &m_view_projection[0]; }
+
+private:
+    bool create_texture(uint16_t width, uint16_t height);
+
+private:
+    RenderDevice*        m_device;
+    Shader*              m_shaders[2];
+    ShaderProgram*       m_copy_program;
+    ShaderProgram*       m_reduce_program;
+    Texture2D*           m_texture;
+    UniformBuffer*       m_uniform_buffer;
+    uint32_t             m_uniform_stride;
+    std::vector<uint8_t> m_uniform_data;
+    uint32_t             m_width;
+    uint32_t             m_height;
+    uint32_t             m_levels;
+    float                m_view_projection[16];
+    bool                 m_valid;
+};
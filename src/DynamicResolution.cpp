@@ -0,0 +1,250 @@
+#include "DynamicResolution.h"
+#include "RenderDevice.h"
+#include "logger.h"
+
+#include <math.h>
+#include <string.h>
+
+// Fraction of the budget the controller aims for, leaving room for spikes.
+#define TARGET_HEADROOM        0.9f
+// Weight of the newest timing in the smoothed time.
+#define TIMING_SMOOTHING       0.2f
+// Scale changes smaller than this are ignored so the resolution does not flicker.
+#define MIN_SCALE_CHANGE       0.02f
+// Lowering the scale reacts at once since a missed frame is visible, raising it waits for a run
+// of cheap frames and moves in smaller steps.
+#define MAX_SCALE_DECREASE     0.1f
+#define MAX_SCALE_INCREASE     0.05f
+#define FRAMES_BEFORE_INCREASE 8
+
+DynamicResolution::DynamicResolution() : m_device(nullptr),
+										 m_framebuffer(nullptr),
+										 m_color_target(nullptr),
+										 m_depth_target(nullptr),
+										 m_timer_index(0),
+										 m_scale(1.0f),
+										 m_full_res_ms(0.0f),
+										 m_frames_under(0),
+										 m_render_width(0),
+										 m_render_height(0)
+{
+	memset(&m_desc, 0, sizeof(DynamicResolutionDesc));
+	memset(&m_timers[0], 0, sizeof(m_timers));
+	memset(&m_timer_scales[0], 0, sizeof(m_timer_scales));
+}
+
+DynamicResolution::~DynamicResolution()
+{
+
+}
+
+bool DynamicResolution::init(RenderDevice* device, const DynamicResolutionDesc& desc)
+{
+	if (desc.width == 0 || desc.height == 0 || desc.target_frame_ms <= 0.0f || desc.min_scale <= 0.0f || desc.min_scale > desc.max_scale)
+	{
+		LOG_ERROR("Invalid Dynamic Resolution description");
+		return false;
+	}
+
+	m_device = device;
+	m_desc = desc;
+
+	// The offscreen framebuffer is the size of the output, so the scene can't be supersampled.
+	if (m_desc.max_scale > 1.0f)
+		m_desc.max_scale = 1.0f;
+
+	m_scale = m_desc.max_scale;
+	m_full_res_ms = 0.0f;
+	m_frames_under = 0;
+	m_timer_index = 0;
+
+	if (!create_targets())
+	{
+		shutdown();
+		return false;
+	}
+
+	update_render_size();
+
+	return true;
+}
+
+void DynamicResolution::shutdown()
+{
+	destroy_targets();
+
+	if (m_device)
+	{
+		for (int i = 0; i < DYNAMIC_RESOLUTION_TIMER_LATENCY; i++)
+			m_device->release_gpu_timer(m_timers[i]);
+	}
+}
+
+bool DynamicResolution::resize(uint16_t width, uint16_t height)
+{
+	if (width == m_desc.width && height == m_desc.height)
+		return true;
+
+	destroy_targets();
+
+	m_desc.width = width;
+	m_desc.height = height;
+
+	if (!create_targets())
+		return false;
+
+	update_render_size();
+
+	return true;
+}
+
+void DynamicResolution::begin_scene()
+{
+	m_device->bind_framebuffer(m_framebuffer);
+	m_device->set_viewport(m_render_width, m_render_height, 0, 0);
+
+	m_timer_scales[m_timer_index] = m_scale;
+	m_device->begin_gpu_timer(m_timers[m_timer_index]);
+}
+
+void DynamicResolution::end_scene()
+{
+	m_device->end_gpu_timer(m_timers[m_timer_index]);
+	m_timer_index = (m_timer_index + 1) % DYNAMIC_RESOLUTION_TIMER_LATENCY;
+}
+
+void DynamicResolution::present(Framebuffer* dst)
+{
+	m_device->blit_framebuffer(m_framebuffer, m_render_width, m_render_height, dst, m_desc.width, m_desc.height, true);
+
+	read_timings();
+	update_scale();
+}
+
+bool DynamicResolution::create_targets()
+{
+	Texture2DCreateDesc texture_desc = {};
+
+	texture_desc.width = m_desc.width;
+	texture_desc.height = m_desc.height;
+	texture_desc.format = m_desc.color_format;
+	texture_desc.create_render_target_view = true;
+	texture_desc.mipmap_levels = 1;
+
+	m_color_target = m_device->create_texture_2d(texture_desc);
+
+	texture_desc.format = m_desc.depth_format;
+
+	m_depth_target = m_device->create_texture_2d(texture_desc);
+
+	if (!m_color_target || !m_depth_target)
+	{
+		LOG_ERROR("Failed to create Dynamic Resolution render targets");
+		return false;
+	}
+
+	FramebufferCreateDesc framebuffer_desc = {};
+
+	framebuffer_desc.num_render_targets = 1;
+	framebuffer_desc.render_targets[0] = m_color_target;
+	framebuffer_desc.depth_target = m_depth_target;
+
+	m_framebuffer = m_device->create_framebuffer(framebuffer_desc);
+
+	if (!m_framebuffer)
+	{
+		LOG_ERROR("Failed to create Dynamic Resolution framebuffer");
+		return false;
+	}
+
+	return true;
+}
+
+void DynamicResolution::destroy_targets()
+{
+	if (m_framebuffer)
+	{
+		m_device->destroy_framebuffer(m_framebuffer, false);
+		m_framebuffer = nullptr;
+	}
+
+	if (m_color_target)
+	{
+		m_device->destroy_texture(m_color_target);
+		m_color_target = nullptr;
+	}
+
+	if (m_depth_target)
+	{
+		m_device->destroy_texture(m_depth_target);
+		m_depth_target = nullptr;
+	}
+}
+
+// Timers are polled oldest first so the smoothed time ends on the newest result. Every timing is
+// divided by the pixel fraction it was rendered at, which keeps timings taken before a scale change
+// comparable with the ones after it.
+void DynamicResolution::read_timings()
+{
+	for (uint32_t i = 0; i < DYNAMIC_RESOLUTION_TIMER_LATENCY; i++)
+	{
+		uint32_t index = (m_timer_index + i) % DYNAMIC_RESOLUTION_TIMER_LATENCY;
+		double milliseconds;
+
+		if (!m_device->gpu_timer_result(m_timers[index], milliseconds))
+			continue;
+
+		float scale = m_timer_scales[index];
+		float full_res_ms = float(milliseconds) / (scale * scale);
+
+		if (m_full_res_ms == 0.0f)
+			m_full_res_ms = full_res_ms;
+		else
+			m_full_res_ms += (full_res_ms - m_full_res_ms) * TIMING_SMOOTHING;
+	}
+}
+
+// GPU time is assumed to grow with the pixel count, so the scale that fits the budget is the
+// square root of budget over the full resolution time.
+void DynamicResolution::update_scale()
+{
+	if (m_full_res_ms <= 0.0f)
+		return;
+
+	float desired = sqrtf(m_desc.target_frame_ms * TARGET_HEADROOM / m_full_res_ms);
+
+	if (desired < m_desc.min_scale)
+		desired = m_desc.min_scale;
+	else if (desired > m_desc.max_scale)
+		desired = m_desc.max_scale;
+
+	if (desired < m_scale - MIN_SCALE_CHANGE)
+	{
+		m_scale = desired > m_scale - MAX_SCALE_DECREASE ? desired : m_scale - MAX_SCALE_DECREASE;
+		m_frames_under = 0;
+	}
+	else if (desired > m_scale + MIN_SCALE_CHANGE)
+	{
+		if (++m_frames_under >= FRAMES_BEFORE_INCREASE)
+		{
+			m_scale = desired < m_scale + MAX_SCALE_INCREASE ? desired : m_scale + MAX_SCALE_INCREASE;
+			m_frames_under = 0;
+		}
+	}
+	else
+		m_frames_under = 0;
+
+	update_render_size();
+}
+
+void DynamicResolution::update_render_size()
+{
+	m_render_width = (uint32_t)(m_desc.width * m_scale + 0.5f);
+	m_render_height = (uint32_t)(m_desc.height * m_scale + 0.5f);
+
+	if (m_render_width == 0)
+		m_render_width = 1;
+
+	if (m_render_height == 0)
+		m_render_height = 1;
+}
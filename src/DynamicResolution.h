@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include "gfx_types.h"
+
+class RenderDevice;
+
+// Frames of GPU timings in flight. Results are read back this many frames late at most.
+#define DYNAMIC_RESOLUTION_TIMER_LATENCY 4
+
+struct DynamicResolutionDesc
+{
+    uint16_t width;           // Output size. The scene is never rendered larger than this.
+    uint16_t height;
+    uint32_t color_format;
+    uint32_t depth_format;
+    float    target_frame_ms; // GPU time budget of the scene, between begin_scene and end_scene.
+    float    min_scale;       // Range of the scale applied to both axes, e.g. 0.5 to 1.0.
+    float    max_scale;
+};
+
+// Renders the scene into an offscreen framebuffer at a variable fraction of the output size and
+// upscales it into the output with a linear blit. The GPU time of every scene is measured with a
+// timer query, and the scale is adjusted so the scene fits into target_frame_ms.
+//
+// The offscreen framebuffer is allocated at the full output size and the scene only renders into
+// its bottom-left render_width() x render_height() region, so changing the scale never reallocates.
+// Passes that sample the scene color before present() must scale their texture coordinates by
+// uv_scale().
+//
+//     resolution.begin_scene();
+//     ... draw the scene ...
+//     resolution.end_scene();
+//     resolution.present(nullptr);
+class DynamicResolution
+{
+public:
+    DynamicResolution();
+    ~DynamicResolution();
+
+    bool init(RenderDevice* device, const DynamicResolutionDesc& desc);
+    void shutdown();
+    // Recreates the offscreen framebuffer for a new output size. The scale is kept.
+    bool resize(uint16_t width, uint16_t height);
+
+    // Binds the offscreen framebuffer, sets the viewport to the render size and starts timing.
+    void begin_scene();
+    void end_scene();
+    // Upscales the rendered region over the whole of dst, null being the default framebuffer, then
+    // picks the scale of the next frame from the newest timing available.
+    void present(Framebuffer* dst);
+
+    inline float        scale() const { return m_scale; }
+    inline uint32_t     render_width() const { return m_render_width; }
+    inline uint32_t     render_height() const { return m_render_height; }
+    inline float        uv_scale_x() const { return float(m_render_width) / float(m_desc.width); }
+    inline float        uv_scale_y() const { return float(m_render_height) / float(m_desc.height); }
+    // Smoothed scene GPU time, projected to the current scale. 0 until the first timing arrives.
+    inline float        gpu_time_ms() const { return m_full_res_ms * m_scale * m_scale; }
+    inline Framebuffer* framebuffer() const { return m_framebuffer; }
+    inline Texture2D*   color_target() const { return m_color_target; }
+
+private:
+    bool create_targets();
+    void destroy_targets();
+    void read_timings();
+    void update_scale();
+    void update_render_size();
+
+private:
+    RenderDevice*         m_device;
+    DynamicResolutionDesc m_desc;
+    Framebuffer*          m_framebuffer;
+    Texture2D*            m_color_target;
+    Texture2D*            m_depth_target;
+    GpuTimer              m_timers[DYNAMIC_RESOLUTION_TIMER_LATENCY];
+    float                 m_timer_scales[DYNAMIC_RESOLUTION_TIMER_LATENCY]; // Scale each timed frame was rendered at.
+    uint32_t              m_timer_index;
+    float                 m_scale;
+    float                 m_full_res_ms;  // Smoothed scene time divided by the pixel fraction it was rendered at.
+    uint32_t              m_frames_under; // Consecutive frames with room to raise the scale.
+    uint32_t              m_render_width;
+    uint32_t              m_render_height;
+};
@@ -1,38 +1,47 @@
 #include "RenderDevice.h"
+#include "CommandBuffer.h"
 #include "glad.h"
 #include "utility.h"
 #include "logger.h"
+#include "gfx_debug_gl4.h"
 
-#define GFX_ENABLE_ERROR_CHECK
-
-#ifdef GFX_ENABLE_ERROR_CHECK
-#define GL_CHECK_ERROR(x)																		  \
-x; {                                                                                              \
-GLenum err(glGetError());																		  \
-																								  \
-while (err != GL_NO_ERROR)																		  \
-{																								  \
-std::string error;																				  \
-																								  \
-switch (err)																					  \
-{																								  \
-case GL_INVALID_OPERATION:      error = "INVALID_OPERATION";      break;						  \
-case GL_INVALID_ENUM:           error = "INVALID_ENUM";           break;						  \
-case GL_INVALID_VALUE:          error = "INVALID_VALUE";          break;						  \
-case GL_OUT_OF_MEMORY:          error = "OUT_OF_MEMORY";          break;						  \
-case GL_INVALID_FRAMEBUFFER_OPERATION:  error = "INVALID_FRAMEBUFFER_OPERATION";  break;		  \
-}																								  \
-																								  \
-std::string formatted_error = "OPENGL ERROR : ";                                                  \
-formatted_error += error;                                                                         \
-std::cout <<  "LINE:" << __LINE__ <<", FILE:" << __FILE__ << formatted_error << std::endl;        \
-err = glGetError();																				  \
-}																								  \
-}
-#else
-#define GL_CHECK_ERROR(x)	x
+#include <string.h>
+#include <stdio.h>
+#include <fstream>
+
+// EXT_texture_compression_s3tc and EXT_texture_sRGB are not part of the generated loader.
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#endif
+
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// KHR_parallel_shader_compile is not part of the generated loader.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
 #endif
 
+#define PROGRAM_BINARY_MAGIC 0x42505341 // "ASPB"
+
+struct ProgramBinaryHeader
+{
+	uint32_t magic;
+	uint32_t length;
+	uint64_t key;
+	GLenum   format;
+	uint32_t reserved; // Always zero. Makes the tail padding explicit so no stack bytes reach the file.
+};
+
 const GLenum kTextureFormatTable[][3] =
 {
 	{ GL_RGB32F, GL_RGB, GL_FLOAT } ,
@@ -55,13 +64,22 @@ const GLenum kTextureFormatTable[][3] =
     { GL_RGBA8_SNORM, GL_RGBA, GL_BYTE } ,
     { GL_RGB8I, GL_RGB, GL_INT } ,
     { GL_RGBA8I, GL_RGBA, GL_INT } ,
-    { GL_RGB8I, GL_RGB, GL_UNSIGNED_INT } ,
+    { GL_RGB8UI, GL_RGB, GL_UNSIGNED_INT } ,
 	{ GL_RGBA8UI, GL_RGBA, GL_UNSIGNED_INT } ,
 	{ GL_R8, GL_RED, GL_UNSIGNED_BYTE } ,
 	{ GL_R8_SNORM, GL_RED, GL_BYTE } ,
-	{ GL_DEPTH_STENCIL, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV } ,
-	{ GL_DEPTH_STENCIL, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8 } ,
-	{ GL_DEPTH_COMPONENT, GL_DEPTH_COMPONENT, GL_FLOAT }
+	{ GL_DEPTH32F_STENCIL8, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV } ,
+	{ GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8 } ,
+	{ GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT, GL_FLOAT } ,
+	{ GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, GL_NONE, GL_NONE } ,
+	{ GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, GL_NONE, GL_NONE } ,
+	{ GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_NONE, GL_NONE } ,
+	{ GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, GL_NONE, GL_NONE } ,
+	{ GL_COMPRESSED_RED_RGTC1, GL_NONE, GL_NONE } ,
+	{ GL_COMPRESSED_RG_RGTC2, GL_NONE, GL_NONE } ,
+	{ GL_COMPRESSED_RGBA_BPTC_UNORM, GL_NONE, GL_NONE } ,
+	{ GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, GL_NONE, GL_NONE } ,
+	{ GL_R32F, GL_RED, GL_FLOAT }
 };
 
 const GLenum kShaderTypeTable[] =
@@ -136,6 +154,30 @@ const GLenum kStencilOperationTable[] =
 	GL_DECR_WRAP
 };
 
+const GLenum kBlendFactorTable[] =
+{
+	GL_ZERO,
+	GL_ONE,
+	GL_SRC_COLOR,
+	GL_ONE_MINUS_SRC_COLOR,
+	GL_DST_COLOR,
+	GL_ONE_MINUS_DST_COLOR,
+	GL_SRC_ALPHA,
+	GL_ONE_MINUS_SRC_ALPHA,
+	GL_DST_ALPHA,
+	GL_ONE_MINUS_DST_ALPHA,
+	GL_SRC_ALPHA_SATURATE
+};
+
+const GLenum kBlendOpTable[] =
+{
+	GL_FUNC_ADD,
+	GL_FUNC_SUBTRACT,
+	GL_FUNC_REVERSE_SUBTRACT,
+	GL_MIN,
+	GL_MAX
+};
+
 const GLenum kTextureWrapModeTable[] =
 {
 	GL_REPEAT,
@@ -175,737 +217,3552 @@ const GLenum kDrawPrimitiveTypeTable[] =
 	GL_LINE_STRIP
 };
 
-RenderDevice::RenderDevice()
+const GLenum kImageAccessTable[] =
 {
-    
+	GL_READ_ONLY,
+	GL_WRITE_ONLY,
+	GL_READ_WRITE
+};
+
+// Indexed by bit position of BarrierType.
+const GLbitfield kBarrierTable[] =
+{
+	GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT,
+	GL_ELEMENT_ARRAY_BARRIER_BIT,
+	GL_UNIFORM_BARRIER_BIT,
+	GL_TEXTURE_FETCH_BARRIER_BIT,
+	GL_SHADER_IMAGE_ACCESS_BARRIER_BIT,
+	GL_COMMAND_BARRIER_BIT,
+	GL_BUFFER_UPDATE_BARRIER_BIT,
+	GL_FRAMEBUFFER_BARRIER_BIT,
+	GL_SHADER_STORAGE_BARRIER_BIT
+};
+
+// Returns true if the cached value differs from the requested one, in which case the cache is
+// updated and the caller is expected to issue the GL call.
+static inline bool cache_update(DeviceData& data, GLuint& cached, GLuint value)
+{
+	if (cached == value)
+	{
+		data.stats.filtered_state_calls++;
+		return false;
+	}
+
+	cached = value;
+	data.stats.issued_state_calls++;
+	return true;
 }
 
-RenderDevice::~RenderDevice()
+static inline void set_capability(DeviceData& data, uint8_t& cached, GLenum capability, bool enable)
 {
-    
+	if (cached == (uint8_t)enable)
+	{
+		data.stats.filtered_state_calls++;
+		return;
+	}
+
+	cached = (uint8_t)enable;
+	data.stats.issued_state_calls++;
+
+	if (enable)
+		glEnable(capability);
+	else
+		glDisable(capability);
 }
 
-bool RenderDevice::init()
+static inline void set_stencil_face(DeviceData& data, StencilFaceCache& cached, GLenum face, const StencilFaceCache& value)
 {
-	if (!gladLoadGL())
+	if (cached.func != value.func || cached.mask != value.mask)
 	{
-		std::cout << "Failed to load functions" << std::endl;
-		return false;
+		data.stats.issued_state_calls++;
+		GL_CHECK_ERROR(glStencilFuncSeparate(face, value.func, 1, value.mask));
 	}
 	else
+		data.stats.filtered_state_calls++;
+
+	if (cached.fail != value.fail || cached.pass_depth_fail != value.pass_depth_fail || cached.pass_depth_pass != value.pass_depth_pass)
 	{
-		return true;
+		data.stats.issued_state_calls++;
+		GL_CHECK_ERROR(glStencilOpSeparate(face, value.fail, value.pass_depth_fail, value.pass_depth_pass));
 	}
+	else
+		data.stats.filtered_state_calls++;
+
+	cached = value;
 }
 
-Shader* RenderDevice::create_shader(const char* source, uint32_t type)
+// State fields of a PSO. Fields that depend on each other share a bit, e.g. the cull face is only
+// applied while culling is enabled.
+#define PSO_DIFF_DEPTH_TEST    (1 << 0)
+#define PSO_DIFF_DEPTH_FUNC    (1 << 1)
+#define PSO_DIFF_DEPTH_MASK    (1 << 2)
+#define PSO_DIFF_STENCIL_TEST  (1 << 3)
+#define PSO_DIFF_STENCIL_FRONT (1 << 4)
+#define PSO_DIFF_STENCIL_BACK  (1 << 5)
+#define PSO_DIFF_CULL          (1 << 6)
+#define PSO_DIFF_POLYGON_MODE  (1 << 7)
+#define PSO_DIFF_MULTISAMPLE   (1 << 8)
+#define PSO_DIFF_SCISSOR       (1 << 9)
+#define PSO_DIFF_FRONT_FACE    (1 << 10)
+#define PSO_DIFF_PRIMITIVE     (1 << 11)
+#define PSO_DIFF_BLEND         (1 << 12)
+
+#define PSO_DIFF_DEPTH_STENCIL (PSO_DIFF_DEPTH_TEST | PSO_DIFF_DEPTH_FUNC | PSO_DIFF_DEPTH_MASK | PSO_DIFF_STENCIL_TEST | PSO_DIFF_STENCIL_FRONT | PSO_DIFF_STENCIL_BACK)
+#define PSO_DIFF_RASTERIZER    (PSO_DIFF_CULL | PSO_DIFF_POLYGON_MODE | PSO_DIFF_MULTISAMPLE | PSO_DIFF_SCISSOR | PSO_DIFF_FRONT_FACE)
+#define PSO_DIFF_ALL           (PSO_DIFF_DEPTH_STENCIL | PSO_DIFF_RASTERIZER | PSO_DIFF_PRIMITIVE | PSO_DIFF_BLEND)
+
+static uint32_t pso_diff(const PipelineStateObject* from, const PipelineStateObject* to)
 {
-	Shader* shader = new Shader();
-	shader->type = type;
+	const DepthStencilState* a = from->depth_stencil_state;
+	const DepthStencilState* b = to->depth_stencil_state;
+	uint32_t diff = 0;
 
-	GL_CHECK_ERROR(shader->id = glCreateShader(kShaderTypeTable[type]));
-
-	GLint success;
-	GLchar infoLog[512];
+	if (a->enable_depth != b->enable_depth)
+		diff |= PSO_DIFF_DEPTH_TEST;
 
-#if defined(__APPLE__)
-    shader->source = "#version 410 core\n" + std::string(source);
-#else
-    shader->source = "#version 430 core\n" + std::string(source);
-#endif
+	if (a->depth_func != b->depth_func)
+		diff |= PSO_DIFF_DEPTH_FUNC;
 
-	const GLchar* src = shader->source.c_str();
+	if (a->depth_mask != b->depth_mask)
+		diff |= PSO_DIFF_DEPTH_MASK;
 
-	GL_CHECK_ERROR(glShaderSource(shader->id, 1, &src, NULL));
-	GL_CHECK_ERROR(glCompileShader(shader->id));
-	GL_CHECK_ERROR(glGetShaderiv(shader->id, GL_COMPILE_STATUS, &success));
+	if (a->enable_stencil != b->enable_stencil)
+		diff |= PSO_DIFF_STENCIL_TEST;
 
-	if (success == GL_FALSE)
-	{
-		glGetShaderInfoLog(shader->id, 512, NULL, infoLog);
+	if (a->front_stencil_comparison != b->front_stencil_comparison || a->stencil_mask != b->stencil_mask ||
+		a->front_stencil_fail != b->front_stencil_fail || a->front_stencil_pass_depth_fail != b->front_stencil_pass_depth_fail || a->front_stencil_pass_depth_pass != b->front_stencil_pass_depth_pass)
+		diff |= PSO_DIFF_STENCIL_FRONT;
 
-		std::string log_error = "Shader compilation failed";
-		log_error += std::string(infoLog);
+	if (a->back_stencil_comparison != b->back_stencil_comparison || a->stencil_mask != b->stencil_mask ||
+		a->back_stencil_fail != b->back_stencil_fail || a->back_stencil_pass_depth_fail != b->back_stencil_pass_depth_fail || a->back_stencil_pass_depth_pass != b->back_stencil_pass_depth_pass)
+		diff |= PSO_DIFF_STENCIL_BACK;
 
-		std::cout << log_error << std::endl;
+	const RasterizerState* ra = from->rasterizer_state;
+	const RasterizerState* rb = to->rasterizer_state;
 
-		return nullptr;
-	}
+	if (ra->enable_cull_face != rb->enable_cull_face || (rb->enable_cull_face && ra->cull_face != rb->cull_face))
+		diff |= PSO_DIFF_CULL;
 
-	std::cout << "Shader successfully compiled." << std::endl;
+	if (ra->polygon_mode != rb->polygon_mode)
+		diff |= PSO_DIFF_POLYGON_MODE;
 
-	return shader;
-}
+	if (ra->enable_multisample != rb->enable_multisample)
+		diff |= PSO_DIFF_MULTISAMPLE;
 
-ShaderProgram* RenderDevice::create_shader_program(Shader** shaders, uint32_t count)
-{
-	ShaderProgram* shaderProgram = new ShaderProgram();
-	GL_CHECK_ERROR(shaderProgram->id = glCreateProgram());
+	if (ra->enable_scissor != rb->enable_scissor)
+		diff |= PSO_DIFF_SCISSOR;
 
-	for (uint32_t i = 0; i < count; i++)
-	{
-		if (count > 1 && shaders[i]->type == ShaderType::COMPUTE)
-        {
-            delete shaderProgram;
-            return nullptr;
-        }
+	if (ra->enable_front_face_ccw != rb->enable_front_face_ccw)
+		diff |= PSO_DIFF_FRONT_FACE;
 
-		GL_CHECK_ERROR(glAttachShader(shaderProgram->id, shaders[i]->id));
-        shaderProgram->shader_map[shaders[i]->type] = shaders[i];
-	}
+	if (from->primitive != to->primitive)
+		diff |= PSO_DIFF_PRIMITIVE;
 
-	GL_CHECK_ERROR(glLinkProgram(shaderProgram->id));
+	if (memcmp(from->blend_state, to->blend_state, sizeof(BlendState)) != 0)
+		diff |= PSO_DIFF_BLEND;
 
-	GLint success;
-	char infoLog[512];
+	return diff;
+}
 
-	glGetProgramiv(shaderProgram->id, GL_LINK_STATUS, &success);
-	if (!success)
+// Copies the description field by field into zeroed memory so that padding bytes are zero and
+// identical descriptions hash and compare equal byte for byte.
+static void normalize_pso_desc(const PipelineStateObjectCreateDesc& desc, PipelineStateObjectCreateDesc& out)
+{
+	memset(&out, 0, sizeof(PipelineStateObjectCreateDesc));
+
+	out.depth_stencil_state.enable_depth_test = desc.depth_stencil_state.enable_depth_test;
+	out.depth_stencil_state.enable_stencil_test = desc.depth_stencil_state.enable_stencil_test;
+	out.depth_stencil_state.depth_mask = desc.depth_stencil_state.depth_mask;
+	out.depth_stencil_state.depth_cmp_func = desc.depth_stencil_state.depth_cmp_func;
+	out.depth_stencil_state.front_stencil_fail = desc.depth_stencil_state.front_stencil_fail;
+	out.depth_stencil_state.front_stencil_pass_depth_fail = desc.depth_stencil_state.front_stencil_pass_depth_fail;
+	out.depth_stencil_state.front_stencil_pass_depth_pass = desc.depth_stencil_state.front_stencil_pass_depth_pass;
+	out.depth_stencil_state.front_stencil_cmp_func = desc.depth_stencil_state.front_stencil_cmp_func;
+	out.depth_stencil_state.back_stencil_fail = desc.depth_stencil_state.back_stencil_fail;
+	out.depth_stencil_state.back_stencil_pass_depth_fail = desc.depth_stencil_state.back_stencil_pass_depth_fail;
+	out.depth_stencil_state.back_stencil_pass_depth_pass = desc.depth_stencil_state.back_stencil_pass_depth_pass;
+	out.depth_stencil_state.back_stencil_cmp_func = desc.depth_stencil_state.back_stencil_cmp_func;
+	out.depth_stencil_state.stencil_mask = desc.depth_stencil_state.stencil_mask;
+
+	out.rasterizer_state.cull_mode = desc.rasterizer_state.cull_mode;
+	out.rasterizer_state.fill_mode = desc.rasterizer_state.fill_mode;
+	out.rasterizer_state.front_winding_ccw = desc.rasterizer_state.front_winding_ccw;
+	out.rasterizer_state.multisample = desc.rasterizer_state.multisample;
+	out.rasterizer_state.scissor = desc.rasterizer_state.scissor;
+
+	out.blend_state.independent_blend = desc.blend_state.independent_blend;
+
+	// Only the first target matters without independent blending, and the factors only matter
+	// while blending is enabled.
+	uint32_t num_targets = desc.blend_state.independent_blend ? MAX_BLEND_TARGETS : 1;
+
+	for (uint32_t i = 0; i < num_targets; i++)
 	{
-		glGetProgramInfoLog(shaderProgram->id, 512, NULL, infoLog);
-
-		std::string log_error = "Shader program linking failed";
-		log_error += std::string(infoLog);
+		const RenderTargetBlendDesc& target = desc.blend_state.render_targets[i];
+		RenderTargetBlendDesc& target_out = out.blend_state.render_targets[i];
+
+		target_out.enable = target.enable;
+		target_out.color_write_disable = target.color_write_disable & ColorWriteMask::ALL;
+
+		if (target.enable)
+		{
+			target_out.src_color = target.src_color;
+			target_out.dst_color = target.dst_color;
+			target_out.color_op = target.color_op;
+			target_out.src_alpha = target.src_alpha;
+			target_out.dst_alpha = target.dst_alpha;
+			target_out.alpha_op = target.alpha_op;
+		}
+	}
 
-        LOG_ERROR(log_error);
+	out.primitive = desc.primitive;
+}
 
-		return nullptr;
-	}
+// Whether the result of blending a set of draws is the same in any order, so that they can be
+// grouped by state instead of depth sorted: MIN, MAX, or adding a source term that does not
+// depend on the destination.
+static bool blend_equation_commutes(uint32_t src, uint32_t dst, uint32_t op)
+{
+	if (op == BlendOp::MIN || op == BlendOp::MAX)
+		return true;
 
-    // Bind Uniform Buffers
-    for (auto it : shaderProgram->shader_map)
-    {
-        StringList uboList = Utility::find_line("#binding", it.second->source);
+	bool src_independent = src == BlendFactor::ZERO || src == BlendFactor::ONE ||
+						   src == BlendFactor::SRC_COLOR || src == BlendFactor::ONE_MINUS_SRC_COLOR ||
+						   src == BlendFactor::SRC_ALPHA || src == BlendFactor::ONE_MINUS_SRC_ALPHA;
 
-        for (int i = 0; i < uboList.size(); i++)
-        {
-            StringList tokens = Utility::delimit(" ", uboList[i]);
-            std::string uniformName = tokens[3];
-            GLuint binding = (GLuint)atoi(tokens[5].c_str());
-            const GLchar* uniformNameChar = uniformName.c_str();
-            GL_CHECK_ERROR(GLuint uboIndex = glGetUniformBlockIndex(shaderProgram->id, uniformNameChar));
-
-            if (uboIndex == GL_INVALID_INDEX)
-            {
-                String uniform_error = "Failed to get Uniform Block Index for Uniform Buffer : ";
-                uniform_error += uniformName;
-
-                LOG_ERROR(uniform_error);
-            }
-            else
-                GL_CHECK_ERROR(glUniformBlockBinding(shaderProgram->id, uboIndex, binding));
-        }
-    }
+	return op == BlendOp::ADD && dst == BlendFactor::ONE && src_independent;
+}
 
-    // Bind Uniform Samplers
-    for (auto it : shaderProgram->shader_map)
-    {
-        StringList samplerList = Utility::find_line("uniform sampler", it.second->source);
+static bool blend_is_order_independent(const BlendStateCreateDesc& desc)
+{
+	uint32_t num_targets = desc.independent_blend ? MAX_BLEND_TARGETS : 1;
 
-        for (int i = 0; i < samplerList.size(); i++)
-        {
-            StringList tokens = Utility::delimit(" ", samplerList[i]);
-            std::string uniformName = tokens[2];
-            uniformName.erase(uniformName.end() - 1, uniformName.end());
+	for (uint32_t i = 0; i < num_targets; i++)
+	{
+		const RenderTargetBlendDesc& target = desc.render_targets[i];
 
-            GLuint binding = (GLuint)atoi(tokens[4].c_str());
-            const GLchar* uniformNameChar = uniformName.c_str();
-            GL_CHECK_ERROR(GLuint location = glGetUniformLocation(shaderProgram->id, uniformNameChar));
+		if ((target.color_write_disable & ColorWriteMask::ALL) == ColorWriteMask::ALL)
+			continue;
 
-            if (location == GL_INVALID_INDEX)
-            {
-                String uniform_error = "Failed to get Uniform Location for Uniform : ";
-                uniform_error += uniformName;
+		if (!target.enable)
+			return false;
 
-                LOG_ERROR(uniform_error);
-            }
+		bool color = (target.color_write_disable & (ColorWriteMask::RED | ColorWriteMask::GREEN | ColorWriteMask::BLUE)) == (ColorWriteMask::RED | ColorWriteMask::GREEN | ColorWriteMask::BLUE) ||
+					 blend_equation_commutes(target.src_color, target.dst_color, target.color_op);
+		bool alpha = (target.color_write_disable & ColorWriteMask::ALPHA) != 0 ||
+					 blend_equation_commutes(target.src_alpha, target.dst_alpha, target.alpha_op);
 
-            it.second->sampler_bindings[binding] = location;
-        }
-    }
+		if (!color || !alpha)
+			return false;
+	}
 
-	return shaderProgram;
+	return true;
 }
 
-void RenderDevice::attach_render_target(Framebuffer* framebuffer, Texture* render_target)
+// Zeroes everything that has no effect on the resulting sampler, so that equivalent descriptions
+// share one: the border color unless a wrap mode uses it, and the anisotropy unless anisotropic
+// filtering is requested, in which case it is clamped to what the device supports.
+static void normalize_sampler_desc(const SamplerStateCreateDesc& desc, float device_max_anisotropy, SamplerStateCreateDesc& out)
 {
-	framebuffer->render_targets[framebuffer->num_render_targets++] = render_target;
-
-	GL_CHECK_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->id));
-	GL_CHECK_ERROR(glBindTexture(render_target->gl_texture_target, framebuffer->id));
-	GL_CHECK_ERROR(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + (framebuffer->num_render_targets - 1),
-		render_target->gl_texture_target,
-		render_target->id, 0));
+	memset(&out, 0, sizeof(SamplerStateCreateDesc));
 
-	std::vector<GLuint> drawBuffers;
+	out.min_filter = desc.min_filter;
+	out.mag_filter = desc.mag_filter;
+	out.wrap_mode_u = desc.wrap_mode_u;
+	out.wrap_mode_v = desc.wrap_mode_v;
+	out.wrap_mode_w = desc.wrap_mode_w;
 
-	for (int i = 0; i < framebuffer->num_render_targets; i++)
-		drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+	if (desc.wrap_mode_u == TextureWrapMode::CLAMP_TO_BORDER || desc.wrap_mode_v == TextureWrapMode::CLAMP_TO_BORDER || desc.wrap_mode_w == TextureWrapMode::CLAMP_TO_BORDER)
+		memcpy(&out.border_color[0], &desc.border_color[0], sizeof(out.border_color));
 
-	GL_CHECK_ERROR(glDrawBuffers(framebuffer->num_render_targets, &drawBuffers[0]));
+	bool anisotropic = desc.min_filter == TextureFilteringMode::ANISOTROPIC_ALL || desc.mag_filter == TextureFilteringMode::ANISOTROPIC_ALL;
 
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    
-	GL_CHECK_ERROR(glBindTexture(render_target->gl_texture_target, 0));
-	GL_CHECK_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	if (anisotropic && desc.max_anisotropy > 1.0f && device_max_anisotropy > 1.0f)
+		out.max_anisotropy = desc.max_anisotropy < device_max_anisotropy ? desc.max_anisotropy : device_max_anisotropy;
 }
 
-void RenderDevice::attach_depth_stencil_target(Framebuffer* framebuffer, Texture* render_target)
+// Immutable storage can only be updated after creation if it was requested up front.
+static GLbitfield buffer_storage_flags(const BufferCreateDesc& desc)
 {
-	framebuffer->depth_target = render_target;
-	GL_CHECK_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->id));
-	GL_CHECK_ERROR(glBindTexture(render_target->gl_texture_target, framebuffer->id));
-	GL_CHECK_ERROR(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, render_target->gl_texture_target, render_target->id, 0));
-    
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    
-	GL_CHECK_ERROR(glBindTexture(render_target->gl_texture_target, 0));
-	GL_CHECK_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	if (desc.usage_type == BufferUsageType::STATIC && desc.data)
+		return 0;
+
+	return GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_WRITE_BIT;
 }
 
-Framebuffer* RenderDevice::create_framebuffer(const FramebufferCreateDesc& desc)
+static GLsizei texture_mip_levels(uint16_t width, uint16_t height, uint16_t depth, bool generate_mipmaps, uint16_t mipmap_levels)
 {
-	Framebuffer* framebuffer = new Framebuffer();
-    
-    framebuffer->num_render_targets = 0;
+	GLsizei levels = 1;
+	uint16_t size = width > height ? width : height;
 
-	GL_CHECK_ERROR(glGenFramebuffers(1, &framebuffer->id));
+	size = size > depth ? size : depth;
 
-	for (int i = 0; i < desc.num_render_targets; i++)
-		attach_render_target(framebuffer, desc.render_targets[i]);
+	while (size > 1)
+	{
+		size >>= 1;
+		levels++;
+	}
 
-	if (desc.depth_target)
-		attach_depth_stencil_target(framebuffer, desc.depth_target);
+	// Immutable storage rejects chains longer than the full one.
+	if (mipmap_levels > 0)
+		return mipmap_levels < levels ? mipmap_levels : levels;
 
-	return framebuffer;
+	return generate_mipmaps ? levels : 1;
 }
 
-
-VertexBuffer* RenderDevice::create_vertex_buffer(const BufferCreateDesc& desc)
+// Bytes per 4x4 block for block compressed formats, 0 for everything else.
+static uint32_t compressed_block_size(GLenum internal_format)
 {
-	VertexBuffer* buffer = new VertexBuffer();
-	GL_CHECK_ERROR(glGenBuffers(1, &buffer->id));
-
-	GLenum glusageType = kBufferUsageTable[desc.usage_type];
+	switch (internal_format)
+	{
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RED_RGTC1:
+			return 8;
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_RG_RGTC2:
+		case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+			return 16;
+		default:
+			return 0;
+	}
+}
 
-	buffer->buffer_type = GL_ARRAY_BUFFER;
-	buffer->data = desc.data;
-	buffer->size = desc.size;
-	buffer->usage_type = glusageType;
+static GLsizei compressed_image_size(uint32_t block_size, GLsizei width, GLsizei height)
+{
+	return ((width + 3) / 4) * ((height + 3) / 4) * block_size;
+}
 
-	return buffer;
+static uint32_t index_type_size(GLenum type)
+{
+	return type == GL_UNSIGNED_INT ? 4 : (type == GL_UNSIGNED_SHORT ? 2 : 1);
 }
 
-UniformBuffer* RenderDevice::create_uniform_buffer(const BufferCreateDesc& desc)
+static GLenum depth_attachment_point(GLenum internal_format)
 {
-	UniformBuffer* buffer = new UniformBuffer();
-	GL_CHECK_ERROR(glGenBuffers(1, &buffer->id));
+	if (internal_format == GL_DEPTH24_STENCIL8 || internal_format == GL_DEPTH32F_STENCIL8)
+		return GL_DEPTH_STENCIL_ATTACHMENT;
 
-	GLenum glusageType = kBufferUsageTable[desc.usage_type];
+	return GL_DEPTH_ATTACHMENT;
+}
 
-	GL_CHECK_ERROR(glBindBuffer(GL_UNIFORM_BUFFER, buffer->id));
-	GL_CHECK_ERROR(glBufferData(GL_UNIFORM_BUFFER, desc.size, desc.data, glusageType));
-	GL_CHECK_ERROR(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+GLCallSite g_gl_call_site = { "", 0 };
 
-	buffer->buffer_type = GL_UNIFORM_BUFFER;
-	buffer->data = desc.data;
-	buffer->size = desc.size;
-	buffer->usage_type = glusageType;
+void gl_check_errors(const char* file, int line)
+{
+	GLenum err = glGetError();
 
-	return buffer;
+	while (err != GL_NO_ERROR)
+	{
+		const char* error = "UNKNOWN_ERROR";
+
+		switch (err)
+		{
+			case GL_INVALID_OPERATION:				error = "INVALID_OPERATION";				break;
+			case GL_INVALID_ENUM:					error = "INVALID_ENUM";						break;
+			case GL_INVALID_VALUE:					error = "INVALID_VALUE";					break;
+			case GL_OUT_OF_MEMORY:					error = "OUT_OF_MEMORY";					break;
+			case GL_INVALID_FRAMEBUFFER_OPERATION:	error = "INVALID_FRAMEBUFFER_OPERATION";	break;
+		}
+
+		std::string formatted_error = "OPENGL ERROR : ";
+		formatted_error += error;
+
+		Logger::log(formatted_error, std::string(file), line, LogLevel::ERR);
+		err = glGetError();
+	}
 }
 
-IndexBuffer* RenderDevice::create_index_buffer(const BufferCreateDesc& desc)
+#if defined(GFX_ERROR_CHECK_ASYNC)
+static void APIENTRY gl_debug_callback(GLenum /* source */, GLenum type, GLuint /* id */, GLenum severity, GLsizei /* length */, const GLchar* message, const void* /* user_param */)
 {
-	IndexBuffer* buffer = new IndexBuffer();
-	GL_CHECK_ERROR(glGenBuffers(1, &buffer->id));
+	if (severity == GL_DEBUG_SEVERITY_NOTIFICATION)
+		return;
 
-	GLenum glusageType = kBufferUsageTable[desc.usage_type];
+	std::string formatted_error = "OPENGL DEBUG : ";
+	formatted_error += message;
 
-	buffer->buffer_type = GL_ELEMENT_ARRAY_BUFFER;
-	buffer->data = desc.data;
-	buffer->size = desc.size;
-	buffer->usage_type = glusageType;
-	buffer->type = kBufferDataTypeTable[desc.data_type];
+	LogLevel level = LogLevel::INFO;
 
-	return buffer;
+	if (type == GL_DEBUG_TYPE_ERROR || severity == GL_DEBUG_SEVERITY_HIGH)
+		level = LogLevel::ERR;
+	else if (severity == GL_DEBUG_SEVERITY_MEDIUM)
+		level = LogLevel::WARNING;
+
+	// The call site is the last GL_CHECK_ERROR executed on the GL thread, which is exact when
+	// debug output is synchronous and the nearest preceding call otherwise.
+	Logger::log(formatted_error, std::string(g_gl_call_site.file), g_gl_call_site.line, level);
 }
+#endif
 
-InputLayout* RenderDevice::create_input_layout(const InputLayoutCreateDesc& desc)
+RenderDevice::RenderDevice()
 {
-    InputLayout* ia  = new InputLayout();
-    
-    memcpy(&ia->elements[0], &desc.elements[0], sizeof(InputElement) * desc.num_elements);
-    
-    ia->num_elements = desc.num_elements;
-    ia->vertex_size  = desc.vertex_size;
-    
-    return ia;
+    invalidate_state_cache();
+    memset(&m_device_data.stats, 0, sizeof(DeviceFrameStats));
 }
 
-VertexArray* RenderDevice::create_vertex_array(const VertexArrayCreateDesc& desc)
+RenderDevice::~RenderDevice()
 {
-	VertexArray* vertexArray = new VertexArray();
-	vertexArray->ib = desc.index_buffer;
-	vertexArray->vb = desc.vertex_buffer;
-
-	GL_CHECK_ERROR(glGenVertexArrays(1, &vertexArray->id));
-	GL_CHECK_ERROR(glBindVertexArray(vertexArray->id));
-
-	GL_CHECK_ERROR(glBindBuffer(GL_ARRAY_BUFFER, desc.vertex_buffer->id));
-	GL_CHECK_ERROR(glBufferData(GL_ARRAY_BUFFER, desc.vertex_buffer->size, desc.vertex_buffer->data, desc.vertex_buffer->usage_type));
+    
+}
 
-    if(desc.index_buffer)
-    {
-        GL_CHECK_ERROR(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, desc.index_buffer->id));
-        GL_CHECK_ERROR(glBufferData(GL_ELEMENT_ARRAY_BUFFER, desc.index_buffer->size, desc.index_buffer->data, desc.index_buffer->usage_type));
-    }
-	
-	for (uint32_t i = 0; i < desc.layout->num_elements; i++)
+bool RenderDevice::init(GLADloadproc loader)
+{
+	if (!(loader ? gladLoadGLLoader(loader) : gladLoadGL()))
 	{
-		GL_CHECK_ERROR(glEnableVertexAttribArray(i));
-		GL_CHECK_ERROR(glVertexAttribPointer(i, 
-										     desc.layout->elements[i].num_sub_elements,
-											 kBufferDataTypeTable[desc.layout->elements[i].type],
-											 desc.layout->elements[i].normalized,
-											 desc.layout->vertex_size,
-											 (GLvoid*)((uint64_t)desc.layout->elements[i].offset)));
+		std::cout << "Failed to load functions" << std::endl;
+		return false;
 	}
+	else
+	{
+#if defined(GFX_ERROR_CHECK_ASYNC)
+		if (GLAD_GL_VERSION_4_3)
+		{
+			glDebugMessageCallback(gl_debug_callback, nullptr);
+			glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+			set_debug_output(true, false);
+		}
+		else
+			LOG_WARNING("KHR_debug unavailable, OpenGL errors will not be reported.");
+#endif
 
-	GL_CHECK_ERROR(glBindVertexArray(0));
-	GL_CHECK_ERROR(glBindBuffer(GL_ARRAY_BUFFER, 0));
-	GL_CHECK_ERROR(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+		m_device_data.dsa = GLAD_GL_VERSION_4_5 != 0;
+		m_device_data.program_interface_query = GLAD_GL_VERSION_4_3 != 0;
+		m_device_data.parallel_shader_compile = false;
+		m_device_data.indirect_count = GLAD_GL_VERSION_4_6 != 0;
+		m_device_data.draw_parameters = GLAD_GL_VERSION_4_6 != 0;
 
-	return vertexArray;
-}
+		GLint num_extensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
 
-Texture2D* RenderDevice::create_texture_2d(const Texture2DCreateDesc& desc)
-{
-	Texture2D* texture = new Texture2D();
+		for (GLint i = 0; i < num_extensions; i++)
+		{
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
 
-	GL_CHECK_ERROR(glGenTextures(1, &texture->id));
-	texture->gl_texture_target = GL_TEXTURE_2D;
+			if (strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 || strcmp(extension, "GL_ARB_parallel_shader_compile") == 0)
+				m_device_data.parallel_shader_compile = true;
 
-	GL_CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, texture->id));
+			if (strcmp(extension, "GL_ARB_shader_draw_parameters") == 0)
+				m_device_data.draw_parameters = true;
 
-	GLenum internalFormat, format, type;
+			// ARB_indirect_parameters is not part of the generated loader. Its entry point has the
+			// same signature as the core 4.6 one, so it is loaded in its place when a loader is given.
+			if (!m_device_data.indirect_count && loader && strcmp(extension, "GL_ARB_indirect_parameters") == 0)
+			{
+				glad_glMultiDrawElementsIndirectCount = (PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC)loader("glMultiDrawElementsIndirectCountARB");
+				m_device_data.indirect_count = glad_glMultiDrawElementsIndirectCount != nullptr;
+			}
+		}
 
-	internalFormat = kTextureFormatTable[desc.format][0];
-    format = kTextureFormatTable[desc.format][1];
-	type = kTextureFormatTable[desc.format][2];
-    // @TODO: Handle formats. GL_RED, GL_RG, GL_RGB, GL_BGR, GL_RGBA, GL_BGRA, GL_RED_INTEGER, GL_RG_INTEGER, GL_RGB_INTEGER, GL_BGR_INTEGER,
-    // GL_RGBA_INTEGER, GL_BGRA_INTEGER, GL_STENCIL_INDEX, GL_DEPTH_COMPONENT, GL_DEPTH_STENCIL
+		// Program binaries are only valid for the exact driver that produced them.
+		const char* driver_strings[] = { (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION) };
+		m_device_data.driver_hash = Utility::hash_fnv1a(nullptr, 0);
 
-	GL_CHECK_ERROR(glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, desc.width, desc.height, 0, format, type, desc.data));
+		for (int i = 0; i < 3; i++)
+		{
+			if (driver_strings[i])
+				m_device_data.driver_hash = Utility::hash_fnv1a(driver_strings[i], strlen(driver_strings[i]), m_device_data.driver_hash);
+		}
 
-	if (desc.generate_mipmaps)
-	{
-		GL_CHECK_ERROR(glGenerateMipmap(GL_TEXTURE_2D));
-	}
+		// Limits are queried once here, querying them at creation time stalls on the driver.
+		if (GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_texture_filter_anisotropic || GLAD_GL_EXT_texture_filter_anisotropic)
+			glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &m_device_data.max_anisotropy);
 
-	GL_CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, 0));
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_device_data.uniform_buffer_alignment);
 
-	return texture;
+		if (GLAD_GL_VERSION_4_3)
+			glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &m_device_data.storage_buffer_alignment);
+
+		// Texture data is always tightly packed, including RGB8 rows of odd widths.
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		invalidate_state_cache();
+		return true;
+	}
 }
 
-RasterizerState* RenderDevice::create_rasterizer_state(const RasterizerStateCreateDesc& desc)
+void RenderDevice::set_debug_output(bool enabled, bool synchronous)
 {
-	RasterizerState* rasterizerState = new RasterizerState();
-
-	rasterizerState->cull_face = kCullModeTable[desc.cull_mode];
-	rasterizerState->enable_cull_face = desc.cull_mode != CullMode::NONE;
-	rasterizerState->polygon_mode = kFillModeTable[desc.fill_mode];
-	rasterizerState->enable_multisample = desc.multisample;
-	rasterizerState->enable_scissor = desc.scissor;
-	rasterizerState->enable_front_face_ccw = desc.front_winding_ccw;
+#if defined(GFX_ERROR_CHECK_ASYNC)
+	if (enabled)
+		glEnable(GL_DEBUG_OUTPUT);
+	else
+		glDisable(GL_DEBUG_OUTPUT);
 
-	return rasterizerState;
+	if (synchronous)
+		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	else
+		glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#else
+	(void)enabled;
+	(void)synchronous;
+#endif
 }
 
-DepthStencilState* RenderDevice::create_depth_stencil_state(const DepthStencilStateCreateDesc& desc)
+Shader* RenderDevice::create_shader(const char* source, uint32_t type)
 {
-	DepthStencilState* depthStencilState = new DepthStencilState();
+	Shader* shader = allocate_shader(source, type);
 
-	// Set Depth Options
+	if (!shader)
+		return nullptr;
 
-	depthStencilState->enable_depth = desc.enable_depth_test;
-	depthStencilState->depth_func = kComparisonFunctionTable[desc.depth_cmp_func];
-	depthStencilState->depth_mask = (desc.depth_mask) ? GL_TRUE : GL_FALSE;
+	// With the program cache enabled compilation is deferred until the program is created, so
+	// that a cache hit skips it entirely.
+	if (!m_device_data.program_cache_enabled)
+	{
+		begin_shader_compile(shader);
 
-	// Set Stencil Options
+		if (!end_shader_compile(shader))
+		{
+			GL_CHECK_ERROR(glDeleteShader(shader->id));
+			m_device_data.shader_pool.free(shader);
 
-	depthStencilState->enable_stencil = desc.enable_stencil_test;
-	depthStencilState->front_stencil_comparison = kComparisonFunctionTable[0];
-	depthStencilState->back_stencil_comparison = kComparisonFunctionTable[desc.back_stencil_cmp_func];
+			return nullptr;
+		}
+	}
 
-	// Front Stencil Operation
+	return shader;
+}
 
-	depthStencilState->front_stencil_fail = kStencilOperationTable[desc.front_stencil_fail];
-	depthStencilState->front_stencil_pass_depth_pass = kStencilOperationTable[desc.front_stencil_pass_depth_pass];
-	depthStencilState->front_stencil_pass_depth_fail = kStencilOperationTable[desc.front_stencil_pass_depth_fail];
+Shader* RenderDevice::create_shader_async(const char* source, uint32_t type)
+{
+	Shader* shader = allocate_shader(source, type);
 
-	// Back Stencil Operation
+	if (!shader)
+		return nullptr;
 
-	depthStencilState->back_stencil_fail = kStencilOperationTable[desc.back_stencil_fail];
-	depthStencilState->back_stencil_pass_depth_pass = kStencilOperationTable[desc.back_stencil_pass_depth_pass];
-	depthStencilState->back_stencil_pass_depth_fail = kStencilOperationTable[desc.back_stencil_pass_depth_fail];
-	depthStencilState->stencil_mask = desc.stencil_mask;
+	if (!m_device_data.program_cache_enabled)
+		begin_shader_compile(shader);
 
-	return depthStencilState;
+	return shader;
 }
 
-PipelineStateObject* RenderDevice::create_pipeline_state_object(const PipelineStateObjectCreateDesc& desc)
+Shader* RenderDevice::allocate_shader(const char* source, uint32_t type)
 {
+	Shader* shader = m_device_data.shader_pool.allocate();
+
+	if (!shader)
+	{
+		LOG_ERROR("Shader pool is full");
+		return nullptr;
+	}
+
+	shader->type = type;
+	shader->compiled = false;
+	shader->pending = false;
+
+	GL_CHECK_ERROR(shader->id = glCreateShader(kShaderTypeTable[type]));
+
+#if defined(__APPLE__)
+    shader->source = "#version 410 core\n" + std::string(source);
+#else
+    shader->source = "#version 430 core\n" + std::string(source);
+#endif
+
+	return shader;
+}
+
+void RenderDevice::begin_shader_compile(Shader* shader)
+{
+	const GLchar* src = shader->source.c_str();
+
+	GL_CHECK_ERROR(glShaderSource(shader->id, 1, &src, NULL));
+	GL_CHECK_ERROR(glCompileShader(shader->id));
+
+	shader->pending = true;
+}
+
+bool RenderDevice::end_shader_compile(Shader* shader)
+{
+	GLint success;
+	GLchar infoLog[512];
+
+	shader->pending = false;
+
+	GL_CHECK_ERROR(glGetShaderiv(shader->id, GL_COMPILE_STATUS, &success));
+
+	if (success == GL_FALSE)
+	{
+		glGetShaderInfoLog(shader->id, 512, NULL, infoLog);
+
+		std::string log_error = "Shader compilation failed";
+		log_error += std::string(infoLog);
+
+		std::cout << log_error << std::endl;
+
+		return false;
+	}
+
+	std::cout << "Shader successfully compiled." << std::endl;
+
+	shader->compiled = true;
+
+	return true;
+}
+
+ShaderProgram* RenderDevice::create_shader_program(Shader** shaders, uint32_t count)
+{
+	ShaderProgram* shaderProgram = allocate_shader_program(shaders, count);
+
+	if (!shaderProgram)
+		return nullptr;
+
+	if (shaderProgram->status == ProgramStatus::PENDING)
+	{
+		begin_program_link(shaderProgram, shaders, count);
+
+		if (!finish_shader_program(shaderProgram))
+		{
+			GL_CHECK_ERROR(glDeleteProgram(shaderProgram->id));
+			m_device_data.shader_program_pool.free(shaderProgram);
+
+			return nullptr;
+		}
+	}
+
+	return shaderProgram;
+}
+
+ShaderProgram* RenderDevice::create_shader_program_async(Shader** shaders, uint32_t count)
+{
+	ShaderProgram* shaderProgram = allocate_shader_program(shaders, count);
+
+	if (shaderProgram && shaderProgram->status == ProgramStatus::PENDING)
+		begin_program_link(shaderProgram, shaders, count);
+
+	return shaderProgram;
+}
+
+ShaderProgram* RenderDevice::allocate_shader_program(Shader** shaders, uint32_t count)
+{
+	ShaderProgram* shaderProgram = m_device_data.shader_program_pool.allocate();
+
+	if (!shaderProgram)
+	{
+		LOG_ERROR("Shader Program pool is full");
+		return nullptr;
+	}
+
+	GL_CHECK_ERROR(shaderProgram->id = glCreateProgram());
+
+	uint64_t cache_key = m_device_data.driver_hash;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (count > 1 && shaders[i]->type == ShaderType::COMPUTE)
+        {
+            GL_CHECK_ERROR(glDeleteProgram(shaderProgram->id));
+            m_device_data.shader_program_pool.free(shaderProgram);
+            return nullptr;
+        }
+
+        shaderProgram->shader_map[shaders[i]->type] = shaders[i];
+
+		cache_key = Utility::hash_fnv1a(&shaders[i]->type, sizeof(uint32_t), cache_key);
+		cache_key = Utility::hash_fnv1a(shaders[i]->source.c_str(), shaders[i]->source.size(), cache_key);
+	}
+
+	shaderProgram->cache_key = cache_key;
+	shaderProgram->status = ProgramStatus::PENDING;
+
+	if (m_device_data.program_cache_enabled && load_program_binary(shaderProgram, cache_key))
+	{
+		shaderProgram->status = ProgramStatus::READY;
+		reflect_program_bindings(shaderProgram);
+	}
+
+	return shaderProgram;
+}
+
+void RenderDevice::begin_program_link(ShaderProgram* program, Shader** shaders, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (!shaders[i]->compiled && !shaders[i]->pending)
+			begin_shader_compile(shaders[i]);
+
+		GL_CHECK_ERROR(glAttachShader(program->id, shaders[i]->id));
+	}
+
+	if (m_device_data.program_cache_enabled)
+	{
+		GL_CHECK_ERROR(glProgramParameteri(program->id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+	}
+
+	// No status is queried here. With KHR_parallel_shader_compile the driver compiles and links on
+	// its own threads, otherwise the work still overlaps with whatever the caller does next.
+	GL_CHECK_ERROR(glLinkProgram(program->id));
+}
+
+bool RenderDevice::finish_shader_program(ShaderProgram* program)
+{
+	if (program->status != ProgramStatus::PENDING)
+		return program->status == ProgramStatus::READY;
+
+	program->status = ProgramStatus::FAILED;
+
+	// The link has been issued, so the compile status queries below do not stall on their own.
+	for (auto it : program->shader_map)
+	{
+		if (it.second->pending && !end_shader_compile(it.second))
+			return false;
+	}
+
+	GLint success;
+	char infoLog[512];
+
+	glGetProgramiv(program->id, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glGetProgramInfoLog(program->id, 512, NULL, infoLog);
+
+		std::string log_error = "Shader program linking failed";
+		log_error += std::string(infoLog);
+
+        LOG_ERROR(log_error);
+
+		return false;
+	}
+
+	if (m_device_data.program_cache_enabled)
+		store_program_binary(program, program->cache_key);
+
+	reflect_program_bindings(program);
+
+	program->status = ProgramStatus::READY;
+
+	return true;
+}
+
+uint32_t RenderDevice::shader_program_status(ShaderProgram* program)
+{
+	if (program->status == ProgramStatus::PENDING)
+	{
+		if (m_device_data.parallel_shader_compile)
+		{
+			GLint complete = GL_FALSE;
+			GL_CHECK_ERROR(glGetProgramiv(program->id, GL_COMPLETION_STATUS_KHR, &complete));
+
+			if (complete == GL_FALSE)
+				return ProgramStatus::PENDING;
+		}
+
+		finish_shader_program(program);
+	}
+
+	return program->status;
+}
+
+void RenderDevice::set_placeholder_program(ShaderProgram* program)
+{
+	if (program && !finish_shader_program(program))
+	{
+		LOG_ERROR("Placeholder program is not usable.");
+		return;
+	}
+
+	m_device_data.placeholder_program = program;
+}
+
+static bool is_sampler_type(GLenum type)
+{
+	switch (type)
+	{
+		case GL_SAMPLER_1D:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_3D:
+		case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_1D_SHADOW:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_1D_ARRAY:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_1D_ARRAY_SHADOW:
+		case GL_SAMPLER_2D_ARRAY_SHADOW:
+		case GL_SAMPLER_2D_MULTISAMPLE:
+		case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+		case GL_SAMPLER_CUBE_SHADOW:
+		case GL_SAMPLER_CUBE_MAP_ARRAY:
+		case GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW:
+		case GL_SAMPLER_BUFFER:
+		case GL_SAMPLER_2D_RECT:
+		case GL_SAMPLER_2D_RECT_SHADOW:
+		case GL_INT_SAMPLER_1D:
+		case GL_INT_SAMPLER_2D:
+		case GL_INT_SAMPLER_3D:
+		case GL_INT_SAMPLER_CUBE:
+		case GL_INT_SAMPLER_1D_ARRAY:
+		case GL_INT_SAMPLER_2D_ARRAY:
+		case GL_INT_SAMPLER_2D_MULTISAMPLE:
+		case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+		case GL_INT_SAMPLER_CUBE_MAP_ARRAY:
+		case GL_INT_SAMPLER_BUFFER:
+		case GL_INT_SAMPLER_2D_RECT:
+		case GL_UNSIGNED_INT_SAMPLER_1D:
+		case GL_UNSIGNED_INT_SAMPLER_2D:
+		case GL_UNSIGNED_INT_SAMPLER_3D:
+		case GL_UNSIGNED_INT_SAMPLER_CUBE:
+		case GL_UNSIGNED_INT_SAMPLER_1D_ARRAY:
+		case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+		case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
+		case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+		case GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY:
+		case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+		case GL_UNSIGNED_INT_SAMPLER_2D_RECT:
+			return true;
+		default:
+			return false;
+	}
+}
+
+void RenderDevice::reflect_program_bindings(ShaderProgram* program)
+{
+	program->num_uniform_blocks = 0;
+	program->num_samplers = 0;
+	program->sampler_mask = 0;
+
+	GLint num_blocks = 0;
+	GLint num_uniforms = 0;
+
+	if (m_device_data.program_interface_query)
+	{
+		GL_CHECK_ERROR(glGetProgramInterfaceiv(program->id, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &num_blocks));
+		GL_CHECK_ERROR(glGetProgramInterfaceiv(program->id, GL_UNIFORM, GL_ACTIVE_RESOURCES, &num_uniforms));
+	}
+	else
+	{
+		GL_CHECK_ERROR(glGetProgramiv(program->id, GL_ACTIVE_UNIFORM_BLOCKS, &num_blocks));
+		GL_CHECK_ERROR(glGetProgramiv(program->id, GL_ACTIVE_UNIFORMS, &num_uniforms));
+	}
+
+	// Uniform Blocks
+
+	for (GLint i = 0; i < num_blocks && program->num_uniform_blocks < MAX_UNIFORM_BUFFER_SLOTS; i++)
+	{
+		GLint values[2] = { 0, 0 };
+
+		if (m_device_data.program_interface_query)
+		{
+			const GLenum props[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+			GL_CHECK_ERROR(glGetProgramResourceiv(program->id, GL_UNIFORM_BLOCK, i, 2, props, 2, NULL, values));
+		}
+		else
+		{
+			// GLSL 4.10 has no layout(binding), so blocks are assigned consecutive slots in active order.
+			values[0] = i;
+			GL_CHECK_ERROR(glUniformBlockBinding(program->id, i, i));
+			GL_CHECK_ERROR(glGetActiveUniformBlockiv(program->id, i, GL_UNIFORM_BLOCK_DATA_SIZE, &values[1]));
+		}
+
+		UniformBlockBinding& block = program->uniform_blocks[program->num_uniform_blocks++];
+		block.binding = values[0];
+		block.size = values[1];
+	}
+
+	// Samplers
+
+	for (GLint i = 0; i < num_uniforms && program->num_samplers < MAX_TEXTURE_UNITS; i++)
+	{
+		GLint type = 0;
+		GLint location = -1;
+
+		if (m_device_data.program_interface_query)
+		{
+			const GLenum props[] = { GL_TYPE, GL_LOCATION };
+			GLint values[2];
+			GL_CHECK_ERROR(glGetProgramResourceiv(program->id, GL_UNIFORM, i, 2, props, 2, NULL, values));
+
+			type = values[0];
+			location = values[1];
+		}
+		else
+		{
+			GLchar name[256];
+			GLint size;
+			GLenum gl_type;
+			GL_CHECK_ERROR(glGetActiveUniform(program->id, i, sizeof(name), NULL, &size, &gl_type, name));
+			GL_CHECK_ERROR(location = glGetUniformLocation(program->id, name));
+
+			type = gl_type;
+		}
+
+		if (location < 0 || !is_sampler_type(type))
+			continue;
+
+		GLint unit = 0;
+
+		if (m_device_data.program_interface_query)
+		{
+			GL_CHECK_ERROR(glGetUniformiv(program->id, location, &unit));
+		}
+		else
+		{
+			// Same as above: without layout(binding) samplers get consecutive units, set once here.
+			unit = program->num_samplers;
+			GL_CHECK_ERROR(glProgramUniform1i(program->id, location, unit));
+		}
+
+		SamplerBinding& sampler = program->samplers[program->num_samplers++];
+		sampler.location = location;
+		sampler.unit = unit;
+		sampler.type = type;
+
+		if (unit < 32)
+			program->sampler_mask |= 1u << unit;
+	}
+}
+
+void RenderDevice::set_program_cache_directory(const char* path)
+{
+	GLint num_formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+
+	if (num_formats == 0)
+	{
+		LOG_WARNING("Driver does not support program binaries, program cache disabled.");
+		m_device_data.program_cache_enabled = false;
+		return;
+	}
+
+	m_device_data.program_cache_dir = path ? path : "";
+	m_device_data.program_cache_enabled = path != nullptr;
+}
+
+static std::string program_cache_path(const std::string& dir, uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.glbin", (unsigned long long)key);
+
+	return dir + "/" + name;
+}
+
+bool RenderDevice::load_program_binary(ShaderProgram* program, uint64_t key)
+{
+	std::ifstream file(program_cache_path(m_device_data.program_cache_dir, key), std::ios::binary);
+
+	if (!file.is_open())
+		return false;
+
+	ProgramBinaryHeader header;
+	file.read((char*)&header, sizeof(ProgramBinaryHeader));
+
+	if (!file || header.magic != PROGRAM_BINARY_MAGIC || header.key != key || header.length == 0)
+		return false;
+
+	std::vector<char> binary(header.length);
+	file.read(&binary[0], header.length);
+
+	if (!file)
+		return false;
+
+	GL_CHECK_ERROR(glProgramBinary(program->id, header.format, &binary[0], header.length));
+
+	// The driver is free to reject binaries, e.g. after an update. Fall back to compiling from source.
+	GLint success = GL_FALSE;
+	glGetProgramiv(program->id, GL_LINK_STATUS, &success);
+
+	return success == GL_TRUE;
+}
+
+void RenderDevice::store_program_binary(ShaderProgram* program, uint64_t key)
+{
+	GLint length = 0;
+	GL_CHECK_ERROR(glGetProgramiv(program->id, GL_PROGRAM_BINARY_LENGTH, &length));
+
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+
+	ProgramBinaryHeader header;
+	header.magic = PROGRAM_BINARY_MAGIC;
+	header.key = key;
+	header.length = 0;
+	header.format = 0;
+	header.reserved = 0;
+
+	GLsizei written = 0;
+	GL_CHECK_ERROR(glGetProgramBinary(program->id, length, &written, &header.format, &binary[0]));
+
+	header.length = (uint32_t)written;
+
+	std::ofstream file(program_cache_path(m_device_data.program_cache_dir, key), std::ios::binary | std::ios::trunc);
+
+	if (!file.is_open())
+	{
+		LOG_WARNING("Failed to write program binary to cache.");
+		return;
+	}
+
+	file.write((const char*)&header, sizeof(ProgramBinaryHeader));
+	file.write(&binary[0], written);
+}
+
+void RenderDevice::attach_render_target(Framebuffer* framebuffer, Texture* render_target)
+{
+	framebuffer->render_targets[framebuffer->num_render_targets++] = render_target;
+
+	GLenum attachment = GL_COLOR_ATTACHMENT0 + (framebuffer->num_render_targets - 1);
+	GLenum draw_buffers[MAX_RENDER_TARGETS];
+
+	for (int i = 0; i < framebuffer->num_render_targets; i++)
+		draw_buffers[i] = GL_COLOR_ATTACHMENT0 + i;
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glNamedFramebufferTexture(framebuffer->id, attachment, render_target->id, 0));
+		GL_CHECK_ERROR(glNamedFramebufferDrawBuffers(framebuffer->id, framebuffer->num_render_targets, &draw_buffers[0]));
+
+		if (glCheckNamedFramebufferStatus(framebuffer->id, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			LOG_WARNING("Framebuffer not complete!");
+	}
+	else
+	{
+		GL_CHECK_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->id));
+		GL_CHECK_ERROR(glFramebufferTexture(GL_FRAMEBUFFER, attachment, render_target->id, 0));
+		GL_CHECK_ERROR(glDrawBuffers(framebuffer->num_render_targets, &draw_buffers[0]));
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			LOG_WARNING("Framebuffer not complete!");
+
+		GL_CHECK_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+		m_device_data.state.framebuffer = 0;
+	}
+}
+
+void RenderDevice::attach_depth_stencil_target(Framebuffer* framebuffer, Texture* render_target)
+{
+	framebuffer->depth_target = render_target;
+
+	GLenum attachment = depth_attachment_point(render_target->internal_format);
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glNamedFramebufferTexture(framebuffer->id, attachment, render_target->id, 0));
+
+		if (glCheckNamedFramebufferStatus(framebuffer->id, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			LOG_WARNING("Framebuffer not complete!");
+	}
+	else
+	{
+		GL_CHECK_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->id));
+		GL_CHECK_ERROR(glFramebufferTexture(GL_FRAMEBUFFER, attachment, render_target->id, 0));
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			LOG_WARNING("Framebuffer not complete!");
+
+		GL_CHECK_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+		m_device_data.state.framebuffer = 0;
+	}
+}
+
+Framebuffer* RenderDevice::create_framebuffer(const FramebufferCreateDesc& desc)
+{
+	Framebuffer* framebuffer = m_device_data.framebuffer_pool.allocate();
+
+	if (!framebuffer)
+	{
+		LOG_ERROR("Framebuffer pool is full");
+		return nullptr;
+	}
+
+    framebuffer->num_render_targets = 0;
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glCreateFramebuffers(1, &framebuffer->id));
+	}
+	else
+	{
+		GL_CHECK_ERROR(glGenFramebuffers(1, &framebuffer->id));
+	}
+
+	for (int i = 0; i < desc.num_render_targets; i++)
+		attach_render_target(framebuffer, desc.render_targets[i]);
+
+	if (desc.depth_target)
+		attach_depth_stencil_target(framebuffer, desc.depth_target);
+
+	return framebuffer;
+}
+
+
+VertexBuffer* RenderDevice::create_vertex_buffer(const BufferCreateDesc& desc)
+{
+	VertexBuffer* buffer = m_device_data.vertex_buffer_pool.allocate();
+
+	if (!buffer)
+	{
+		LOG_ERROR("Vertex Buffer pool is full");
+		return nullptr;
+	}
+
+	GLenum glusageType = kBufferUsageTable[desc.usage_type];
+
+	buffer->buffer_type = GL_ARRAY_BUFFER;
+	buffer->data = desc.data;
+	buffer->size = desc.size;
+	buffer->usage_type = glusageType;
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glCreateBuffers(1, &buffer->id));
+		GL_CHECK_ERROR(glNamedBufferStorage(buffer->id, desc.size, desc.data, buffer_storage_flags(desc)));
+	}
+	else
+	{
+		// Uploaded through the copy target, binding the element array target would modify the
+		// currently bound vertex array.
+		GL_CHECK_ERROR(glGenBuffers(1, &buffer->id));
+		GL_CHECK_ERROR(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer->id));
+		GL_CHECK_ERROR(glBufferData(GL_COPY_WRITE_BUFFER, desc.size, desc.data, glusageType));
+		GL_CHECK_ERROR(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+	}
+
+	return buffer;
+}
+
+UniformBuffer* RenderDevice::create_uniform_buffer(const BufferCreateDesc& desc)
+{
+	UniformBuffer* buffer = m_device_data.uniform_buffer_pool.allocate();
+
+	if (!buffer)
+	{
+		LOG_ERROR("Uniform Buffer pool is full");
+		return nullptr;
+	}
+
+	GLenum glusageType = kBufferUsageTable[desc.usage_type];
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glCreateBuffers(1, &buffer->id));
+		GL_CHECK_ERROR(glNamedBufferStorage(buffer->id, desc.size, desc.data, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_WRITE_BIT));
+	}
+	else
+	{
+		GL_CHECK_ERROR(glGenBuffers(1, &buffer->id));
+		GL_CHECK_ERROR(glBindBuffer(GL_UNIFORM_BUFFER, buffer->id));
+		GL_CHECK_ERROR(glBufferData(GL_UNIFORM_BUFFER, desc.size, desc.data, glusageType));
+		GL_CHECK_ERROR(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+	}
+
+	buffer->buffer_type = GL_UNIFORM_BUFFER;
+	buffer->data = desc.data;
+	buffer->size = desc.size;
+	buffer->usage_type = glusageType;
+
+	return buffer;
+}
+
+StorageBuffer* RenderDevice::create_storage_buffer(const BufferCreateDesc& desc)
+{
+	StorageBuffer* buffer = m_device_data.storage_buffer_pool.allocate();
+
+	if (!buffer)
+	{
+		LOG_ERROR("Storage Buffer pool is full");
+		return nullptr;
+	}
+
+	GLenum glusageType = kBufferUsageTable[desc.usage_type];
+
+	buffer->buffer_type = GL_SHADER_STORAGE_BUFFER;
+	buffer->data = desc.data;
+	buffer->size = desc.size;
+	buffer->usage_type = glusageType;
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glCreateBuffers(1, &buffer->id));
+		GL_CHECK_ERROR(glNamedBufferStorage(buffer->id, desc.size, desc.data, buffer_storage_flags(desc)));
+	}
+	else
+	{
+		GL_CHECK_ERROR(glGenBuffers(1, &buffer->id));
+		GL_CHECK_ERROR(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer->id));
+		GL_CHECK_ERROR(glBufferData(GL_COPY_WRITE_BUFFER, desc.size, desc.data, glusageType));
+		GL_CHECK_ERROR(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+	}
+
+	return buffer;
+}
+
+UniformRingBuffer* RenderDevice::create_uniform_ring_buffer(const UniformRingBufferCreateDesc& desc)
+{
+	if (desc.num_frames == 0 || desc.num_frames > MAX_UNIFORM_RING_REGIONS)
+	{
+		LOG_ERROR("Invalid number of frames for Uniform Ring Buffer");
+		return nullptr;
+	}
+
+	// Persistent mapping needs buffer storage, which the loader only provides from GL 4.4.
+	if (!GLAD_GL_VERSION_4_4)
+	{
+		LOG_ERROR("Uniform Ring Buffers require OpenGL 4.4");
+		return nullptr;
+	}
+
+	UniformRingBuffer* buffer = m_device_data.uniform_ring_buffer_pool.allocate();
+
+	if (!buffer)
+	{
+		LOG_ERROR("Uniform Ring Buffer pool is full");
+		return nullptr;
+	}
+
+	uint32_t alignment = (uint32_t)UniformBufferAlignment();
+
+	buffer->alignment = alignment > 0 ? alignment : 256;
+	buffer->region_size = ((desc.size_per_frame + buffer->alignment - 1) / buffer->alignment) * buffer->alignment;
+	buffer->num_regions = desc.num_frames;
+	buffer->current_region = 0;
+	buffer->head = 0;
+
+	for (uint32_t i = 0; i < MAX_UNIFORM_RING_REGIONS; i++)
+		buffer->fences[i] = nullptr;
+
+	buffer->buffer_type = GL_UNIFORM_BUFFER;
+	buffer->data = nullptr;
+	buffer->size = buffer->region_size * buffer->num_regions;
+	buffer->usage_type = GL_STREAM_DRAW;
+
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glCreateBuffers(1, &buffer->id));
+		GL_CHECK_ERROR(glNamedBufferStorage(buffer->id, buffer->size, nullptr, flags));
+		GL_CHECK_ERROR(buffer->persistent_data = (uint8_t*)glMapNamedBufferRange(buffer->id, 0, buffer->size, flags));
+	}
+	else
+	{
+		GL_CHECK_ERROR(glGenBuffers(1, &buffer->id));
+		GL_CHECK_ERROR(glBindBuffer(GL_UNIFORM_BUFFER, buffer->id));
+		GL_CHECK_ERROR(glBufferStorage(GL_UNIFORM_BUFFER, buffer->size, nullptr, flags));
+		GL_CHECK_ERROR(buffer->persistent_data = (uint8_t*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, buffer->size, flags));
+		GL_CHECK_ERROR(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+	}
+
+	if (!buffer->persistent_data)
+	{
+		LOG_ERROR("Failed to persistently map Uniform Ring Buffer");
+		GL_CHECK_ERROR(glDeleteBuffers(1, &buffer->id));
+		m_device_data.uniform_ring_buffer_pool.free(buffer);
+		return nullptr;
+	}
+
+	return buffer;
+}
+
+StagingBuffer* RenderDevice::create_staging_buffer(size_t size)
+{
+	if (!GLAD_GL_VERSION_4_4)
+	{
+		LOG_ERROR("Staging Buffers require OpenGL 4.4");
+		return nullptr;
+	}
+
+	StagingBuffer* buffer = m_device_data.staging_buffer_pool.allocate();
+
+	if (!buffer)
+	{
+		LOG_ERROR("Staging Buffer pool is full");
+		return nullptr;
+	}
+
+	buffer->buffer_type = GL_PIXEL_UNPACK_BUFFER;
+	buffer->data = nullptr;
+	buffer->size = size;
+	buffer->usage_type = GL_STREAM_DRAW;
+
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glCreateBuffers(1, &buffer->id));
+		GL_CHECK_ERROR(glNamedBufferStorage(buffer->id, size, nullptr, flags));
+		GL_CHECK_ERROR(buffer->persistent_data = (uint8_t*)glMapNamedBufferRange(buffer->id, 0, size, flags));
+	}
+	else
+	{
+		GL_CHECK_ERROR(glGenBuffers(1, &buffer->id));
+		GL_CHECK_ERROR(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->id));
+		GL_CHECK_ERROR(glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags));
+		GL_CHECK_ERROR(buffer->persistent_data = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags));
+		GL_CHECK_ERROR(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+	}
+
+	if (!buffer->persistent_data)
+	{
+		LOG_ERROR("Failed to persistently map Staging Buffer");
+		GL_CHECK_ERROR(glDeleteBuffers(1, &buffer->id));
+		m_device_data.staging_buffer_pool.free(buffer);
+		return nullptr;
+	}
+
+	return buffer;
+}
+
+IndexBuffer* RenderDevice::create_index_buffer(const BufferCreateDesc& desc)
+{
+	IndexBuffer* buffer = m_device_data.index_buffer_pool.allocate();
+
+	if (!buffer)
+	{
+		LOG_ERROR("Index Buffer pool is full");
+		return nullptr;
+	}
+
+	GLenum glusageType = kBufferUsageTable[desc.usage_type];
+
+	buffer->buffer_type = GL_ELEMENT_ARRAY_BUFFER;
+	buffer->data = desc.data;
+	buffer->size = desc.size;
+	buffer->usage_type = glusageType;
+	buffer->type = kBufferDataTypeTable[desc.data_type];
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glCreateBuffers(1, &buffer->id));
+		GL_CHECK_ERROR(glNamedBufferStorage(buffer->id, desc.size, desc.data, buffer_storage_flags(desc)));
+	}
+	else
+	{
+		// Uploaded through the copy target, binding the element array target would modify the
+		// currently bound vertex array.
+		GL_CHECK_ERROR(glGenBuffers(1, &buffer->id));
+		GL_CHECK_ERROR(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer->id));
+		GL_CHECK_ERROR(glBufferData(GL_COPY_WRITE_BUFFER, desc.size, desc.data, glusageType));
+		GL_CHECK_ERROR(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+	}
+
+	return buffer;
+}
+
+InputLayout* RenderDevice::create_input_layout(const InputLayoutCreateDesc& desc)
+{
+    InputLayout* ia  = new InputLayout();
+    
+    memcpy(&ia->elements[0], &desc.elements[0], sizeof(InputElement) * desc.num_elements);
+    
+    ia->num_elements = desc.num_elements;
+    ia->vertex_size  = desc.vertex_size;
+    ia->instance_size = desc.instance_size;
+    
+    return ia;
+}
+
+// Per-vertex elements read from buffer binding 0 and per-instance elements from binding 1. With
+// DSA the divisor belongs to the binding, so all per-instance elements share one step rate.
+VertexArray* RenderDevice::create_vertex_array(const VertexArrayCreateDesc& desc)
+{
+	uint32_t instance_step_rate = 0;
+
+	for (uint32_t i = 0; i < desc.layout->num_elements; i++)
+	{
+		uint32_t step_rate = desc.layout->elements[i].instance_step_rate;
+
+		if (step_rate > 0 && instance_step_rate > 0 && step_rate != instance_step_rate)
+			LOG_WARNING("Per-instance elements with different step rates, using the first one");
+		else if (step_rate > 0 && instance_step_rate == 0)
+			instance_step_rate = step_rate;
+	}
+
+	if (instance_step_rate > 0 && !desc.instance_buffer)
+	{
+		LOG_ERROR("Input layout has per-instance elements but no instance buffer was given");
+		return nullptr;
+	}
+
+	VertexArray* vertexArray = m_device_data.vertex_array_pool.allocate();
+
+	if (!vertexArray)
+	{
+		LOG_ERROR("Vertex Array pool is full");
+		return nullptr;
+	}
+
+	vertexArray->ib = desc.index_buffer;
+	vertexArray->vb = desc.vertex_buffer;
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glCreateVertexArrays(1, &vertexArray->id));
+		GL_CHECK_ERROR(glVertexArrayVertexBuffer(vertexArray->id, 0, desc.vertex_buffer->id, 0, desc.layout->vertex_size));
+
+		if (instance_step_rate > 0)
+		{
+			GL_CHECK_ERROR(glVertexArrayVertexBuffer(vertexArray->id, 1, desc.instance_buffer->id, 0, desc.layout->instance_size));
+			GL_CHECK_ERROR(glVertexArrayBindingDivisor(vertexArray->id, 1, instance_step_rate));
+		}
+
+		if (desc.index_buffer)
+		{
+			GL_CHECK_ERROR(glVertexArrayElementBuffer(vertexArray->id, desc.index_buffer->id));
+		}
+
+		for (uint32_t i = 0; i < desc.layout->num_elements; i++)
+		{
+			GL_CHECK_ERROR(glEnableVertexArrayAttrib(vertexArray->id, i));
+			GL_CHECK_ERROR(glVertexArrayAttribFormat(vertexArray->id,
+													 i,
+													 desc.layout->elements[i].num_sub_elements,
+													 kBufferDataTypeTable[desc.layout->elements[i].type],
+													 desc.layout->elements[i].normalized,
+													 desc.layout->elements[i].offset));
+			GL_CHECK_ERROR(glVertexArrayAttribBinding(vertexArray->id, i, desc.layout->elements[i].instance_step_rate > 0 ? 1 : 0));
+		}
+
+		return vertexArray;
+	}
+
+	GL_CHECK_ERROR(glGenVertexArrays(1, &vertexArray->id));
+	GL_CHECK_ERROR(glBindVertexArray(vertexArray->id));
+
+	if (desc.index_buffer)
+	{
+		GL_CHECK_ERROR(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, desc.index_buffer->id));
+	}
+
+	for (uint32_t i = 0; i < desc.layout->num_elements; i++)
+	{
+		const InputElement& element = desc.layout->elements[i];
+		bool per_instance = element.instance_step_rate > 0;
+
+		GL_CHECK_ERROR(glBindBuffer(GL_ARRAY_BUFFER, per_instance ? desc.instance_buffer->id : desc.vertex_buffer->id));
+		GL_CHECK_ERROR(glEnableVertexAttribArray(i));
+		GL_CHECK_ERROR(glVertexAttribPointer(i,
+											 element.num_sub_elements,
+											 kBufferDataTypeTable[element.type],
+											 element.normalized,
+											 per_instance ? desc.layout->instance_size : desc.layout->vertex_size,
+											 (GLvoid*)((uint64_t)element.offset)));
+		GL_CHECK_ERROR(glVertexAttribDivisor(i, element.instance_step_rate));
+	}
+
+	GL_CHECK_ERROR(glBindVertexArray(0));
+	GL_CHECK_ERROR(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	GL_CHECK_ERROR(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+	m_device_data.state.vertex_array = 0;
+
+	return vertexArray;
+}
+
+Texture1D* RenderDevice::create_texture_1d(const Texture1DCreateDesc& desc)
+{
+	if (compressed_block_size(kTextureFormatTable[desc.format][0]) > 0)
+	{
+		LOG_ERROR("Block compressed formats are not supported for 1D textures");
+		return nullptr;
+	}
+
+	Texture1D* texture = m_device_data.texture_1d_pool.allocate();
+
+	if (!texture)
+	{
+		LOG_ERROR("Texture 1D pool is full");
+		return nullptr;
+	}
+
+	texture->width = desc.width;
+	texture->mip_levels = texture_mip_levels(desc.width, 1, 1, desc.generate_mipmaps, desc.mipmap_levels);
+
+	create_texture_storage(texture, GL_TEXTURE_1D, desc.format, texture->mip_levels, desc.width, 1, 1);
+
+	if (desc.data)
+		upload_texture_image(texture, 0, 0, desc.width, 1, 1, desc.data);
+
+	if (desc.generate_mipmaps)
+		generate_texture_mipmaps(texture);
+
+	return texture;
+}
+
+Texture2D* RenderDevice::create_texture_2d(const Texture2DCreateDesc& desc)
+{
+	Texture2D* texture = m_device_data.texture_2d_pool.allocate();
+
+	if (!texture)
+	{
+		LOG_ERROR("Texture 2D pool is full");
+		return nullptr;
+	}
+
+	texture->width = desc.width;
+	texture->height = desc.height;
+	texture->mip_levels = texture_mip_levels(desc.width, desc.height, 1, desc.generate_mipmaps, desc.mipmap_levels);
+
+	create_texture_storage(texture, GL_TEXTURE_2D, desc.format, texture->mip_levels, desc.width, desc.height, 1);
+
+	if (desc.data)
+		upload_texture_image(texture, 0, 0, desc.width, desc.height, 1, desc.data);
+
+	if (desc.generate_mipmaps)
+		generate_texture_mipmaps(texture);
+
+	return texture;
+}
+
+Texture2DArray* RenderDevice::create_texture_2d_array(const Texture2DArrayCreateDesc& desc)
+{
+	Texture2DArray* texture = m_device_data.texture_2d_array_pool.allocate();
+
+	if (!texture)
+	{
+		LOG_ERROR("Texture 2D Array pool is full");
+		return nullptr;
+	}
+
+	texture->width = desc.width;
+	texture->height = desc.height;
+	texture->array_size = desc.array_size;
+	texture->mip_levels = texture_mip_levels(desc.width, desc.height, 1, desc.generate_mipmaps, desc.mipmap_levels);
+
+	create_texture_storage(texture, GL_TEXTURE_2D_ARRAY, desc.format, texture->mip_levels, desc.width, desc.height, desc.array_size);
+
+	if (desc.data)
+		upload_texture_image(texture, 0, 0, desc.width, desc.height, desc.array_size, desc.data);
+
+	if (desc.generate_mipmaps)
+		generate_texture_mipmaps(texture);
+
+	return texture;
+}
+
+Texture3D* RenderDevice::create_texture_3d(const Texture3DCreateDesc& desc)
+{
+	if (compressed_block_size(kTextureFormatTable[desc.format][0]) > 0)
+	{
+		LOG_ERROR("Block compressed formats are not supported for 3D textures");
+		return nullptr;
+	}
+
+	Texture3D* texture = m_device_data.texture_3d_pool.allocate();
+
+	if (!texture)
+	{
+		LOG_ERROR("Texture 3D pool is full");
+		return nullptr;
+	}
+
+	texture->width = desc.width;
+	texture->height = desc.height;
+	texture->depth = desc.depth;
+	texture->mip_levels = texture_mip_levels(desc.width, desc.height, desc.depth, desc.generate_mipmaps, desc.mipmap_levels);
+
+	create_texture_storage(texture, GL_TEXTURE_3D, desc.format, texture->mip_levels, desc.width, desc.height, desc.depth);
+
+	if (desc.data)
+		upload_texture_image(texture, 0, 0, desc.width, desc.height, desc.depth, desc.data);
+
+	if (desc.generate_mipmaps)
+		generate_texture_mipmaps(texture);
+
+	return texture;
+}
+
+TextureCube* RenderDevice::create_texture_cube(const TextureCubeCreateDesc& desc)
+{
+	TextureCube* texture = m_device_data.texture_cube_pool.allocate();
+
+	if (!texture)
+	{
+		LOG_ERROR("Texture Cube pool is full");
+		return nullptr;
+	}
+
+	texture->width = desc.width;
+	texture->height = desc.height;
+	texture->mip_levels = texture_mip_levels(desc.width, desc.height, 1, desc.generate_mipmaps, desc.mipmap_levels);
+
+	create_texture_storage(texture, GL_TEXTURE_CUBE_MAP, desc.format, texture->mip_levels, desc.width, desc.height, 1);
+
+	for (GLint face = 0; face < 6; face++)
+	{
+		if (desc.data[face])
+			upload_texture_image(texture, 0, face, desc.width, desc.height, 1, desc.data[face]);
+	}
+
+	if (desc.generate_mipmaps)
+		generate_texture_mipmaps(texture);
+
+	return texture;
+}
+
+RasterizerState* RenderDevice::create_rasterizer_state(const RasterizerStateCreateDesc& desc)
+{
+	RasterizerState* rasterizerState = new RasterizerState();
+
+	rasterizerState->cull_face = kCullModeTable[desc.cull_mode];
+	rasterizerState->enable_cull_face = desc.cull_mode != CullMode::NONE;
+	rasterizerState->polygon_mode = kFillModeTable[desc.fill_mode];
+	rasterizerState->enable_multisample = desc.multisample;
+	rasterizerState->enable_scissor = desc.scissor;
+	rasterizerState->enable_front_face_ccw = desc.front_winding_ccw;
+
+	return rasterizerState;
+}
+
+DepthStencilState* RenderDevice::create_depth_stencil_state(const DepthStencilStateCreateDesc& desc)
+{
+	DepthStencilState* depthStencilState = new DepthStencilState();
+
+	// Set Depth Options
+
+	depthStencilState->enable_depth = desc.enable_depth_test;
+	depthStencilState->depth_func = kComparisonFunctionTable[desc.depth_cmp_func];
+	depthStencilState->depth_mask = (desc.depth_mask) ? GL_TRUE : GL_FALSE;
+
+	// Set Stencil Options
+
+	depthStencilState->enable_stencil = desc.enable_stencil_test;
+	depthStencilState->front_stencil_comparison = kComparisonFunctionTable[desc.front_stencil_cmp_func];
+	depthStencilState->back_stencil_comparison = kComparisonFunctionTable[desc.back_stencil_cmp_func];
+
+	// Front Stencil Operation
+
+	depthStencilState->front_stencil_fail = kStencilOperationTable[desc.front_stencil_fail];
+	depthStencilState->front_stencil_pass_depth_pass = kStencilOperationTable[desc.front_stencil_pass_depth_pass];
+	depthStencilState->front_stencil_pass_depth_fail = kStencilOperationTable[desc.front_stencil_pass_depth_fail];
+
+	// Back Stencil Operation
+
+	depthStencilState->back_stencil_fail = kStencilOperationTable[desc.back_stencil_fail];
+	depthStencilState->back_stencil_pass_depth_pass = kStencilOperationTable[desc.back_stencil_pass_depth_pass];
+	depthStencilState->back_stencil_pass_depth_fail = kStencilOperationTable[desc.back_stencil_pass_depth_fail];
+	depthStencilState->stencil_mask = desc.stencil_mask;
+
+	return depthStencilState;
+}
+
+BlendState* RenderDevice::create_blend_state(const BlendStateCreateDesc& desc)
+{
+	BlendState* blendState = new BlendState();
+
+	blendState->independent = desc.independent_blend;
+
+	uint32_t num_targets = desc.independent_blend ? MAX_BLEND_TARGETS : 1;
+
+	for (uint32_t i = 0; i < num_targets; i++)
+	{
+		const RenderTargetBlendDesc& target = desc.render_targets[i];
+		BlendTargetState& state = blendState->targets[i];
+
+		state.enable = target.enable;
+		state.src_color = kBlendFactorTable[target.src_color];
+		state.dst_color = kBlendFactorTable[target.dst_color];
+		state.color_op = kBlendOpTable[target.color_op];
+		state.src_alpha = kBlendFactorTable[target.src_alpha];
+		state.dst_alpha = kBlendFactorTable[target.dst_alpha];
+		state.alpha_op = kBlendOpTable[target.alpha_op];
+		state.color_mask = ColorWriteMask::ALL & ~target.color_write_disable;
+	}
+
+	return blendState;
+}
+
+PipelineStateObject* RenderDevice::create_pipeline_state_object(const PipelineStateObjectCreateDesc& desc)
+{
+	PipelineStateObjectCreateDesc key;
+	normalize_pso_desc(desc, key);
+
+	uint64_t hash = Utility::hash_fnv1a(&key, sizeof(PipelineStateObjectCreateDesc));
+	auto it = m_device_data.pso_cache.find(hash);
+
+	if (it != m_device_data.pso_cache.end() && memcmp(&it->second->desc, &key, sizeof(PipelineStateObjectCreateDesc)) == 0)
+	{
+		it->second->ref_count++;
+		return it->second;
+	}
+
 	PipelineStateObject* pso = new PipelineStateObject();
 
-	pso->depth_stencil_state = create_depth_stencil_state(desc.depth_stencil_state);
-	pso->rasterizer_state = create_rasterizer_state(desc.rasterizer_state);
-	pso->primitive = desc.primitive;
+	pso->depth_stencil_state = create_depth_stencil_state(key.depth_stencil_state);
+	pso->rasterizer_state = create_rasterizer_state(key.rasterizer_state);
+	pso->blend_state = create_blend_state(key.blend_state);
+	pso->primitive = key.primitive;
+	pso->id = m_device_data.next_pso_id++;
+	pso->order_independent_blend = blend_is_order_independent(key.blend_state);
+
+	uint64_t blend_hash = Utility::hash_fnv1a(&key.blend_state, sizeof(BlendStateCreateDesc));
+	auto blend_id = m_device_data.blend_ids.find(blend_hash);
+
+	if (blend_id != m_device_data.blend_ids.end())
+		pso->blend_id = blend_id->second;
+	else
+	{
+		pso->blend_id = (uint32_t)m_device_data.blend_ids.size();
+		m_device_data.blend_ids[blend_hash] = pso->blend_id;
+	}
+	pso->ref_count = 1;
+	pso->hash = hash;
+	pso->desc = key;
+
+	// On the off chance of a hash collision the new PSO simply stays out of the cache.
+	if (it == m_device_data.pso_cache.end())
+		m_device_data.pso_cache[hash] = pso;
+
+	return pso;
+}
+
+DrawBatch* RenderDevice::create_draw_batch(const DrawBatchCreateDesc& desc)
+{
+	// Per-draw data is indexed by gl_DrawID, which would otherwise only fail at shader compile time.
+	if (desc.draw_data_stride > 0 && !m_device_data.draw_parameters)
+	{
+		LOG_ERROR("Draw batches with per-draw data require OpenGL 4.6 or ARB_shader_draw_parameters");
+		return nullptr;
+	}
+
+	DrawBatch* batch = new DrawBatch();
+
+	batch->max_draws = desc.max_draws;
+	batch->draw_data_stride = desc.draw_data_stride;
+	batch->uploaded_draws = 0;
+	batch->draw_data_buffer = 0;
+
+	batch->commands.reserve(desc.max_draws);
+	batch->draw_data.reserve(desc.max_draws * desc.draw_data_stride);
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glCreateBuffers(1, &batch->indirect_buffer));
+		GL_CHECK_ERROR(glNamedBufferStorage(batch->indirect_buffer, sizeof(DrawElementsIndirectCommand) * desc.max_draws, nullptr, GL_DYNAMIC_STORAGE_BIT));
+
+		if (desc.draw_data_stride > 0)
+		{
+			GL_CHECK_ERROR(glCreateBuffers(1, &batch->draw_data_buffer));
+			GL_CHECK_ERROR(glNamedBufferStorage(batch->draw_data_buffer, desc.draw_data_stride * desc.max_draws, nullptr, GL_DYNAMIC_STORAGE_BIT));
+		}
+
+		return batch;
+	}
+
+	GL_CHECK_ERROR(glGenBuffers(1, &batch->indirect_buffer));
+	GL_CHECK_ERROR(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch->indirect_buffer));
+	GL_CHECK_ERROR(glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * desc.max_draws, nullptr, GL_DYNAMIC_DRAW));
+	m_device_data.state.draw_indirect_buffer = batch->indirect_buffer;
+
+	if (desc.draw_data_stride > 0)
+	{
+		GL_CHECK_ERROR(glGenBuffers(1, &batch->draw_data_buffer));
+		GL_CHECK_ERROR(glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->draw_data_buffer));
+		GL_CHECK_ERROR(glBufferData(GL_SHADER_STORAGE_BUFFER, desc.draw_data_stride * desc.max_draws, nullptr, GL_DYNAMIC_DRAW));
+		GL_CHECK_ERROR(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+	}
+
+	return batch;
+}
+
+SamplerState* RenderDevice::create_sampler_state(const SamplerStateCreateDesc& desc)
+{
+	SamplerStateCreateDesc key;
+	normalize_sampler_desc(desc, m_device_data.max_anisotropy, key);
+
+	uint64_t hash = Utility::hash_fnv1a(&key, sizeof(SamplerStateCreateDesc));
+	auto it = m_device_data.sampler_cache.find(hash);
+
+	if (it != m_device_data.sampler_cache.end() && memcmp(&it->second->desc, &key, sizeof(SamplerStateCreateDesc)) == 0)
+	{
+		it->second->ref_count++;
+		return it->second;
+	}
+
+	SamplerState* samplerState = m_device_data.sampler_state_pool.allocate();
+
+	if (!samplerState)
+	{
+		LOG_ERROR("Sampler State pool is full");
+		return nullptr;
+	}
+
+	samplerState->ref_count = 1;
+	samplerState->hash = hash;
+	samplerState->desc = key;
+
+	GL_CHECK_ERROR(glGenSamplers(1, &samplerState->id));
+
+	// Parameters still at their GL defaults are skipped: repeat wrapping, linear magnification,
+	// nearest mip linear minification and a transparent black border.
+
+	GLenum wrap_modes[] = { GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R };
+	uint32_t wraps[] = { key.wrap_mode_u, key.wrap_mode_v, key.wrap_mode_w };
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (wraps[i] != TextureWrapMode::REPEAT)
+		{
+			GL_CHECK_ERROR(glSamplerParameteri(samplerState->id, wrap_modes[i], kTextureWrapModeTable[wraps[i]]));
+		}
+	}
+
+	if (key.border_color[0] != 0.0f || key.border_color[1] != 0.0f || key.border_color[2] != 0.0f || key.border_color[3] != 0.0f)
+	{
+		GL_CHECK_ERROR(glSamplerParameterfv(samplerState->id, GL_TEXTURE_BORDER_COLOR, key.border_color));
+	}
+
+	// Texture Filtering
+
+	bool anisotropic = key.min_filter == TextureFilteringMode::ANISOTROPIC_ALL || key.mag_filter == TextureFilteringMode::ANISOTROPIC_ALL;
+	GLenum min_filter = anisotropic ? GL_LINEAR_MIPMAP_LINEAR : kTextureMinFilteringModeTable[key.min_filter];
+	GLenum mag_filter = anisotropic ? GL_LINEAR : kTextureMagFilteringModeTable[key.mag_filter];
+
+	if (min_filter != GL_NEAREST_MIPMAP_LINEAR)
+	{
+		GL_CHECK_ERROR(glSamplerParameteri(samplerState->id, GL_TEXTURE_MIN_FILTER, min_filter));
+	}
+
+	if (mag_filter != GL_LINEAR)
+	{
+		GL_CHECK_ERROR(glSamplerParameteri(samplerState->id, GL_TEXTURE_MAG_FILTER, mag_filter));
+	}
+
+	if (key.max_anisotropy > 1.0f)
+	{
+		GL_CHECK_ERROR(glSamplerParameterf(samplerState->id, GL_TEXTURE_MAX_ANISOTROPY_EXT, key.max_anisotropy));
+	}
+
+	if (it == m_device_data.sampler_cache.end())
+		m_device_data.sampler_cache[hash] = samplerState;
+
+	return samplerState;
+}
+
+void RenderDevice::destroy_shader(Shader* shader)
+{
+	if (shader)
+	{
+		GL_CHECK_ERROR(glDeleteShader(shader->id));
+		m_device_data.shader_pool.free(shader);
+	}
+}
+
+void RenderDevice::destroy_shader_program(ShaderProgram* program)
+{
+	if (program)
+	{
+		if (m_device_data.state.program == program->id)
+			m_device_data.state.program = GL_STATE_UNKNOWN;
+
+		if (m_device_data.placeholder_program == program)
+			m_device_data.placeholder_program = nullptr;
+
+		GL_CHECK_ERROR(glDeleteProgram(program->id));
+		m_device_data.shader_program_pool.free(program);
+	}
+}
+
+void RenderDevice::destroy_vertex_buffer(VertexBuffer* vertex_buffer)
+{
+	if (vertex_buffer)
+	{
+		forget_buffer_bindings(vertex_buffer->id);
+		GL_CHECK_ERROR(glDeleteBuffers(1, &vertex_buffer->id));
+		m_device_data.vertex_buffer_pool.free(vertex_buffer);
+	}
+}
+
+void RenderDevice::destroy_index_buffer(IndexBuffer* index_buffer)
+{
+	if (index_buffer)
+	{
+		forget_buffer_bindings(index_buffer->id);
+		GL_CHECK_ERROR(glDeleteBuffers(1, &index_buffer->id));
+		m_device_data.index_buffer_pool.free(index_buffer);
+	}
+}
+
+void RenderDevice::destroy_uniform_buffer(UniformBuffer* buffer)
+{
+	delete_uniform_buffer_object(buffer);
+	m_device_data.uniform_buffer_pool.free(buffer);
+}
+
+void RenderDevice::destroy_uniform_ring_buffer(UniformRingBuffer* buffer)
+{
+	if (buffer)
+	{
+		for (uint32_t i = 0; i < MAX_UNIFORM_RING_REGIONS; i++)
+		{
+			if (buffer->fences[i])
+			{
+				GL_CHECK_ERROR(glDeleteSync(buffer->fences[i]));
+			}
+		}
+
+		if (m_device_data.dsa)
+		{
+			GL_CHECK_ERROR(glUnmapNamedBuffer(buffer->id));
+		}
+		else
+		{
+			GL_CHECK_ERROR(glBindBuffer(GL_UNIFORM_BUFFER, buffer->id));
+			GL_CHECK_ERROR(glUnmapBuffer(GL_UNIFORM_BUFFER));
+			GL_CHECK_ERROR(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+		}
+
+		delete_uniform_buffer_object(buffer);
+		m_device_data.uniform_ring_buffer_pool.free(buffer);
+	}
+}
+
+void RenderDevice::delete_uniform_buffer_object(UniformBuffer* buffer)
+{
+	for (int i = 0; i < MAX_UNIFORM_BUFFER_SLOTS; i++)
+	{
+		if (m_device_data.state.uniform_buffers[i].id == buffer->id)
+			m_device_data.state.uniform_buffers[i].id = GL_STATE_UNKNOWN;
+	}
+
+	forget_buffer_bindings(buffer->id);
+	GL_CHECK_ERROR(glDeleteBuffers(1, &buffer->id));
+}
+
+void RenderDevice::destroy_storage_buffer(StorageBuffer* buffer)
+{
+	if (buffer)
+	{
+		forget_buffer_bindings(buffer->id);
+		GL_CHECK_ERROR(glDeleteBuffers(1, &buffer->id));
+		m_device_data.storage_buffer_pool.free(buffer);
+	}
+}
+
+// Any buffer can be bound as a storage or indirect buffer, so every destroy has to drop its id
+// from those caches before the name is reused.
+void RenderDevice::forget_buffer_bindings(GLuint id)
+{
+	for (int i = 0; i < MAX_STORAGE_BUFFER_SLOTS; i++)
+	{
+		if (m_device_data.state.storage_buffers[i] == id)
+			m_device_data.state.storage_buffers[i] = GL_STATE_UNKNOWN;
+	}
+
+	if (m_device_data.state.draw_indirect_buffer == id)
+		m_device_data.state.draw_indirect_buffer = GL_STATE_UNKNOWN;
+
+	if (m_device_data.state.dispatch_indirect_buffer == id)
+		m_device_data.state.dispatch_indirect_buffer = GL_STATE_UNKNOWN;
+
+	if (m_device_data.state.parameter_buffer == id)
+		m_device_data.state.parameter_buffer = GL_STATE_UNKNOWN;
+}
+
+void RenderDevice::destroy_vertex_array(VertexArray* vertex_array)
+{
+	if (vertex_array)
+	{
+		if (m_device_data.state.vertex_array == vertex_array->id)
+			m_device_data.state.vertex_array = 0;
+
+		GL_CHECK_ERROR(glDeleteVertexArrays(1, &vertex_array->id));
+		m_device_data.vertex_array_pool.free(vertex_array);
+	}
+}
+
+void RenderDevice::destroy_texture(Texture* texture)
+{
+	if (texture)
+	{
+		for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+		{
+			if (m_device_data.state.textures[i] == texture->id)
+				m_device_data.state.textures[i] = 0;
+		}
+
+		for (int i = 0; i < MAX_IMAGE_UNITS; i++)
+		{
+			if (m_device_data.state.images[i].id == texture->id)
+				m_device_data.state.images[i].id = GL_STATE_UNKNOWN;
+		}
+
+		GL_CHECK_ERROR(glDeleteTextures(1, &texture->id));
+
+		switch (texture->gl_texture_target)
+		{
+			case GL_TEXTURE_1D:
+				m_device_data.texture_1d_pool.free(static_cast<Texture1D*>(texture));
+				break;
+			case GL_TEXTURE_2D:
+				m_device_data.texture_2d_pool.free(static_cast<Texture2D*>(texture));
+				break;
+			case GL_TEXTURE_2D_ARRAY:
+				m_device_data.texture_2d_array_pool.free(static_cast<Texture2DArray*>(texture));
+				break;
+			case GL_TEXTURE_3D:
+				m_device_data.texture_3d_pool.free(static_cast<Texture3D*>(texture));
+				break;
+			case GL_TEXTURE_CUBE_MAP:
+				m_device_data.texture_cube_pool.free(static_cast<TextureCube*>(texture));
+				break;
+		}
+	}
+}
+
+void RenderDevice::destroy_staging_buffer(StagingBuffer* buffer)
+{
+	if (buffer)
+	{
+		if (m_device_data.dsa)
+		{
+			GL_CHECK_ERROR(glUnmapNamedBuffer(buffer->id));
+		}
+		else
+		{
+			GL_CHECK_ERROR(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->id));
+			GL_CHECK_ERROR(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+			GL_CHECK_ERROR(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+		}
+
+		forget_buffer_bindings(buffer->id);
+		GL_CHECK_ERROR(glDeleteBuffers(1, &buffer->id));
+		m_device_data.staging_buffer_pool.free(buffer);
+	}
+}
+
+void RenderDevice::destroy_rasterizer_state(RasterizerState* state)
+{
+	delete state;
+}
+
+void RenderDevice::destroy_sampler_state(SamplerState* state)
+{
+	if (--state->ref_count > 0)
+		return;
+
+	auto it = m_device_data.sampler_cache.find(state->hash);
+
+	if (it != m_device_data.sampler_cache.end() && it->second == state)
+		m_device_data.sampler_cache.erase(it);
+
+	for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		if (m_device_data.state.samplers[i] == state->id)
+			m_device_data.state.samplers[i] = 0;
+	}
+
+	GL_CHECK_ERROR(glDeleteSamplers(1, &state->id));
+	m_device_data.sampler_state_pool.free(state);
+}
+
+void RenderDevice::destroy_depth_stencil_state(DepthStencilState* state)
+{
+	delete state;
+}
+
+void RenderDevice::destroy_blend_state(BlendState* state)
+{
+	delete state;
+}
+
+void RenderDevice::destroy_pipeline_state_object(PipelineStateObject* pso)
+{
+	if (--pso->ref_count > 0)
+		return;
+
+	auto it = m_device_data.pso_cache.find(pso->hash);
+
+	if (it != m_device_data.pso_cache.end() && it->second == pso)
+		m_device_data.pso_cache.erase(it);
+
+	for (auto diff = m_device_data.pso_diffs.begin(); diff != m_device_data.pso_diffs.end();)
+	{
+		if ((uint32_t)(diff->first >> 32) == pso->id || (uint32_t)diff->first == pso->id)
+			diff = m_device_data.pso_diffs.erase(diff);
+		else
+			++diff;
+	}
+
+	if (m_device_data.current_pso == pso)
+		m_device_data.current_pso = nullptr;
+
+	destroy_depth_stencil_state(pso->depth_stencil_state);
+	destroy_rasterizer_state(pso->rasterizer_state);
+	destroy_blend_state(pso->blend_state);
+
+	delete pso;
+}
+
+void RenderDevice::destroy_draw_batch(DrawBatch* batch)
+{
+	if (batch)
+	{
+		if (m_device_data.state.draw_indirect_buffer == batch->indirect_buffer)
+			m_device_data.state.draw_indirect_buffer = 0;
+
+		for (int i = 0; i < MAX_STORAGE_BUFFER_SLOTS; i++)
+		{
+			if (batch->draw_data_buffer != 0 && m_device_data.state.storage_buffers[i] == batch->draw_data_buffer)
+				m_device_data.state.storage_buffers[i] = GL_STATE_UNKNOWN;
+		}
+
+		GL_CHECK_ERROR(glDeleteBuffers(1, &batch->indirect_buffer));
+
+		if (batch->draw_data_buffer != 0)
+		{
+			GL_CHECK_ERROR(glDeleteBuffers(1, &batch->draw_data_buffer));
+		}
+
+		delete batch;
+	}
+}
+
+void RenderDevice::destroy_framebuffer(Framebuffer* framebuffer, bool destroy_attachments)
+{
+	if (framebuffer)
+	{
+		if (m_device_data.state.framebuffer == framebuffer->id)
+			m_device_data.state.framebuffer = 0;
+
+		GL_CHECK_ERROR(glDeleteFramebuffers(1, &framebuffer->id));
+
+		if (destroy_attachments)
+		{
+			for (int i = 0; i < framebuffer->num_render_targets; i++)
+				destroy_texture(framebuffer->render_targets[i]);
+
+			if (framebuffer->depth_target)
+				destroy_texture(framebuffer->depth_target);
+		}
+
+		m_device_data.framebuffer_pool.free(framebuffer);
+	}
+}
+
+// Going from one PSO to another only touches the fields that differ between the two. Without a
+// known current PSO every field goes through the state cache instead.
+void RenderDevice::bind_pipeline_state_object(PipelineStateObject* pso)
+{
+	PipelineStateObject* current = m_device_data.current_pso;
+
+	if (current == pso)
+		return;
+
+	uint32_t diff = PSO_DIFF_ALL;
+
+	if (current)
+	{
+		uint64_t key = (uint64_t(current->id) << 32) | pso->id;
+		auto it = m_device_data.pso_diffs.find(key);
+
+		if (it != m_device_data.pso_diffs.end())
+			diff = it->second;
+		else
+		{
+			diff = pso_diff(current, pso);
+			m_device_data.pso_diffs[key] = diff;
+		}
+	}
+
+	apply_depth_stencil_state(pso->depth_stencil_state, diff);
+	apply_rasterizer_state(pso->rasterizer_state, diff);
+
+	if (diff & PSO_DIFF_BLEND)
+		apply_blend_state(pso->blend_state);
+
+	if (diff & PSO_DIFF_PRIMITIVE)
+		m_device_data.primitive_type = kDrawPrimitiveTypeTable[pso->primitive];
+
+	m_device_data.current_pso = pso;
+}
+
+int RenderDevice::StorageBufferAlignment()
+{
+	return m_device_data.storage_buffer_alignment;
+}
+
+int RenderDevice::UniformBufferAlignment()
+{
+	return m_device_data.uniform_buffer_alignment;
+}
+
+void RenderDevice::bind_texture(Texture* texture, uint32_t shader_stage, uint32_t buffer_slot)
+{
+	if (buffer_slot < MAX_TEXTURE_UNITS && !cache_update(m_device_data, m_device_data.state.textures[buffer_slot], texture->id))
+		return;
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glBindTextureUnit(buffer_slot, texture->id));
+	}
+	else
+	{
+		set_active_texture_unit(buffer_slot);
+		GL_CHECK_ERROR(glBindTexture(texture->gl_texture_target, texture->id));
+	}
+}
+
+void RenderDevice::bind_uniform_buffer(UniformBuffer* uniform_buffer, uint32_t shader_stage, uint32_t buffer_slot)
+{
+	if (buffer_slot < MAX_UNIFORM_BUFFER_SLOTS)
+	{
+		UniformBufferBindingCache& binding = m_device_data.state.uniform_buffers[buffer_slot];
+
+		if (binding.id == uniform_buffer->id && binding.offset == 0 && binding.size == 0)
+		{
+			m_device_data.stats.filtered_state_calls++;
+			return;
+		}
+
+		binding.id = uniform_buffer->id;
+		binding.offset = 0;
+		binding.size = 0;
+	}
+
+	m_device_data.stats.issued_state_calls++;
+	GL_CHECK_ERROR(glBindBufferBase(GL_UNIFORM_BUFFER, buffer_slot, uniform_buffer->id));
+}
+
+void RenderDevice::bind_uniform_buffer_range(UniformBuffer* uniform_buffer, uint32_t shader_stage, uint32_t buffer_slot, size_t offset, size_t size)
+{
+	if (buffer_slot < MAX_UNIFORM_BUFFER_SLOTS)
+	{
+		UniformBufferBindingCache& binding = m_device_data.state.uniform_buffers[buffer_slot];
+
+		if (binding.id == uniform_buffer->id && binding.offset == offset && binding.size == size)
+		{
+			m_device_data.stats.filtered_state_calls++;
+			return;
+		}
+
+		binding.id = uniform_buffer->id;
+		binding.offset = offset;
+		binding.size = size;
+	}
+
+	m_device_data.stats.issued_state_calls++;
+	GL_CHECK_ERROR(glBindBufferRange(GL_UNIFORM_BUFFER, buffer_slot, uniform_buffer->id, offset, size));
+}
+
+void RenderDevice::bind_storage_buffer(Buffer* buffer, uint32_t shader_stage, uint32_t buffer_slot)
+{
+	GLuint id = buffer ? buffer->id : 0;
+
+	if (buffer_slot >= MAX_STORAGE_BUFFER_SLOTS || cache_update(m_device_data, m_device_data.state.storage_buffers[buffer_slot], id))
+	{
+		GL_CHECK_ERROR(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, buffer_slot, id));
+	}
+}
+
+void RenderDevice::bind_storage_buffer_range(Buffer* buffer, uint32_t shader_stage, uint32_t buffer_slot, size_t offset, size_t size)
+{
+	// Only whole buffer bindings are shadowed.
+	if (buffer_slot < MAX_STORAGE_BUFFER_SLOTS)
+		m_device_data.state.storage_buffers[buffer_slot] = GL_STATE_UNKNOWN;
+
+	m_device_data.stats.issued_state_calls++;
+	GL_CHECK_ERROR(glBindBufferRange(GL_SHADER_STORAGE_BUFFER, buffer_slot, buffer->id, offset, size));
+}
+
+void RenderDevice::bind_image(Texture* texture, uint32_t shader_stage, uint32_t image_slot, uint32_t mip_level, uint32_t access)
+{
+	GLenum gl_access = kImageAccessTable[access];
+
+	if (image_slot < MAX_IMAGE_UNITS)
+	{
+		ImageBindingCache& binding = m_device_data.state.images[image_slot];
+
+		if (binding.id == texture->id && binding.level == (GLint)mip_level && binding.access == gl_access)
+		{
+			m_device_data.stats.filtered_state_calls++;
+			return;
+		}
+
+		binding.id = texture->id;
+		binding.level = mip_level;
+		binding.access = gl_access;
+	}
+
+	// Arrays, cubes and 3D textures bind every layer of the mip.
+	GLboolean layered = texture->gl_texture_target != GL_TEXTURE_1D && texture->gl_texture_target != GL_TEXTURE_2D;
+
+	m_device_data.stats.issued_state_calls++;
+	GL_CHECK_ERROR(glBindImageTexture(image_slot, texture->id, mip_level, layered, 0, gl_access, texture->internal_format));
+}
+
+void RenderDevice::bind_vertex_array(VertexArray* vertex_array)
+{
+	m_device_data.current_index_buffer = vertex_array->ib;
+
+	if (cache_update(m_device_data, m_device_data.state.vertex_array, vertex_array->id))
+	{
+		GL_CHECK_ERROR(glBindVertexArray(vertex_array->id));
+	}
+}
+
+void RenderDevice::bind_rasterizer_state(RasterizerState* state)
+{
+	m_device_data.current_pso = nullptr;
+	apply_rasterizer_state(state, PSO_DIFF_RASTERIZER);
+}
+
+void RenderDevice::apply_rasterizer_state(RasterizerState* state, uint32_t fields)
+{
+	GLStateCache& cache = m_device_data.state;
+
+	if (fields & PSO_DIFF_CULL)
+	{
+		set_capability(m_device_data, cache.enable_cull_face, GL_CULL_FACE, state->enable_cull_face);
+
+		if (state->enable_cull_face && cache_update(m_device_data, cache.cull_face, state->cull_face))
+		{
+			GL_CHECK_ERROR(glCullFace(state->cull_face));
+		}
+	}
+
+	if ((fields & PSO_DIFF_POLYGON_MODE) && cache_update(m_device_data, cache.polygon_mode, state->polygon_mode))
+	{
+		GL_CHECK_ERROR(glPolygonMode(GL_FRONT_AND_BACK, state->polygon_mode));
+	}
+
+	if (fields & PSO_DIFF_MULTISAMPLE)
+		set_capability(m_device_data, cache.enable_multisample, GL_MULTISAMPLE, state->enable_multisample);
+
+	if (fields & PSO_DIFF_SCISSOR)
+		set_capability(m_device_data, cache.enable_scissor, GL_SCISSOR_TEST, state->enable_scissor);
+
+	GLenum front_face = state->enable_front_face_ccw ? GL_CCW : GL_CW;
+
+	if ((fields & PSO_DIFF_FRONT_FACE) && cache_update(m_device_data, cache.front_face, front_face))
+	{
+		GL_CHECK_ERROR(glFrontFace(front_face));
+	}
+}
+
+void RenderDevice::bind_sampler_state(SamplerState* state, uint32_t shader_stage, uint32_t slot)
+{
+	// Sampler uniforms are pointed at their units once at link time, so this is a plain bind.
+	if (slot >= MAX_TEXTURE_UNITS || cache_update(m_device_data, m_device_data.state.samplers[slot], state->id))
+	{
+		GL_CHECK_ERROR(glBindSampler(slot, state->id));
+	}
+}
+
+void RenderDevice::bind_framebuffer(Framebuffer* framebuffer)
+{
+	GLuint id = framebuffer ? framebuffer->id : 0;
+
+	if (cache_update(m_device_data, m_device_data.state.framebuffer, id))
+	{
+		GL_CHECK_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, id));
+	}
+}
+
+void RenderDevice::bind_depth_stencil_state(DepthStencilState* state)
+{
+	m_device_data.current_pso = nullptr;
+	apply_depth_stencil_state(state, PSO_DIFF_DEPTH_STENCIL);
+}
+
+void RenderDevice::apply_depth_stencil_state(DepthStencilState* state, uint32_t fields)
+{
+	GLStateCache& cache = m_device_data.state;
+
+	// Set Depth Options
+
+	if (fields & PSO_DIFF_DEPTH_TEST)
+		set_capability(m_device_data, cache.enable_depth, GL_DEPTH_TEST, state->enable_depth);
+
+	if ((fields & PSO_DIFF_DEPTH_FUNC) && cache_update(m_device_data, cache.depth_func, state->depth_func))
+	{
+		GL_CHECK_ERROR(glDepthFunc(state->depth_func));
+	}
+
+	if (fields & PSO_DIFF_DEPTH_MASK)
+	{
+		uint8_t depth_mask = state->depth_mask ? GL_TRUE : GL_FALSE;
+
+		if (cache.depth_mask != depth_mask)
+		{
+			cache.depth_mask = depth_mask;
+			m_device_data.stats.issued_state_calls++;
+			GL_CHECK_ERROR(glDepthMask(depth_mask));
+		}
+		else
+			m_device_data.stats.filtered_state_calls++;
+	}
+
+	// Set Stencil Options
+
+	if (fields & PSO_DIFF_STENCIL_TEST)
+		set_capability(m_device_data, cache.enable_stencil, GL_STENCIL_TEST, state->enable_stencil);
+
+	if (fields & PSO_DIFF_STENCIL_FRONT)
+	{
+		StencilFaceCache front = { state->front_stencil_comparison, state->stencil_mask, state->front_stencil_fail, state->front_stencil_pass_depth_fail, state->front_stencil_pass_depth_pass };
+		set_stencil_face(m_device_data, cache.front_stencil, GL_FRONT, front);
+	}
+
+	if (fields & PSO_DIFF_STENCIL_BACK)
+	{
+		StencilFaceCache back = { state->back_stencil_comparison, state->stencil_mask, state->back_stencil_fail, state->back_stencil_pass_depth_fail, state->back_stencil_pass_depth_pass };
+		set_stencil_face(m_device_data, cache.back_stencil, GL_BACK, back);
+	}
+}
+
+void RenderDevice::bind_blend_state(BlendState* state)
+{
+	m_device_data.current_pso = nullptr;
+	apply_blend_state(state);
+}
+
+// Without independent blending every draw buffer gets the same state through the non-indexed
+// calls, which are only issued if any draw buffer differs. Independent blending issues indexed
+// calls for the draw buffers that differ.
+void RenderDevice::apply_blend_state(BlendState* state)
+{
+	BlendTargetCache* cache = &m_device_data.state.blend[0];
+	uint32_t num_targets = state->independent ? MAX_BLEND_TARGETS : 1;
+
+	for (uint32_t i = 0; i < num_targets; i++)
+	{
+		const BlendTargetState& target = state->targets[i];
+		uint32_t first = state->independent ? i : 0;
+		uint32_t last = state->independent ? i + 1 : MAX_BLEND_TARGETS;
+
+		bool enable_differs = false;
+		bool func_differs = false;
+		bool equation_differs = false;
+		bool mask_differs = false;
+
+		for (uint32_t j = first; j < last; j++)
+		{
+			enable_differs = enable_differs || cache[j].enable != (uint8_t)target.enable;
+			mask_differs = mask_differs || cache[j].color_mask != target.color_mask;
+
+			// Factors and equations are left alone while blending is disabled.
+			if (target.enable)
+			{
+				func_differs = func_differs || cache[j].src_color != target.src_color || cache[j].dst_color != target.dst_color || cache[j].src_alpha != target.src_alpha || cache[j].dst_alpha != target.dst_alpha;
+				equation_differs = equation_differs || cache[j].color_op != target.color_op || cache[j].alpha_op != target.alpha_op;
+			}
+		}
+
+		uint32_t issued = (enable_differs ? 1 : 0) + (func_differs ? 1 : 0) + (equation_differs ? 1 : 0) + (mask_differs ? 1 : 0);
+		m_device_data.stats.issued_state_calls += issued;
+		m_device_data.stats.filtered_state_calls += 4 - issued;
+
+		if (enable_differs)
+		{
+			if (!state->independent)
+			{
+				if (target.enable)
+				{
+					GL_CHECK_ERROR(glEnable(GL_BLEND));
+				}
+				else
+				{
+					GL_CHECK_ERROR(glDisable(GL_BLEND));
+				}
+			}
+			else if (target.enable)
+			{
+				GL_CHECK_ERROR(glEnablei(GL_BLEND, i));
+			}
+			else
+			{
+				GL_CHECK_ERROR(glDisablei(GL_BLEND, i));
+			}
+		}
+
+		if (func_differs)
+		{
+			if (state->independent)
+			{
+				GL_CHECK_ERROR(glBlendFuncSeparatei(i, target.src_color, target.dst_color, target.src_alpha, target.dst_alpha));
+			}
+			else
+			{
+				GL_CHECK_ERROR(glBlendFuncSeparate(target.src_color, target.dst_color, target.src_alpha, target.dst_alpha));
+			}
+		}
+
+		if (equation_differs)
+		{
+			if (state->independent)
+			{
+				GL_CHECK_ERROR(glBlendEquationSeparatei(i, target.color_op, target.alpha_op));
+			}
+			else
+			{
+				GL_CHECK_ERROR(glBlendEquationSeparate(target.color_op, target.alpha_op));
+			}
+		}
+
+		if (mask_differs)
+		{
+			GLboolean r = (target.color_mask & ColorWriteMask::RED) ? GL_TRUE : GL_FALSE;
+			GLboolean g = (target.color_mask & ColorWriteMask::GREEN) ? GL_TRUE : GL_FALSE;
+			GLboolean b = (target.color_mask & ColorWriteMask::BLUE) ? GL_TRUE : GL_FALSE;
+			GLboolean a = (target.color_mask & ColorWriteMask::ALPHA) ? GL_TRUE : GL_FALSE;
+
+			if (state->independent)
+			{
+				GL_CHECK_ERROR(glColorMaski(i, r, g, b, a));
+			}
+			else
+			{
+				GL_CHECK_ERROR(glColorMask(r, g, b, a));
+			}
+		}
+
+		for (uint32_t j = first; j < last; j++)
+		{
+			cache[j].enable = (uint8_t)target.enable;
+			cache[j].color_mask = target.color_mask;
+
+			if (func_differs)
+			{
+				cache[j].src_color = target.src_color;
+				cache[j].dst_color = target.dst_color;
+				cache[j].src_alpha = target.src_alpha;
+				cache[j].dst_alpha = target.dst_alpha;
+			}
+
+			if (equation_differs)
+			{
+				cache[j].color_op = target.color_op;
+				cache[j].alpha_op = target.alpha_op;
+			}
+		}
+	}
+}
+
+void RenderDevice::bind_shader_program(ShaderProgram* program)
+{
+	if (program->status != ProgramStatus::READY)
+	{
+		// Without a placeholder there is nothing else to draw with, so the first bind waits.
+		if (m_device_data.placeholder_program)
+			shader_program_status(program);
+		else
+			finish_shader_program(program);
+
+		if (program->status != ProgramStatus::READY)
+		{
+			// A program that failed to link cannot be used, the previous binding is left in place.
+			if (!m_device_data.placeholder_program)
+			{
+				LOG_ERROR("Cannot bind a Shader Program that failed to link");
+				return;
+			}
+
+			program = m_device_data.placeholder_program;
+		}
+	}
+
+	m_device_data.current_program = program;
+
+	if (cache_update(m_device_data, m_device_data.state.program, program->id))
+	{
+		GL_CHECK_ERROR(glUseProgram(program->id));
+	}
+}
+
+void* RenderDevice::map_buffer(Buffer* buffer, uint32_t type)
+{
+	void* ptr = nullptr;
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(ptr = glMapNamedBuffer(buffer->id, kMapUsageTable[type]));
+		return ptr;
+	}
+
+	GL_CHECK_ERROR(glBindBuffer(buffer->buffer_type, buffer->id));
+	GL_CHECK_ERROR(ptr = glMapBuffer(buffer->buffer_type, kMapUsageTable[type]));
+	return ptr;
+}
+
+void RenderDevice::unmap_buffer(Buffer* buffer)
+{
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glUnmapNamedBuffer(buffer->id));
+		return;
+	}
+
+	GL_CHECK_ERROR(glUnmapBuffer(buffer->buffer_type));
+	GL_CHECK_ERROR(glBindBuffer(buffer->buffer_type, 0));
+}
+
+void RenderDevice::update_buffer(Buffer* buffer, size_t offset, size_t size, const void* data)
+{
+	if (buffer->persistent_data)
+	{
+		memcpy(buffer->persistent_data + offset, data, size);
+		return;
+	}
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glNamedBufferSubData(buffer->id, offset, size, data));
+		return;
+	}
+
+	GL_CHECK_ERROR(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer->id));
+	GL_CHECK_ERROR(glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data));
+	GL_CHECK_ERROR(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+}
+
+void RenderDevice::copy_uniform_data(UniformBuffer* buffer, void* data, size_t offset, size_t size)
+{
+	if (buffer->persistent_data)
+	{
+		memcpy(buffer->persistent_data + offset, data, size);
+		return;
+	}
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glNamedBufferSubData(buffer->id, offset, size, data));
+		return;
+	}
+
+	GL_CHECK_ERROR(glBindBuffer(GL_UNIFORM_BUFFER, buffer->id));
+	GL_CHECK_ERROR(glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data));
+	GL_CHECK_ERROR(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+}
+
+void RenderDevice::begin_uniform_ring_frame(UniformRingBuffer* buffer)
+{
+	buffer->current_region = (buffer->current_region + 1) % buffer->num_regions;
+	buffer->head = 0;
+
+	GLsync& fence = buffer->fences[buffer->current_region];
+
+	if (fence)
+	{
+		GLenum result = glClientWaitSync(fence, 0, 0);
+
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+		if (result == GL_WAIT_FAILED)
+			LOG_ERROR("Failed to wait on Uniform Ring Buffer fence");
+
+		GL_CHECK_ERROR(glDeleteSync(fence));
+		fence = nullptr;
+	}
+}
+
+void RenderDevice::end_uniform_ring_frame(UniformRingBuffer* buffer)
+{
+	GL_CHECK_ERROR(buffer->fences[buffer->current_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+void* RenderDevice::allocate_uniform_data(UniformRingBuffer* buffer, size_t size, size_t* offset)
+{
+	uint32_t aligned_size = (uint32_t)(((size + buffer->alignment - 1) / buffer->alignment) * buffer->alignment);
+	uint32_t local_offset = buffer->head.fetch_add(aligned_size);
+
+	if (local_offset + aligned_size > buffer->region_size)
+		return nullptr;
+
+	*offset = buffer->current_region * buffer->region_size + local_offset;
+
+	return buffer->persistent_data + *offset;
+}
+
+void RenderDevice::update_texture_2d(Texture2D* texture, uint32_t mip_level, const void* data)
+{
+	GLsizei width = texture->width >> mip_level;
+	GLsizei height = texture->height >> mip_level;
+
+	upload_texture_image(texture, mip_level, 0, width > 0 ? width : 1, height > 0 ? height : 1, 1, data);
+}
+
+void RenderDevice::update_texture_2d(Texture2D* texture, uint32_t mip_level, StagingBuffer* buffer, size_t offset)
+{
+	GL_CHECK_ERROR(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->id));
+	update_texture_2d(texture, mip_level, (const void*)offset);
+	GL_CHECK_ERROR(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+}
+
+void RenderDevice::update_texture_2d_array(Texture2DArray* texture, uint32_t layer, uint32_t mip_level, const void* data)
+{
+	GLsizei width = texture->width >> mip_level;
+	GLsizei height = texture->height >> mip_level;
+
+	upload_texture_image(texture, mip_level, layer, width > 0 ? width : 1, height > 0 ? height : 1, 1, data);
+}
+
+void RenderDevice::copy_texture_mips(Texture2D* dst, uint32_t dst_mip, Texture2D* src, uint32_t src_mip, uint32_t count)
+{
+	if (!texture_copy_supported())
+	{
+		LOG_ERROR("Texture copies require OpenGL 4.3");
+		return;
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		GLsizei width = src->width >> (src_mip + i);
+		GLsizei height = src->height >> (src_mip + i);
+
+		width = width > 0 ? width : 1;
+		height = height > 0 ? height : 1;
+
+		GL_CHECK_ERROR(glCopyImageSubData(src->id, GL_TEXTURE_2D, src_mip + i, 0, 0, 0, dst->id, GL_TEXTURE_2D, dst_mip + i, 0, 0, 0, width, height, 1));
+	}
+}
+
+bool RenderDevice::texture_copy_supported()
+{
+	return GLAD_GL_VERSION_4_3 != 0;
+}
+
+void RenderDevice::replace_texture_storage(Texture2D* texture, Texture2D* replacement)
+{
+	for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		if (m_device_data.state.textures[i] == texture->id)
+			m_device_data.state.textures[i] = 0;
+	}
+
+	GL_CHECK_ERROR(glDeleteTextures(1, &texture->id));
+
+	texture->id = replacement->id;
+	texture->width = replacement->width;
+	texture->height = replacement->height;
+	texture->mip_levels = replacement->mip_levels;
+
+	m_device_data.texture_2d_pool.free(replacement);
+}
+
+void RenderDevice::insert_fence(Fence& fence)
+{
+	release_fence(fence);
+	GL_CHECK_ERROR(fence.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+bool RenderDevice::fence_signaled(Fence& fence)
+{
+	if (!fence.sync)
+		return true;
+
+	GLenum result;
+	GL_CHECK_ERROR(result = glClientWaitSync(fence.sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0));
+
+	if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+	{
+		release_fence(fence);
+		return true;
+	}
+
+	return false;
+}
+
+void RenderDevice::release_fence(Fence& fence)
+{
+	if (fence.sync)
+	{
+		GL_CHECK_ERROR(glDeleteSync(fence.sync));
+		fence.sync = nullptr;
+	}
+}
+
+void RenderDevice::begin_gpu_timer(GpuTimer& timer)
+{
+	if (!timer.query)
+	{
+		GL_CHECK_ERROR(glGenQueries(1, &timer.query));
+	}
+
+	timer.pending = false;
+	GL_CHECK_ERROR(glBeginQuery(GL_TIME_ELAPSED, timer.query));
+}
+
+void RenderDevice::end_gpu_timer(GpuTimer& timer)
+{
+	GL_CHECK_ERROR(glEndQuery(GL_TIME_ELAPSED));
+	timer.pending = true;
+}
+
+bool RenderDevice::gpu_timer_result(GpuTimer& timer, double& milliseconds)
+{
+	if (!timer.pending)
+		return false;
+
+	GLint available = 0;
+	GL_CHECK_ERROR(glGetQueryObjectiv(timer.query, GL_QUERY_RESULT_AVAILABLE, &available));
+
+	if (!available)
+		return false;
+
+	GLuint64 nanoseconds = 0;
+	GL_CHECK_ERROR(glGetQueryObjectui64v(timer.query, GL_QUERY_RESULT, &nanoseconds));
+
+	timer.pending = false;
+	milliseconds = double(nanoseconds) / 1000000.0;
+
+	return true;
+}
+
+void RenderDevice::release_gpu_timer(GpuTimer& timer)
+{
+	if (timer.query)
+	{
+		GL_CHECK_ERROR(glDeleteQueries(1, &timer.query));
+		timer.query = 0;
+	}
+
+	timer.pending = false;
+}
+
+void RenderDevice::set_primitive_type(uint32_t primitive)
+{
+	m_device_data.current_pso = nullptr;
+	m_device_data.primitive_type = kDrawPrimitiveTypeTable[primitive];
+}
+
+void RenderDevice::clear_framebuffer(uint32_t clear_target, float* clear_color)
+{
+	float* cached_color = &m_device_data.state.clear_color[0];
+
+	if (cached_color[0] != clear_color[0] || cached_color[1] != clear_color[1] || cached_color[2] != clear_color[2] || cached_color[3] != clear_color[3])
+	{
+		memcpy(cached_color, clear_color, sizeof(float) * 4);
+		m_device_data.stats.issued_state_calls++;
+		GL_CHECK_ERROR(glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]));
+	}
+	else
+		m_device_data.stats.filtered_state_calls++;
 
-	return pso;
+	uint32_t bits = ((clear_target & ClearTarget::COLOR) == ClearTarget::COLOR) ? GL_COLOR_BUFFER_BIT   : 0;
+	bits |= ((clear_target & ClearTarget::DEPTH) == ClearTarget::DEPTH)         ? GL_DEPTH_BUFFER_BIT   : 0;
+	bits |= ((clear_target & ClearTarget::STENCIL) == ClearTarget::STENCIL)     ? GL_STENCIL_BUFFER_BIT : 0;
+
+    GL_CHECK_ERROR(glClear(bits));
 }
 
-SamplerState* RenderDevice::create_sampler_state(const SamplerStateCreateDesc& desc)
+void RenderDevice::set_viewport(uint32_t width, uint32_t height, uint32_t top_left_x, uint32_t top_left_y)
 {
-	SamplerState* samplerState = new SamplerState();
+	GLint* viewport = &m_device_data.state.viewport[0];
 
-	GL_CHECK_ERROR(glGenSamplers(1, &samplerState->id));
+	if (viewport[0] != (GLint)top_left_x || viewport[1] != (GLint)top_left_y || viewport[2] != (GLint)width || viewport[3] != (GLint)height)
+	{
+		viewport[0] = top_left_x;
+		viewport[1] = top_left_y;
+		viewport[2] = width;
+		viewport[3] = height;
+
+		m_device_data.stats.issued_state_calls++;
+		GL_CHECK_ERROR(glViewport(top_left_x, top_left_y, width, height));
+	}
+	else
+		m_device_data.stats.filtered_state_calls++;
+}
 
-	GL_CHECK_ERROR(glSamplerParameteri(samplerState->id, GL_TEXTURE_WRAP_S, kTextureWrapModeTable[desc.wrap_mode_u]));
+void RenderDevice::blit_framebuffer(Framebuffer* src, uint32_t src_width, uint32_t src_height, Framebuffer* dst, uint32_t dst_width, uint32_t dst_height, bool linear)
+{
+	GLuint src_id = src ? src->id : 0;
+	GLuint dst_id = dst ? dst->id : 0;
+	GLenum filter = linear ? GL_LINEAR : GL_NEAREST;
 
-	if (desc.wrap_mode_u == TextureWrapMode::CLAMP_TO_BORDER)
+	if (m_device_data.dsa)
 	{
-		GLfloat borderColor[] = { desc.border_color[0], desc.border_color[1], desc.border_color[2], desc.border_color[3] };
-		GL_CHECK_ERROR(glSamplerParameterfv(samplerState->id, GL_TEXTURE_BORDER_COLOR, borderColor));
+		GL_CHECK_ERROR(glBlitNamedFramebuffer(src_id, dst_id, 0, 0, src_width, src_height, 0, 0, dst_width, dst_height, GL_COLOR_BUFFER_BIT, filter));
 	}
+	else
+	{
+		GL_CHECK_ERROR(glBindFramebuffer(GL_READ_FRAMEBUFFER, src_id));
+		GL_CHECK_ERROR(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dst_id));
+		GL_CHECK_ERROR(glBlitFramebuffer(0, 0, src_width, src_height, 0, 0, dst_width, dst_height, GL_COLOR_BUFFER_BIT, filter));
+
+		// Restore the shadowed binding. An invalidated cache rebinds on the next bind_framebuffer anyway.
+		if (m_device_data.state.framebuffer != GLuint(~0))
+		{
+			GL_CHECK_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, m_device_data.state.framebuffer));
+		}
+	}
+}
+
+void RenderDevice::draw(uint32_t first_index, uint32_t count)
+{
+	m_device_data.stats.draw_calls++;
+	GL_CHECK_ERROR(glDrawArrays(m_device_data.primitive_type, first_index, count));
+}
+
+void RenderDevice::draw_indexed(uint32_t index_count)
+{
+	m_device_data.stats.draw_calls++;
+    GL_CHECK_ERROR(glDrawElements(m_device_data.primitive_type,
+                                  index_count,
+                                  ((m_device_data.current_index_buffer) ? m_device_data.current_index_buffer->type : GL_UNSIGNED_INT),
+                                  0));
+}
+
+void RenderDevice::draw_indexed_base_vertex(uint32_t index_count, uint32_t base_index, uint32_t base_vertex)
+{
+	m_device_data.stats.draw_calls++;
+	GLenum type = (m_device_data.current_index_buffer) ? m_device_data.current_index_buffer->type : GL_UNSIGNED_INT;
+
+	GL_CHECK_ERROR(glDrawElementsBaseVertex(m_device_data.primitive_type,
+											index_count,
+											type,
+											(void*)((size_t)index_type_size(type) * base_index),
+											base_vertex));
+}
+
+void RenderDevice::draw_instanced(uint32_t first_index, uint32_t count, uint32_t instance_count)
+{
+	m_device_data.stats.draw_calls++;
+	GL_CHECK_ERROR(glDrawArraysInstanced(m_device_data.primitive_type, first_index, count, instance_count));
+}
+
+void RenderDevice::draw_indexed_instanced(uint32_t index_count, uint32_t instance_count)
+{
+	m_device_data.stats.draw_calls++;
+	GL_CHECK_ERROR(glDrawElementsInstanced(m_device_data.primitive_type,
+										   index_count,
+										   ((m_device_data.current_index_buffer) ? m_device_data.current_index_buffer->type : GL_UNSIGNED_INT),
+										   0,
+										   instance_count));
+}
+
+void RenderDevice::draw_indexed_base_vertex_instanced(uint32_t index_count, uint32_t base_index, uint32_t base_vertex, uint32_t instance_count, uint32_t base_instance)
+{
+	m_device_data.stats.draw_calls++;
+	GLenum type = (m_device_data.current_index_buffer) ? m_device_data.current_index_buffer->type : GL_UNSIGNED_INT;
+
+	GL_CHECK_ERROR(glDrawElementsInstancedBaseVertexBaseInstance(m_device_data.primitive_type,
+																 index_count,
+																 type,
+																 (void*)((size_t)index_type_size(type) * base_index),
+																 instance_count,
+																 base_vertex,
+																 base_instance));
+}
 
-	GL_CHECK_ERROR(glSamplerParameteri(samplerState->id, GL_TEXTURE_WRAP_T, kTextureWrapModeTable[desc.wrap_mode_v]));
+uint32_t RenderDevice::add_draw_to_batch(DrawBatch* batch, uint32_t index_count, uint32_t base_index, uint32_t base_vertex, const void* draw_data)
+{
+	uint32_t draw_id = (uint32_t)batch->commands.size();
 
-	if (desc.wrap_mode_v == TextureWrapMode::CLAMP_TO_BORDER)
+	if (draw_id >= batch->max_draws)
 	{
-		GLfloat borderColor[] = { desc.border_color[0], desc.border_color[1], desc.border_color[2], desc.border_color[3] };
-		GL_CHECK_ERROR(glSamplerParameterfv(samplerState->id, GL_TEXTURE_BORDER_COLOR, borderColor));
+		LOG_ERROR("Draw Batch is full");
+		return GL_INVALID_INDEX;
 	}
 
-	GL_CHECK_ERROR(glSamplerParameteri(samplerState->id, GL_TEXTURE_WRAP_R, kTextureWrapModeTable[desc.wrap_mode_w]));
-
-	if (desc.wrap_mode_w == TextureWrapMode::CLAMP_TO_BORDER)
+	if (batch->draw_data_stride > 0 && !draw_data)
 	{
-		GLfloat borderColor[] = { desc.border_color[0], desc.border_color[1], desc.border_color[2], desc.border_color[3] };
-		GL_CHECK_ERROR(glSamplerParameterfv(samplerState->id, GL_TEXTURE_BORDER_COLOR, borderColor));
+		LOG_ERROR("Draw Batch requires draw data");
+		return GL_INVALID_INDEX;
 	}
 
-	// Texture Filtering
+	DrawElementsIndirectCommand cmd;
 
-    if ((desc.min_filter == TextureFilteringMode::ANISOTROPIC_ALL || desc.mag_filter == TextureFilteringMode::ANISOTROPIC_ALL) && desc.max_anisotropy > 0)
-    {
-        if (GL_EXT_texture_filter_anisotropic)
-        {
-            GLfloat glmaxAnisotropy;
-            GL_CHECK_ERROR(glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &glmaxAnisotropy));
-
-            if (desc.max_anisotropy <= glmaxAnisotropy) {
-                GL_CHECK_ERROR(glSamplerParameterf(samplerState->id, GL_TEXTURE_MAX_ANISOTROPY_EXT, desc.max_anisotropy));
-            }
-            else {
-                GL_CHECK_ERROR(glSamplerParameterf(samplerState->id, GL_TEXTURE_MAX_ANISOTROPY_EXT, glmaxAnisotropy));
-            }
-        }
-        else
-        {
-            GL_CHECK_ERROR(glSamplerParameteri(samplerState->id, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-            GL_CHECK_ERROR(glSamplerParameteri(samplerState->id, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-        }
-    }
-    else
-    {
-        GL_CHECK_ERROR(glSamplerParameteri(samplerState->id, GL_TEXTURE_MAG_FILTER, kTextureMagFilteringModeTable[desc.mag_filter]));
-        GL_CHECK_ERROR(glSamplerParameteri(samplerState->id, GL_TEXTURE_MIN_FILTER, kTextureMinFilteringModeTable[desc.min_filter]));
-    }
+	cmd.index_count = index_count;
+	cmd.instance_count = 1;
+	cmd.first_index = base_index;
+	cmd.base_vertex = (int32_t)base_vertex;
+	cmd.base_instance = draw_id;
 
-	return samplerState;
-}
+	batch->commands.push_back(cmd);
 
-void RenderDevice::destroy_shader(Shader* shader)
-{
-	if (shader)
+	if (batch->draw_data_stride > 0)
 	{
-		GL_CHECK_ERROR(glDeleteShader(shader->id));
-		delete shader;
+		const uint8_t* src = (const uint8_t*)draw_data;
+		batch->draw_data.insert(batch->draw_data.end(), src, src + batch->draw_data_stride);
 	}
+
+	return draw_id;
 }
 
-void RenderDevice::destroy_shader_program(ShaderProgram* program)
+void RenderDevice::upload_draw_batch(DrawBatch* batch)
 {
-	if (program)
+	batch->uploaded_draws = (uint32_t)batch->commands.size();
+
+	if (batch->uploaded_draws == 0)
+		return;
+
+	if (m_device_data.dsa)
 	{
-		GL_CHECK_ERROR(glDeleteProgram(program->id));
-		delete program;
+		GL_CHECK_ERROR(glNamedBufferSubData(batch->indirect_buffer, 0, sizeof(DrawElementsIndirectCommand) * batch->uploaded_draws, batch->commands.data()));
+
+		if (batch->draw_data_buffer != 0)
+		{
+			GL_CHECK_ERROR(glNamedBufferSubData(batch->draw_data_buffer, 0, batch->draw_data_stride * batch->uploaded_draws, batch->draw_data.data()));
+		}
+
+		return;
 	}
-}
 
-void RenderDevice::destroy_vertex_buffer(VertexBuffer* vertex_buffer)
-{
-	if (vertex_buffer)
+	if (cache_update(m_device_data, m_device_data.state.draw_indirect_buffer, batch->indirect_buffer))
 	{
-		GL_CHECK_ERROR(glDeleteBuffers(1, &vertex_buffer->id));
-		delete vertex_buffer;
+		GL_CHECK_ERROR(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch->indirect_buffer));
 	}
-}
 
-void RenderDevice::destroy_index_buffer(IndexBuffer* index_buffer)
-{
-	if (index_buffer)
+	GL_CHECK_ERROR(glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawElementsIndirectCommand) * batch->uploaded_draws, batch->commands.data()));
+
+	if (batch->draw_data_buffer != 0)
 	{
-		GL_CHECK_ERROR(glDeleteBuffers(1, &index_buffer->id));
-		delete index_buffer;
+		GL_CHECK_ERROR(glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->draw_data_buffer));
+		GL_CHECK_ERROR(glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, batch->draw_data_stride * batch->uploaded_draws, batch->draw_data.data()));
+		GL_CHECK_ERROR(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
 	}
 }
 
-void RenderDevice::destroy_uniform_buffer(UniformBuffer* buffer)
+void RenderDevice::reset_draw_batch(DrawBatch* batch)
 {
-	GL_CHECK_ERROR(glDeleteBuffers(1, &buffer->id));
-	delete buffer;
+	batch->commands.clear();
+	batch->draw_data.clear();
 }
 
-void RenderDevice::destroy_vertex_array(VertexArray* vertex_array)
+void RenderDevice::draw_indexed_batch(DrawBatch* batch, uint32_t draw_data_slot)
 {
-	if (vertex_array)
+	if (batch->uploaded_draws == 0)
+		return;
+
+	if (cache_update(m_device_data, m_device_data.state.draw_indirect_buffer, batch->indirect_buffer))
 	{
-		GL_CHECK_ERROR(glDeleteVertexArrays(1, &vertex_array->id));
-		delete vertex_array;
+		GL_CHECK_ERROR(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch->indirect_buffer));
+	}
+
+	if (batch->draw_data_buffer != 0)
+	{
+		if (draw_data_slot >= MAX_STORAGE_BUFFER_SLOTS || cache_update(m_device_data, m_device_data.state.storage_buffers[draw_data_slot], batch->draw_data_buffer))
+		{
+			GL_CHECK_ERROR(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, draw_data_slot, batch->draw_data_buffer));
+		}
 	}
+
+	m_device_data.stats.draw_calls++;
+	GL_CHECK_ERROR(glMultiDrawElementsIndirect(m_device_data.primitive_type,
+											   ((m_device_data.current_index_buffer) ? m_device_data.current_index_buffer->type : GL_UNSIGNED_INT),
+											   nullptr,
+											   batch->uploaded_draws,
+											   0));
 }
 
-void RenderDevice::destroy_texture(Texture* texture)
+void RenderDevice::draw_indexed_indirect(Buffer* buffer, size_t offset, uint32_t draw_count)
 {
-	if (texture)
+	if (draw_count == 0)
+		return;
+
+	if (cache_update(m_device_data, m_device_data.state.draw_indirect_buffer, buffer->id))
 	{
-		GL_CHECK_ERROR(glDeleteTextures(1, &texture->id));
-		delete texture;
+		GL_CHECK_ERROR(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer->id));
 	}
+
+	m_device_data.stats.draw_calls++;
+	GL_CHECK_ERROR(glMultiDrawElementsIndirect(m_device_data.primitive_type,
+											   ((m_device_data.current_index_buffer) ? m_device_data.current_index_buffer->type : GL_UNSIGNED_INT),
+											   (void*)offset,
+											   draw_count,
+											   0));
 }
 
-void RenderDevice::destroy_rasterizer_state(RasterizerState* state)
+bool RenderDevice::indirect_count_supported()
 {
-	delete state;
+	return m_device_data.indirect_count;
 }
 
-void RenderDevice::destroy_sampler_state(SamplerState* state)
+void RenderDevice::draw_indexed_indirect_count(Buffer* buffer, size_t offset, Buffer* count_buffer, size_t count_offset, uint32_t max_draw_count)
 {
-	GL_CHECK_ERROR(glDeleteSamplers(1, &state->id));
-	delete state;
+	if (max_draw_count == 0)
+		return;
+
+	if (cache_update(m_device_data, m_device_data.state.draw_indirect_buffer, buffer->id))
+	{
+		GL_CHECK_ERROR(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer->id));
+	}
+
+	if (cache_update(m_device_data, m_device_data.state.parameter_buffer, count_buffer->id))
+	{
+		GL_CHECK_ERROR(glBindBuffer(GL_PARAMETER_BUFFER, count_buffer->id));
+	}
+
+	m_device_data.stats.draw_calls++;
+	GL_CHECK_ERROR(glMultiDrawElementsIndirectCount(m_device_data.primitive_type,
+													((m_device_data.current_index_buffer) ? m_device_data.current_index_buffer->type : GL_UNSIGNED_INT),
+													(void*)offset,
+													(GLintptr)count_offset,
+													max_draw_count,
+													0));
 }
 
-void RenderDevice::destroy_depth_stencil_state(DepthStencilState* state)
+bool RenderDevice::compute_supported()
 {
-	delete state;
+	return GLAD_GL_VERSION_4_3 != 0;
 }
 
-void RenderDevice::destroy_pipeline_state_object(PipelineStateObject* pso)
+void RenderDevice::dispatch(uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z)
 {
-	destroy_depth_stencil_state(pso->depth_stencil_state);
-	destroy_rasterizer_state(pso->rasterizer_state);
-
-	delete pso;
+	m_device_data.stats.dispatch_calls++;
+	GL_CHECK_ERROR(glDispatchCompute(group_count_x, group_count_y, group_count_z));
 }
 
-void RenderDevice::destroy_framebuffer(Framebuffer* framebuffer)
+void RenderDevice::dispatch_indirect(Buffer* buffer, size_t offset)
 {
-	if (framebuffer)
+	if (cache_update(m_device_data, m_device_data.state.dispatch_indirect_buffer, buffer->id))
 	{
-		GL_CHECK_ERROR(glDeleteFramebuffers(1, &framebuffer->id));
+		GL_CHECK_ERROR(glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, buffer->id));
+	}
+
+	m_device_data.stats.dispatch_calls++;
+	GL_CHECK_ERROR(glDispatchComputeIndirect((GLintptr)offset));
+}
 
-		for (int i = 0; i < framebuffer->num_render_targets; i++)
-			destroy_texture(framebuffer->render_targets[i]);
+void RenderDevice::memory_barrier(uint32_t barriers)
+{
+	GLbitfield gl_barriers = 0;
 
-		if (framebuffer->depth_target)
-			destroy_texture(framebuffer->depth_target);
+	for (uint32_t i = 0; i < sizeof(kBarrierTable) / sizeof(kBarrierTable[0]); i++)
+	{
+		if (barriers & (1u << i))
+			gl_barriers |= kBarrierTable[i];
+	}
 
-		delete framebuffer;
+	if (gl_barriers != 0)
+	{
+		GL_CHECK_ERROR(glMemoryBarrier(gl_barriers));
 	}
 }
 
-void RenderDevice::bind_pipeline_state_object(PipelineStateObject* pso)
+void RenderDevice::reserve_resources(const ResourceReserveDesc& desc)
 {
-	bind_depth_stencil_state(pso->depth_stencil_state);
-	bind_rasterizer_state(pso->rasterizer_state);
-	set_primitive_type(pso->primitive);
+	m_device_data.shader_pool.reserve(desc.shaders);
+	m_device_data.shader_program_pool.reserve(desc.shader_programs);
+	m_device_data.vertex_buffer_pool.reserve(desc.vertex_buffers);
+	m_device_data.index_buffer_pool.reserve(desc.index_buffers);
+	m_device_data.uniform_buffer_pool.reserve(desc.uniform_buffers);
+	m_device_data.texture_2d_pool.reserve(desc.textures);
+	m_device_data.texture_2d_array_pool.reserve(desc.texture_arrays);
+	m_device_data.vertex_array_pool.reserve(desc.vertex_arrays);
+	m_device_data.sampler_state_pool.reserve(desc.sampler_states);
+	m_device_data.framebuffer_pool.reserve(desc.framebuffers);
 }
 
-int RenderDevice::UniformBufferAlignment()
+Shader* RenderDevice::get_shader(ShaderHandle handle)
 {
-	GLint uniformBufferAlignSize = 0;
-	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformBufferAlignSize);
-	return uniformBufferAlignSize;
+	return m_device_data.shader_pool.get(handle.value);
 }
 
-void RenderDevice::bind_texture(Texture* texture, uint32_t shader_stage, uint32_t buffer_slot)
+ShaderProgram* RenderDevice::get_shader_program(ShaderProgramHandle handle)
 {
-	if (m_device_data.last_sampler_location != GL_INVALID_INDEX)
-	{
-		GL_CHECK_ERROR(glBindTexture(texture->gl_texture_target, texture->id));
-	}
+	return m_device_data.shader_program_pool.get(handle.value);
 }
 
-void RenderDevice::bind_uniform_buffer(UniformBuffer* uniform_buffer, uint32_t shader_stage, uint32_t buffer_slot)
+VertexBuffer* RenderDevice::get_vertex_buffer(VertexBufferHandle handle)
 {
-	GL_CHECK_ERROR(glBindBufferBase(GL_UNIFORM_BUFFER, buffer_slot, uniform_buffer->id));
+	return m_device_data.vertex_buffer_pool.get(handle.value);
 }
 
-void RenderDevice::bind_uniform_buffer_range(UniformBuffer* uniform_buffer, uint32_t shader_stage, uint32_t buffer_slot, size_t offset, size_t size)
+IndexBuffer* RenderDevice::get_index_buffer(IndexBufferHandle handle)
 {
-	GL_CHECK_ERROR(glBindBufferRange(GL_UNIFORM_BUFFER, buffer_slot, uniform_buffer->id, offset, size));
+	return m_device_data.index_buffer_pool.get(handle.value);
 }
 
-void RenderDevice::bind_vertex_array(VertexArray* vertex_array)
+UniformBuffer* RenderDevice::get_uniform_buffer(UniformBufferHandle handle)
 {
-	m_device_data.current_index_buffer = vertex_array->ib;
-	GL_CHECK_ERROR(glBindVertexArray(vertex_array->id));
+	return m_device_data.uniform_buffer_pool.get(handle.value);
 }
 
-void RenderDevice::bind_rasterizer_state(RasterizerState* state)
+UniformRingBuffer* RenderDevice::get_uniform_ring_buffer(UniformRingBufferHandle handle)
 {
-	if (state->enable_cull_face)
-    {
-        glEnable(GL_CULL_FACE);
-        GL_CHECK_ERROR(glCullFace(state->cull_face));
-    }
-	else
-		glDisable(GL_CULL_FACE);
-
-	GL_CHECK_ERROR(glPolygonMode(GL_FRONT_AND_BACK, state->polygon_mode));
-
-	if (state->enable_multisample)
-		glEnable(GL_MULTISAMPLE);
-	else
-		glDisable(GL_MULTISAMPLE);
-
-	if (state->enable_scissor)
-		glEnable(GL_SCISSOR_TEST);
-	else
-		glDisable(GL_SCISSOR_TEST);
-
-	if (state->enable_front_face_ccw)
-		glFrontFace(GL_CCW);
-	else
-		glFrontFace(GL_CW);
+	return m_device_data.uniform_ring_buffer_pool.get(handle.value);
 }
 
-void RenderDevice::bind_sampler_state(SamplerState* state, uint32_t shader_stage, uint32_t slot)
+Texture1D* RenderDevice::get_texture_1d(Texture1DHandle handle)
 {
-	GLuint location = m_device_data.current_program->shader_map[shader_stage]->sampler_bindings[slot];
-	m_device_data.last_sampler_location = location;
-
-	if (location != GL_INVALID_INDEX)
-	{
-		GL_CHECK_ERROR(glActiveTexture(GL_TEXTURE0 + slot));
-		GL_CHECK_ERROR(glBindSampler(slot, state->id));
-		GL_CHECK_ERROR(glUniform1i(m_device_data.current_program->shader_map[shader_stage]->sampler_bindings[slot], slot));
-	}
+	return m_device_data.texture_1d_pool.get(handle.value);
 }
 
-void RenderDevice::bind_framebuffer(Framebuffer* framebuffer)
+Texture2D* RenderDevice::get_texture_2d(Texture2DHandle handle)
 {
-	if (framebuffer)
-	{
-		GL_CHECK_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->id));
-	}
-	else
-	{
-		GL_CHECK_ERROR(glBindFramebuffer(GL_FRAMEBUFFER, 0));
-	}
+	return m_device_data.texture_2d_pool.get(handle.value);
 }
 
-void RenderDevice::bind_depth_stencil_state(DepthStencilState* state)
+Texture2DArray* RenderDevice::get_texture_2d_array(Texture2DArrayHandle handle)
 {
-	// Set Depth Options
-
-	if (state->enable_depth)
-		glEnable(GL_DEPTH_TEST);
-	else
-		glDisable(GL_DEPTH_TEST);
+	return m_device_data.texture_2d_array_pool.get(handle.value);
+}
 
-	GL_CHECK_ERROR(glDepthFunc(state->depth_func));
-	GL_CHECK_ERROR(glDepthMask((state->depth_mask) ? GL_TRUE : GL_FALSE));
+Texture3D* RenderDevice::get_texture_3d(Texture3DHandle handle)
+{
+	return m_device_data.texture_3d_pool.get(handle.value);
+}
 
-	// Set Stencil Options
+TextureCube* RenderDevice::get_texture_cube(TextureCubeHandle handle)
+{
+	return m_device_data.texture_cube_pool.get(handle.value);
+}
 
-	if (state->enable_stencil)
-		glEnable(GL_STENCIL_TEST);
-	else
-		glDisable(GL_STENCIL_TEST);
+VertexArray* RenderDevice::get_vertex_array(VertexArrayHandle handle)
+{
+	return m_device_data.vertex_array_pool.get(handle.value);
+}
 
-	GL_CHECK_ERROR(glStencilFuncSeparate(GL_FRONT, state->front_stencil_comparison, 1, state->stencil_mask));
-	GL_CHECK_ERROR(glStencilFuncSeparate(GL_FRONT, state->back_stencil_comparison, 1, state->stencil_mask));
+SamplerState* RenderDevice::get_sampler_state(SamplerStateHandle handle)
+{
+	return m_device_data.sampler_state_pool.get(handle.value);
+}
 
-	// Front Stencil Operation
+Framebuffer* RenderDevice::get_framebuffer(FramebufferHandle handle)
+{
+	return m_device_data.framebuffer_pool.get(handle.value);
+}
 
-	GL_CHECK_ERROR(glStencilOpSeparate(GL_FRONT, state->front_stencil_fail, state->front_stencil_pass_depth_fail, state->front_stencil_pass_depth_pass));
-	GL_CHECK_ERROR(glStencilOpSeparate(GL_BACK, state->back_stencil_fail, state->back_stencil_pass_depth_fail, state->back_stencil_pass_depth_pass));
+StorageBuffer* RenderDevice::get_storage_buffer(StorageBufferHandle handle)
+{
+	return m_device_data.storage_buffer_pool.get(handle.value);
 }
 
-void RenderDevice::bind_shader_program(ShaderProgram* program)
+void RenderDevice::begin_frame()
 {
-	m_device_data.current_program = program;
-	GL_CHECK_ERROR(glUseProgram(program->id));
+	memset(&m_device_data.stats, 0, sizeof(DeviceFrameStats));
 }
 
-void* RenderDevice::map_buffer(Buffer* buffer, uint32_t type)
+const DeviceFrameStats& RenderDevice::frame_stats()
 {
-	void* ptr = nullptr;
-	GL_CHECK_ERROR(glBindBuffer(buffer->buffer_type, buffer->id));
-	GL_CHECK_ERROR(ptr = glMapBuffer(buffer->buffer_type, kMapUsageTable[type]));
-	return ptr;
+	return m_device_data.stats;
 }
 
-void RenderDevice::unmap_buffer(Buffer* buffer)
+void RenderDevice::invalidate_state_cache()
 {
-	GL_CHECK_ERROR(glUnmapBuffer(buffer->buffer_type));
-	GL_CHECK_ERROR(glBindBuffer(buffer->buffer_type, 0));
+	memset(&m_device_data.state, 0xFF, sizeof(GLStateCache));
+	m_device_data.current_pso = nullptr;
 }
 
-void RenderDevice::set_primitive_type(uint32_t primitive)
+void RenderDevice::set_active_texture_unit(uint32_t unit)
 {
-	m_device_data.primitive_type = kDrawPrimitiveTypeTable[primitive];
+	if (cache_update(m_device_data, m_device_data.state.active_texture_unit, unit))
+	{
+		GL_CHECK_ERROR(glActiveTexture(GL_TEXTURE0 + unit));
+	}
 }
 
-void RenderDevice::clear_framebuffer(uint32_t clear_target, float* clear_color)
+void RenderDevice::bind_texture_for_update(Texture* texture)
 {
-	GL_CHECK_ERROR(glClearColor(clear_color[0], clear_color[1], clear_color[2], clear_color[3]));
+	uint32_t unit = m_device_data.state.active_texture_unit;
 
-	uint32_t bits = ((clear_target & ClearTarget::COLOR) == ClearTarget::COLOR) ? GL_COLOR_BUFFER_BIT   : 0;
-	bits |= ((clear_target & ClearTarget::DEPTH) == ClearTarget::DEPTH)         ? GL_DEPTH_BUFFER_BIT   : 0;
-	bits |= ((clear_target & ClearTarget::STENCIL) == ClearTarget::STENCIL)     ? GL_STENCIL_BUFFER_BIT : 0;
+	if (unit >= MAX_TEXTURE_UNITS)
+		memset(&m_device_data.state.textures[0], 0xFF, sizeof(m_device_data.state.textures));
+	else if (!cache_update(m_device_data, m_device_data.state.textures[unit], texture->id))
+		return;
 
-    GL_CHECK_ERROR(glClear(bits));
+	GL_CHECK_ERROR(glBindTexture(texture->gl_texture_target, texture->id));
 }
 
-void RenderDevice::set_viewport(uint32_t width, uint32_t height, uint32_t top_left_x, uint32_t top_left_y)
+void RenderDevice::create_texture_storage(Texture* texture, GLenum target, uint32_t format, GLsizei levels, GLsizei width, GLsizei height, GLsizei depth)
 {
-	GL_CHECK_ERROR(glViewport(top_left_x, top_left_y, width, height));
+	texture->gl_texture_target = target;
+	texture->internal_format = kTextureFormatTable[format][0];
+	texture->format = kTextureFormatTable[format][1];
+	texture->type = kTextureFormatTable[format][2];
+	texture->block_size = compressed_block_size(texture->internal_format);
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glCreateTextures(target, 1, &texture->id));
+
+		if (target == GL_TEXTURE_1D)
+		{
+			GL_CHECK_ERROR(glTextureStorage1D(texture->id, levels, texture->internal_format, width));
+		}
+		else if (target == GL_TEXTURE_2D || target == GL_TEXTURE_CUBE_MAP)
+		{
+			GL_CHECK_ERROR(glTextureStorage2D(texture->id, levels, texture->internal_format, width, height));
+		}
+		else
+		{
+			GL_CHECK_ERROR(glTextureStorage3D(texture->id, levels, texture->internal_format, width, height, depth));
+		}
+
+		return;
+	}
+
+	GL_CHECK_ERROR(glGenTextures(1, &texture->id));
+	bind_texture_for_update(texture);
+
+	// Immutable storage requires GL 4.2. On the GL 4.1 fallback every level is allocated on its own
+	// and the level range is limited to match, so the texture is complete like an immutable one.
+	if (!GLAD_GL_VERSION_4_2)
+	{
+		GL_CHECK_ERROR(glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1));
+
+		for (GLsizei i = 0; i < levels; i++)
+		{
+			GLsizei level_width = width >> i > 0 ? width >> i : 1;
+			GLsizei level_height = height >> i > 0 ? height >> i : 1;
+			GLsizei level_depth = depth;
+
+			// Array layers and cube faces stay the same at every level, 3D depth halves.
+			if (target == GL_TEXTURE_3D)
+				level_depth = depth >> i > 0 ? depth >> i : 1;
+
+			GLsizei size = compressed_image_size(texture->block_size, level_width, level_height);
+
+			if (target == GL_TEXTURE_1D)
+			{
+				GL_CHECK_ERROR(glTexImage1D(target, i, texture->internal_format, level_width, 0, texture->format, texture->type, nullptr));
+			}
+			else if (target == GL_TEXTURE_2D || target == GL_TEXTURE_CUBE_MAP)
+			{
+				GLenum first_target = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+				GLenum last_target = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_NEGATIVE_Z : target;
+
+				for (GLenum face = first_target; face <= last_target; face++)
+				{
+					if (texture->block_size > 0)
+					{
+						GL_CHECK_ERROR(glCompressedTexImage2D(face, i, texture->internal_format, level_width, level_height, 0, size, nullptr));
+					}
+					else
+					{
+						GL_CHECK_ERROR(glTexImage2D(face, i, texture->internal_format, level_width, level_height, 0, texture->format, texture->type, nullptr));
+					}
+				}
+			}
+			else if (texture->block_size > 0)
+			{
+				GL_CHECK_ERROR(glCompressedTexImage3D(target, i, texture->internal_format, level_width, level_height, level_depth, 0, size * level_depth, nullptr));
+			}
+			else
+			{
+				GL_CHECK_ERROR(glTexImage3D(target, i, texture->internal_format, level_width, level_height, level_depth, 0, texture->format, texture->type, nullptr));
+			}
+		}
+
+		return;
+	}
+
+	if (target == GL_TEXTURE_1D)
+	{
+		GL_CHECK_ERROR(glTexStorage1D(target, levels, texture->internal_format, width));
+	}
+	else if (target == GL_TEXTURE_2D || target == GL_TEXTURE_CUBE_MAP)
+	{
+		GL_CHECK_ERROR(glTexStorage2D(target, levels, texture->internal_format, width, height));
+	}
+	else
+	{
+		GL_CHECK_ERROR(glTexStorage3D(target, levels, texture->internal_format, width, height, depth));
+	}
 }
 
-void RenderDevice::draw(uint32_t first_index, uint32_t count)
+// Uploads one mip of depth slices or layers starting at layer. Cube map faces are layers.
+void RenderDevice::upload_texture_image(Texture* texture, uint32_t mip_level, GLint layer, GLsizei width, GLsizei height, GLsizei depth, const void* data)
 {
-	GL_CHECK_ERROR(glDrawArrays(m_device_data.primitive_type, first_index, count));
+	GLenum target = texture->gl_texture_target;
+	GLsizei size = texture->block_size > 0 ? compressed_image_size(texture->block_size, width, height) * depth : 0;
+
+	if (m_device_data.dsa)
+	{
+		if (target == GL_TEXTURE_1D)
+		{
+			GL_CHECK_ERROR(glTextureSubImage1D(texture->id, mip_level, 0, width, texture->format, texture->type, data));
+		}
+		else if (target == GL_TEXTURE_2D && texture->block_size > 0)
+		{
+			GL_CHECK_ERROR(glCompressedTextureSubImage2D(texture->id, mip_level, 0, 0, width, height, texture->internal_format, size, data));
+		}
+		else if (target == GL_TEXTURE_2D)
+		{
+			GL_CHECK_ERROR(glTextureSubImage2D(texture->id, mip_level, 0, 0, width, height, texture->format, texture->type, data));
+		}
+		else if (texture->block_size > 0)
+		{
+			GL_CHECK_ERROR(glCompressedTextureSubImage3D(texture->id, mip_level, 0, 0, layer, width, height, depth, texture->internal_format, size, data));
+		}
+		else
+		{
+			GL_CHECK_ERROR(glTextureSubImage3D(texture->id, mip_level, 0, 0, layer, width, height, depth, texture->format, texture->type, data));
+		}
+
+		return;
+	}
+
+	bind_texture_for_update(texture);
+
+	// Without DSA cube map faces are separate 2D targets.
+	if (target == GL_TEXTURE_CUBE_MAP)
+		target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + layer;
+
+	if (target == GL_TEXTURE_1D)
+	{
+		GL_CHECK_ERROR(glTexSubImage1D(target, mip_level, 0, width, texture->format, texture->type, data));
+	}
+	else if (target != GL_TEXTURE_3D && target != GL_TEXTURE_2D_ARRAY && texture->block_size > 0)
+	{
+		GL_CHECK_ERROR(glCompressedTexSubImage2D(target, mip_level, 0, 0, width, height, texture->internal_format, size, data));
+	}
+	else if (target != GL_TEXTURE_3D && target != GL_TEXTURE_2D_ARRAY)
+	{
+		GL_CHECK_ERROR(glTexSubImage2D(target, mip_level, 0, 0, width, height, texture->format, texture->type, data));
+	}
+	else if (texture->block_size > 0)
+	{
+		GL_CHECK_ERROR(glCompressedTexSubImage3D(target, mip_level, 0, 0, layer, width, height, depth, texture->internal_format, size, data));
+	}
+	else
+	{
+		GL_CHECK_ERROR(glTexSubImage3D(target, mip_level, 0, 0, layer, width, height, depth, texture->format, texture->type, data));
+	}
 }
 
-void RenderDevice::draw_indexed(uint32_t index_count)
+void RenderDevice::generate_texture_mipmaps(Texture* texture)
 {
-    GL_CHECK_ERROR(glDrawElements(m_device_data.primitive_type,
-                                  index_count,
-                                  ((m_device_data.current_index_buffer) ? m_device_data.current_index_buffer->type : GL_UNSIGNED_INT),
-                                  0));
+	// Block compressed data has to come with its mips precomputed, see the TextureCooker.
+	if (texture->block_size > 0)
+	{
+		LOG_WARNING("Mipmaps can not be generated for block compressed textures");
+		return;
+	}
+
+	if (m_device_data.dsa)
+	{
+		GL_CHECK_ERROR(glGenerateTextureMipmap(texture->id));
+	}
+	else
+	{
+		bind_texture_for_update(texture);
+		GL_CHECK_ERROR(glGenerateMipmap(texture->gl_texture_target));
+	}
 }
 
-void RenderDevice::draw_indexed_base_vertex(uint32_t index_count, uint32_t base_index, uint32_t base_vertex)
+void RenderDevice::submit_command_buffer(CommandBuffer* cmd_buf)
 {
-	GL_CHECK_ERROR(glDrawElementsBaseVertex(m_device_data.primitive_type,
-											index_count, 
-											((m_device_data.current_index_buffer) ? m_device_data.current_index_buffer->type : GL_UNSIGNED_INT), 
-											(void*)(sizeof(unsigned int) * base_index), 
-											base_vertex));
+	const uint8_t* ptr = cmd_buf->begin();
+	const uint8_t* end = cmd_buf->end();
+
+	while (ptr < end)
+	{
+		const CommandHeader* header = (const CommandHeader*)ptr;
+		const void* payload = ptr + ((sizeof(CommandHeader) + (COMMAND_PACKET_ALIGNMENT - 1)) & ~size_t(COMMAND_PACKET_ALIGNMENT - 1));
+
+		switch (header->type)
+		{
+			case GraphicsCommandType::Draw:
+			{
+				const DrawCommand* cmd = (const DrawCommand*)payload;
+				draw(cmd->first_index, cmd->count);
+				break;
+			}
+			case GraphicsCommandType::DrawIndexed:
+			{
+				const DrawIndexedCommand* cmd = (const DrawIndexedCommand*)payload;
+				draw_indexed(cmd->index_count);
+				break;
+			}
+			case GraphicsCommandType::DrawIndexedBaseVertex:
+			{
+				const DrawIndexedBaseVertexCommand* cmd = (const DrawIndexedBaseVertexCommand*)payload;
+				draw_indexed_base_vertex(cmd->index_count, cmd->base_index, cmd->base_vertex);
+				break;
+			}
+			case GraphicsCommandType::DrawInstanced:
+			{
+				const DrawInstancedCommand* cmd = (const DrawInstancedCommand*)payload;
+				draw_instanced(cmd->first_index, cmd->count, cmd->instance_count);
+				break;
+			}
+			case GraphicsCommandType::DrawIndexedInstanced:
+			{
+				const DrawIndexedInstancedCommand* cmd = (const DrawIndexedInstancedCommand*)payload;
+				draw_indexed_instanced(cmd->index_count, cmd->instance_count);
+				break;
+			}
+			case GraphicsCommandType::DrawIndexedBaseVertexInstanced:
+			{
+				const DrawIndexedBaseVertexInstancedCommand* cmd = (const DrawIndexedBaseVertexInstancedCommand*)payload;
+				draw_indexed_base_vertex_instanced(cmd->index_count, cmd->base_index, cmd->base_vertex, cmd->instance_count, cmd->base_instance);
+				break;
+			}
+			case GraphicsCommandType::BindTexture:
+			{
+				const BindTextureCommand* cmd = (const BindTextureCommand*)payload;
+				bind_texture(cmd->texture, cmd->shader_stage, cmd->slot);
+				break;
+			}
+			case GraphicsCommandType::BindSamplerState:
+			{
+				const BindSamplerStateCommand* cmd = (const BindSamplerStateCommand*)payload;
+				bind_sampler_state(cmd->state, cmd->shader_stage, cmd->slot);
+				break;
+			}
+			case GraphicsCommandType::BindRasterizerState:
+			{
+				const BindRasterizerStateCommand* cmd = (const BindRasterizerStateCommand*)payload;
+				bind_rasterizer_state(cmd->state);
+				break;
+			}
+			case GraphicsCommandType::BindDepthStencilState:
+			{
+				const BindDepthStencilStateCommand* cmd = (const BindDepthStencilStateCommand*)payload;
+				bind_depth_stencil_state(cmd->state);
+				break;
+			}
+			case GraphicsCommandType::BindBlendState:
+			{
+				const BindBlendStateCommand* cmd = (const BindBlendStateCommand*)payload;
+				bind_blend_state(cmd->state);
+				break;
+			}
+			case GraphicsCommandType::BindVertexArray:
+			{
+				const BindVertexArrayCommand* cmd = (const BindVertexArrayCommand*)payload;
+				bind_vertex_array(cmd->vertex_array);
+				break;
+			}
+			case GraphicsCommandType::BindFramebuffer:
+			{
+				const BindFramebufferCommand* cmd = (const BindFramebufferCommand*)payload;
+				bind_framebuffer(cmd->framebuffer);
+				break;
+			}
+			case GraphicsCommandType::BindUniformBuffer:
+			{
+				const BindUniformBufferCommand* cmd = (const BindUniformBufferCommand*)payload;
+				bind_uniform_buffer(cmd->buffer, cmd->shader_stage, cmd->slot);
+				break;
+			}
+			case GraphicsCommandType::BindUniformBufferRange:
+			{
+				const BindUniformBufferRangeCommand* cmd = (const BindUniformBufferRangeCommand*)payload;
+				bind_uniform_buffer_range(cmd->buffer, cmd->shader_stage, cmd->slot, cmd->offset, cmd->size);
+				break;
+			}
+			case GraphicsCommandType::CopyUniformData:
+			{
+				const CopyUniformDataCommand* cmd = (const CopyUniformDataCommand*)payload;
+				copy_uniform_data(cmd->buffer, (void*)(cmd + 1), cmd->offset, cmd->size);
+				break;
+			}
+			case GraphicsCommandType::BindShaderProgram:
+			{
+				const BindShaderProgramCommand* cmd = (const BindShaderProgramCommand*)payload;
+				bind_shader_program(cmd->program);
+				break;
+			}
+			case GraphicsCommandType::BindPipelineState:
+			{
+				const BindPipelineStateCommand* cmd = (const BindPipelineStateCommand*)payload;
+				bind_pipeline_state_object(cmd->pso);
+				break;
+			}
+			case GraphicsCommandType::SetViewport:
+			{
+				const SetViewportCommand* cmd = (const SetViewportCommand*)payload;
+				set_viewport(cmd->width, cmd->height, cmd->top_left_x, cmd->top_left_y);
+				break;
+			}
+			case GraphicsCommandType::ClearFramebuffer:
+			{
+				const ClearFramebufferCommand* cmd = (const ClearFramebufferCommand*)payload;
+				clear_framebuffer(cmd->clear_target, (float*)&cmd->clear_color[0]);
+				break;
+			}
+			default:
+				// The packet size can't be trusted either, so drop the rest of the buffer.
+				LOG_ERROR("Unknown command type " + std::to_string(header->type) + " in command buffer");
+				return;
+		}
+
+		ptr += header->size;
+	}
 }
@@ -6,14 +6,35 @@
 #include <string>
 #include "gfx_types.h"
 
+class CommandBuffer;
+
 class RenderDevice
 {
 public:
     RenderDevice();
     ~RenderDevice();
-	bool init();
+	// Loads GL through the platform's default loader, or through loader when the context was
+	// created by an API glad does not know about, e.g. EGL.
+	bool init(GLADloadproc loader = nullptr);
+
+	// Only has an effect in GFX_ERROR_CHECK_ASYNC builds. Synchronous output makes the reported
+	// call site exact at the cost of serializing the driver.
+	void set_debug_output(bool enabled, bool synchronous);
+
 	Shader* create_shader(const char* source, uint32_t type);
 	ShaderProgram* create_shader_program(Shader** shaders, uint32_t count);
+	// Async variants issue the compile and link without waiting on the driver and return a program
+	// in the ProgramStatus::PENDING state. Status is only queried once the program is polled or
+	// first bound. While pending, binds fall back to the placeholder program if one is set,
+	// otherwise the first bind blocks until the link is done. The placeholder must use the same
+	// bindings as the programs it stands in for.
+	Shader* create_shader_async(const char* source, uint32_t type);
+	ShaderProgram* create_shader_program_async(Shader** shaders, uint32_t count);
+	uint32_t shader_program_status(ShaderProgram* program);
+	void set_placeholder_program(ShaderProgram* program);
+	// Enables the on-disk program binary cache. The directory must already exist. While enabled,
+	// shader compilation is deferred to create_shader_program and skipped on a cache hit.
+	void set_program_cache_directory(const char* path);
 	Framebuffer*	 create_framebuffer(const FramebufferCreateDesc& desc);
 	void attach_render_target(Framebuffer* framebuffer, Texture* render_target);
 	void attach_depth_stencil_target(Framebuffer* framebuffer, Texture* render_target);
@@ -21,13 +42,31 @@ public:
 	VertexBuffer* create_vertex_buffer(const BufferCreateDesc& desc);
 	IndexBuffer* create_index_buffer(const BufferCreateDesc& desc);
 	VertexArray* create_vertex_array(const VertexArrayCreateDesc& desc);
+	// Textures use immutable storage with mipmap_levels levels, or a full chain if it is 0 and
+	// generate_mipmaps is set. Block compressed formats are only supported for 2D, array and cube
+	// textures, and their mips have to be uploaded separately.
+	Texture1D* create_texture_1d(const Texture1DCreateDesc& desc);
 	Texture2D* create_texture_2d(const Texture2DCreateDesc& desc);
+	Texture2DArray* create_texture_2d_array(const Texture2DArrayCreateDesc& desc);
+	Texture3D* create_texture_3d(const Texture3DCreateDesc& desc);
+	TextureCube* create_texture_cube(const TextureCubeCreateDesc& desc);
 	UniformBuffer* create_uniform_buffer(const BufferCreateDesc& desc);
+	StorageBuffer* create_storage_buffer(const BufferCreateDesc& desc);
+	// Requires GL 4.4, returns nullptr on older contexts.
+	UniformRingBuffer* create_uniform_ring_buffer(const UniformRingBufferCreateDesc& desc);
+	// Returns nullptr if draw_data_stride is set but gl_DrawID is unavailable.
+	DrawBatch* create_draw_batch(const DrawBatchCreateDesc& desc);
+	// Requires GL 4.4, returns nullptr on older contexts.
+	StagingBuffer* create_staging_buffer(size_t size);
+	// Identical descriptions return the same reference counted PSO, each call needs its own destroy.
 	PipelineStateObject* create_pipeline_state_object(const PipelineStateObjectCreateDesc& desc);
 	RasterizerState* create_rasterizer_state(const RasterizerStateCreateDesc& desc);
+	// Equivalent descriptions return the same reference counted sampler, each call needs its own destroy.
 	SamplerState* create_sampler_state(const SamplerStateCreateDesc& desc);
 	DepthStencilState* create_depth_stencil_state(const DepthStencilStateCreateDesc& desc);
+	BlendState* create_blend_state(const BlendStateCreateDesc& desc);
 	int UniformBufferAlignment();
+	int StorageBufferAlignment();
 
 	void destroy_shader(Shader* shader);
 	void destroy_shader_program(ShaderProgram* program);
@@ -35,12 +74,18 @@ public:
 	void destroy_index_buffer(IndexBuffer* index_buffer);
 	void destroy_vertex_array(VertexArray* vertex_array);
 	void destroy_uniform_buffer(UniformBuffer* buffer);
+	void destroy_uniform_ring_buffer(UniformRingBuffer* buffer);
+	void destroy_storage_buffer(StorageBuffer* buffer);
 	void destroy_texture(Texture* texture);
-	void destroy_framebuffer(Framebuffer* framebuffer);
+	// Attached textures are destroyed along with the framebuffer unless destroy_attachments is false.
+	void destroy_framebuffer(Framebuffer* framebuffer, bool destroy_attachments = true);
 	void destroy_rasterizer_state(RasterizerState* state);
 	void destroy_sampler_state(SamplerState* state);
 	void destroy_depth_stencil_state(DepthStencilState* state);
+	void destroy_blend_state(BlendState* state);
     void destroy_pipeline_state_object(PipelineStateObject* pso);
+	void destroy_draw_batch(DrawBatch* batch);
+	void destroy_staging_buffer(StagingBuffer* buffer);
 
 	void  bind_pipeline_state_object(PipelineStateObject* pso);
 	void  bind_texture(Texture* texture, uint32_t shader_stage, uint32_t buffer_slot);
@@ -49,20 +94,152 @@ public:
 	void  bind_vertex_array(VertexArray* vertex_array);
 	void  bind_uniform_buffer(UniformBuffer* uniform_buffer, uint32_t shader_stage, uint32_t buffer_slot);
     void  bind_uniform_buffer_range(UniformBuffer* uniform_buffer, uint32_t shader_stage, uint32_t buffer_slot, size_t offset, size_t size);
+	// Any buffer can be bound as a shader storage buffer, e.g. a vertex buffer written by a compute
+	// shader. Range offsets must be multiples of StorageBufferAlignment().
+	void  bind_storage_buffer(Buffer* buffer, uint32_t shader_stage, uint32_t buffer_slot);
+	void  bind_storage_buffer_range(Buffer* buffer, uint32_t shader_stage, uint32_t buffer_slot, size_t offset, size_t size);
+	// Binds one mip of the texture for image load/store in the texture's own format, which has to be
+	// one GL allows for images, so no depth or compressed formats.
+	void  bind_image(Texture* texture, uint32_t shader_stage, uint32_t image_slot, uint32_t mip_level, uint32_t access);
 	void  bind_framebuffer(Framebuffer* framebuffer);
 	void  bind_depth_stencil_state(DepthStencilState* state);
+	// Color write masks also apply to clear_framebuffer, as the depth mask does.
+	void  bind_blend_state(BlendState* state);
 	void  bind_shader_program(ShaderProgram* program);
 	void* map_buffer(Buffer* buffer, uint32_t type);
 	void  unmap_buffer(Buffer* buffer);
+	// Buffers without client storage must have been created from a non-static usage or without data.
+	void  update_buffer(Buffer* buffer, size_t offset, size_t size, const void* data);
+	void  copy_uniform_data(UniformBuffer* buffer, void* data, size_t offset, size_t size);
+
+	// Waits until the GPU has finished reading the oldest region of the ring and makes it current.
+	void  begin_uniform_ring_frame(UniformRingBuffer* buffer);
+	// Fences the current region so it is not overwritten while the GPU may still read from it.
+	void  end_uniform_ring_frame(UniformRingBuffer* buffer);
+	// Thread-safe. Returns a write pointer into the current region and its offset from the start of
+	// the buffer, ready to be passed to bind_uniform_buffer_range. Returns nullptr if the region is full.
+	void* allocate_uniform_data(UniformRingBuffer* buffer, size_t size, size_t* offset);
+
+	// Mip data is expected to be tightly packed. The staging variant sources the data from the
+	// given offset into the buffer instead of client memory.
+	void  update_texture_2d(Texture2D* texture, uint32_t mip_level, const void* data);
+	void  update_texture_2d(Texture2D* texture, uint32_t mip_level, StagingBuffer* buffer, size_t offset);
+	void  update_texture_2d_array(Texture2DArray* texture, uint32_t layer, uint32_t mip_level, const void* data);
+	// GPU side copy of count mips between textures of the same format. Requires GL 4.3.
+	void  copy_texture_mips(Texture2D* dst, uint32_t dst_mip, Texture2D* src, uint32_t src_mip, uint32_t count);
+	bool  texture_copy_supported();
+	// Moves the storage of replacement into texture and destroys the old storage along with the
+	// replacement object. Pointers and handles to texture stay valid.
+	void  replace_texture_storage(Texture2D* texture, Texture2D* replacement);
+
+	// fence_signaled never blocks and releases the sync object once it has been signaled. A fence
+	// that was never inserted counts as signaled.
+	void  insert_fence(Fence& fence);
+	bool  fence_signaled(Fence& fence);
+	void  release_fence(Fence& fence);
+
+	// The query object is created on first use. gpu_timer_result never blocks: it returns false
+	// while the GPU has not finished the timed commands, results are usually available a frame or
+	// two later. Beginning a timer that is still pending discards its previous result.
+	void  begin_gpu_timer(GpuTimer& timer);
+	void  end_gpu_timer(GpuTimer& timer);
+	bool  gpu_timer_result(GpuTimer& timer, double& milliseconds);
+	void  release_gpu_timer(GpuTimer& timer);
 
 	void  set_primitive_type(uint32_t primitive);
 	void  clear_framebuffer(uint32_t clear_target, float* clear_color);
 	void  set_viewport(uint32_t width, uint32_t height, uint32_t top_left_x, uint32_t top_left_y);
+	// Copies the bottom-left src_width x src_height color region of src, scaled, over the bottom-left
+	// dst_width x dst_height region of dst. A null framebuffer is the default framebuffer. Scaling
+	// requires both framebuffers to be single sampled. Leaves the bound framebuffer unchanged.
+	void  blit_framebuffer(Framebuffer* src, uint32_t src_width, uint32_t src_height, Framebuffer* dst, uint32_t dst_width, uint32_t dst_height, bool linear);
 
 	void draw(uint32_t first_index, uint32_t count);
 	void draw_indexed(uint32_t index_count);
 	void draw_indexed_base_vertex(uint32_t index_count, uint32_t base_index, uint32_t base_vertex);
+	void draw_instanced(uint32_t first_index, uint32_t count, uint32_t instance_count);
+	void draw_indexed_instanced(uint32_t index_count, uint32_t instance_count);
+	// base_instance offsets the fetch of per-instance elements, so several instanced draws can
+	// share one instance buffer. Requires GL 4.2.
+	void draw_indexed_base_vertex_instanced(uint32_t index_count, uint32_t base_index, uint32_t base_vertex, uint32_t instance_count, uint32_t base_instance);
+
+	// Draw batches are built on the CPU with add_draw_to_batch and uploaded once with upload_draw_batch.
+	// Static geometry only needs to be uploaded once and can then be drawn every frame.
+	// draw_data points to draw_data_stride bytes and may only be null for batches without draw data.
+	uint32_t add_draw_to_batch(DrawBatch* batch, uint32_t index_count, uint32_t base_index, uint32_t base_vertex, const void* draw_data);
+	void upload_draw_batch(DrawBatch* batch);
+	void reset_draw_batch(DrawBatch* batch);
+	void draw_indexed_batch(DrawBatch* batch, uint32_t draw_data_slot);
+	// Multi-draw of draw_count DrawElementsIndirectCommands read from buffer at offset, e.g. ones
+	// written by a compute shader.
+	void draw_indexed_indirect(Buffer* buffer, size_t offset, uint32_t draw_count);
+	// Same, with the number of draws read from a uint in count_buffer at count_offset and clamped
+	// to max_draw_count, so a compute shader can drop draws entirely. Requires GL 4.6, or
+	// ARB_indirect_parameters when init was given a loader.
+	bool indirect_count_supported();
+	void draw_indexed_indirect_count(Buffer* buffer, size_t offset, Buffer* count_buffer, size_t count_offset, uint32_t max_draw_count);
+
+	// Compute requires GL 4.3. Writes are not visible to later commands until memory_barrier is
+	// called with BarrierType bits for the kind of access that reads them.
+	bool compute_supported();
+	void dispatch(uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z);
+	// Reads the three group counts from buffer at offset.
+	void dispatch_indirect(Buffer* buffer, size_t offset);
+	void memory_barrier(uint32_t barriers);
+
+	// Pre-allocates pool capacity so that resource creation performs no heap allocation afterwards.
+	void reserve_resources(const ResourceReserveDesc& desc);
+
+	// Every resource stores its generational handle in resource_id. Lookups return nullptr once the
+	// resource has been destroyed, even if its slot has been reused since.
+	Shader*            get_shader(ShaderHandle handle);
+	ShaderProgram*     get_shader_program(ShaderProgramHandle handle);
+	VertexBuffer*      get_vertex_buffer(VertexBufferHandle handle);
+	IndexBuffer*       get_index_buffer(IndexBufferHandle handle);
+	UniformBuffer*     get_uniform_buffer(UniformBufferHandle handle);
+	UniformRingBuffer* get_uniform_ring_buffer(UniformRingBufferHandle handle);
+	Texture1D*         get_texture_1d(Texture1DHandle handle);
+	Texture2D*         get_texture_2d(Texture2DHandle handle);
+	Texture2DArray*    get_texture_2d_array(Texture2DArrayHandle handle);
+	Texture3D*         get_texture_3d(Texture3DHandle handle);
+	TextureCube*       get_texture_cube(TextureCubeHandle handle);
+	VertexArray*       get_vertex_array(VertexArrayHandle handle);
+	SamplerState*      get_sampler_state(SamplerStateHandle handle);
+	Framebuffer*       get_framebuffer(FramebufferHandle handle);
+	StorageBuffer*     get_storage_buffer(StorageBufferHandle handle);
+
+	// Resets the per-frame counters returned by frame_stats().
+	void begin_frame();
+	const DeviceFrameStats& frame_stats();
+
+	// Forgets all shadowed GL state. Call after touching GL state outside of the RenderDevice.
+	void invalidate_state_cache();
+
+	// Replays a recorded command buffer. Must be called from the thread that owns the GL context.
+	void submit_command_buffer(CommandBuffer* cmd_buf);
     
+private:
+	void set_active_texture_unit(uint32_t unit);
+	void bind_texture_for_update(Texture* texture);
+	void create_texture_storage(Texture* texture, GLenum target, uint32_t format, GLsizei levels, GLsizei width, GLsizei height, GLsizei depth);
+	void upload_texture_image(Texture* texture, uint32_t mip_level, GLint layer, GLsizei width, GLsizei height, GLsizei depth, const void* data);
+	void generate_texture_mipmaps(Texture* texture);
+	// Apply the fields of the state selected by a mask of PSO_DIFF_* bits.
+	void apply_rasterizer_state(RasterizerState* state, uint32_t fields);
+	void apply_depth_stencil_state(DepthStencilState* state, uint32_t fields);
+	void apply_blend_state(BlendState* state);
+	Shader* allocate_shader(const char* source, uint32_t type);
+	void begin_shader_compile(Shader* shader);
+	bool end_shader_compile(Shader* shader);
+	ShaderProgram* allocate_shader_program(Shader** shaders, uint32_t count);
+	void begin_program_link(ShaderProgram* program, Shader** shaders, uint32_t count);
+	bool finish_shader_program(ShaderProgram* program);
+	void reflect_program_bindings(ShaderProgram* program);
+	bool load_program_binary(ShaderProgram* program, uint64_t key);
+	void store_program_binary(ShaderProgram* program, uint64_t key);
+	void delete_uniform_buffer_object(UniformBuffer* buffer);
+	void forget_buffer_bindings(GLuint id);
+
 private:
     DeviceData m_device_data;
 };
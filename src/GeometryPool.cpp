@@ -0,0 +1,177 @@
+#include "GeometryPool.h"
+#include "RenderDevice.h"
+#include "logger.h"
+
+GeometryPool::GeometryPool() : m_device(nullptr),
+							   m_vertex_buffer(nullptr),
+							   m_index_buffer(nullptr),
+							   m_instance_buffer(nullptr)
+{
+
+}
+
+GeometryPool::~GeometryPool()
+{
+
+}
+
+bool GeometryPool::init(RenderDevice* device, const GeometryPoolDesc& desc)
+{
+	m_device = device;
+	m_instance_buffer = desc.instance_buffer;
+
+	BufferCreateDesc vb_desc = {};
+
+	vb_desc.size = desc.vertex_buffer_size;
+	vb_desc.usage_type = BufferUsageType::DYNAMIC;
+
+	BufferCreateDesc ib_desc = {};
+
+	ib_desc.size = desc.index_buffer_size;
+	ib_desc.usage_type = BufferUsageType::DYNAMIC;
+	ib_desc.data_type = DataType::UINT32;
+
+	m_vertex_buffer = device->create_vertex_buffer(vb_desc);
+	m_index_buffer = device->create_index_buffer(ib_desc);
+
+	if (!m_vertex_buffer || !m_index_buffer)
+	{
+		LOG_ERROR("Failed to create Geometry Pool buffers");
+		shutdown();
+		return false;
+	}
+
+	m_vertex_allocator.init(desc.vertex_buffer_size);
+	m_index_allocator.init(desc.index_buffer_size);
+
+	return true;
+}
+
+void GeometryPool::shutdown()
+{
+	for (size_t i = 0; i < m_allocations.size(); i++)
+		delete m_allocations[i];
+
+	m_allocations.clear();
+
+	for (auto& it : m_vertex_arrays)
+		m_device->destroy_vertex_array(it.second);
+
+	m_vertex_arrays.clear();
+
+	if (m_vertex_buffer)
+	{
+		m_device->destroy_vertex_buffer(m_vertex_buffer);
+		m_vertex_buffer = nullptr;
+	}
+
+	if (m_index_buffer)
+	{
+		m_device->destroy_index_buffer(m_index_buffer);
+		m_index_buffer = nullptr;
+	}
+
+	m_vertex_allocator.init(0);
+	m_index_allocator.init(0);
+}
+
+GeometryAllocation* GeometryPool::allocate(InputLayout* layout, const void* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count)
+{
+	if (vertex_count == 0 || index_count == 0)
+	{
+		LOG_ERROR("Geometry Pool allocations need vertices and indices");
+		return nullptr;
+	}
+
+	uint32_t vertex_size = layout->vertex_size * vertex_count;
+	uint32_t index_size = sizeof(uint32_t) * index_count;
+
+	uint32_t vertex_offset = m_vertex_allocator.allocate(vertex_size, layout->vertex_size);
+
+	if (vertex_offset == RANGE_ALLOCATOR_INVALID_OFFSET)
+	{
+		LOG_ERROR("Geometry Pool vertex buffer is full");
+		return nullptr;
+	}
+
+	uint32_t index_offset = m_index_allocator.allocate(index_size, sizeof(uint32_t));
+
+	if (index_offset == RANGE_ALLOCATOR_INVALID_OFFSET)
+	{
+		LOG_ERROR("Geometry Pool index buffer is full");
+		m_vertex_allocator.free(vertex_offset, vertex_size);
+		return nullptr;
+	}
+
+	VertexArray* layout_vertex_array = vertex_array(layout);
+
+	if (!layout_vertex_array)
+	{
+		LOG_ERROR("Failed to create Geometry Pool vertex array");
+		m_vertex_allocator.free(vertex_offset, vertex_size);
+		m_index_allocator.free(index_offset, index_size);
+		return nullptr;
+	}
+
+	m_device->update_buffer(m_vertex_buffer, vertex_offset, vertex_size, vertices);
+	m_device->update_buffer(m_index_buffer, index_offset, index_size, indices);
+
+	GeometryAllocation* allocation = new GeometryAllocation();
+
+	allocation->vertex_array = layout_vertex_array;
+	allocation->base_vertex = vertex_offset / layout->vertex_size;
+	allocation->vertex_count = vertex_count;
+	allocation->base_index = index_offset / sizeof(uint32_t);
+	allocation->index_count = index_count;
+	allocation->vertex_offset = vertex_offset;
+	allocation->vertex_size = vertex_size;
+	allocation->pool_index = (uint32_t)m_allocations.size();
+
+	m_allocations.push_back(allocation);
+
+	return allocation;
+}
+
+// Freed ranges can be overwritten by the next allocation right away, GL orders the upload after
+// any draw already issued from them.
+void GeometryPool::free(GeometryAllocation* allocation)
+{
+	uint32_t index = allocation->pool_index;
+
+	if (index >= m_allocations.size() || m_allocations[index] != allocation)
+		return;
+
+	m_vertex_allocator.free(allocation->vertex_offset, allocation->vertex_size);
+	m_index_allocator.free(allocation->base_index * sizeof(uint32_t), allocation->index_count * sizeof(uint32_t));
+
+	m_allocations[index] = m_allocations.back();
+	m_allocations[index]->pool_index = index;
+	m_allocations.pop_back();
+
+	delete allocation;
+}
+
+VertexArray* GeometryPool::vertex_array(InputLayout* layout)
+{
+	auto it = m_vertex_arrays.find(layout);
+
+	if (it != m_vertex_arrays.end())
+		return it->second;
+
+	VertexArrayCreateDesc desc;
+
+	desc.vertex_buffer = m_vertex_buffer;
+	desc.index_buffer = m_index_buffer;
+	desc.layout = layout;
+	desc.instance_buffer = layout->instance_size > 0 ? m_instance_buffer : nullptr;
+
+	VertexArray* vertex_array = m_device->create_vertex_array(desc);
+
+	// Failures are not cached, so a later call can try again.
+	if (!vertex_array)
+		return nullptr;
+
+	m_vertex_arrays[layout] = vertex_array;
+
+	return vertex_array;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include "gfx_types.h"
+#include "RangeAllocator.h"
+
+class RenderDevice;
+
+struct GeometryPoolDesc
+{
+    uint32_t      vertex_buffer_size; // Bytes of vertex data shared by all meshes.
+    uint32_t      index_buffer_size;  // Bytes of 32-bit index data shared by all meshes.
+    VertexBuffer* instance_buffer;    // Bound to vertex arrays of layouts with per-instance elements, may be null.
+};
+
+struct GeometryAllocation
+{
+    VertexArray* vertex_array; // Shared by every mesh with the same InputLayout.
+    uint32_t     base_vertex;
+    uint32_t     vertex_count;
+    uint32_t     base_index;
+    uint32_t     index_count;
+    uint32_t     vertex_offset; // Byte range reserved in the vertex buffer.
+    uint32_t     vertex_size;
+    uint32_t     pool_index;    // Position in the pool's list, so free is O(1).
+};
+
+// Packs the geometry of many meshes into one vertex and one index buffer, with a single vertex
+// array per InputLayout on top of them. Meshes are drawn with
+//
+//     device->bind_vertex_array(mesh->vertex_array);
+//     device->draw_indexed_base_vertex(mesh->index_count, mesh->base_index, mesh->base_vertex);
+//
+// or the same offsets passed to add_draw_to_batch, so consecutive meshes of one layout only differ
+// in draw parameters and can be merged into a single multi-draw. Vertex data is aligned to the
+// vertex size of its layout, so any number of layouts can share the vertex buffer.
+class GeometryPool
+{
+public:
+    GeometryPool();
+    ~GeometryPool();
+
+    bool init(RenderDevice* device, const GeometryPoolDesc& desc);
+    void shutdown();
+
+    // Returns nullptr if either buffer has no free range large enough or the layout's vertex array
+    // could not be created.
+    GeometryAllocation* allocate(InputLayout* layout, const void* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count);
+    void free(GeometryAllocation* allocation);
+
+    VertexArray* vertex_array(InputLayout* layout);
+
+    inline uint32_t free_vertex_bytes() const { return m_vertex_allocator.free_size(); }
+    inline uint32_t free_index_bytes() const { return m_index_allocator.free_size(); }
+
+private:
+    RenderDevice*                                   m_device;
+    VertexBuffer*                                   m_vertex_buffer;
+    IndexBuffer*                                    m_index_buffer;
+    VertexBuffer*                                   m_instance_buffer;
+    RangeAllocator                                  m_vertex_allocator;
+    RangeAllocator                                  m_index_allocator;
+    std::unordered_map<InputLayout*, VertexArray*>  m_vertex_arrays;
+    std::vector<GeometryAllocation*>                m_allocations;
+};
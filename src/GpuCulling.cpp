@@ -0,0 +1,498 @@
+#include "GpuCulling.h"
+#include "DepthPyramid.h"
+#include "RenderDevice.h"
+#include "logger.h"
+
+#include <string.h>
+
+#define CULLING_GROUP_SIZE 64
+
+const char* kCullingCS = R"(layout (local_size_x = 64) in;
+
+struct CullBounds
+{
+    vec4 center;  // w holds the draw index.
+    vec4 extents;
+};
+
+struct DrawCommand
+{
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int  base_vertex;
+    uint base_instance;
+};
+
+layout (std430, binding = 0) readonly buffer Bounds
+{
+    CullBounds bounds[];
+};
+
+layout (std430, binding = 1) readonly buffer InstanceData
+{
+    uint instance_data[];
+};
+
+layout (std430, binding = 2) buffer DrawCommands
+{
+    DrawCommand draws[];
+};
+
+layout (std430, binding = 3) writeonly buffer VisibleData
+{
+    uint visible_data[];
+};
+
+layout (std140, binding = 0) uniform CullData
+{
+    vec4  u_Planes[6];
+    mat4  u_OcclusionViewProjection;
+    uint  u_InstanceCount;
+    uint  u_InstanceWords;
+    uvec2 u_OcclusionSize;
+    uint  u_OcclusionLevels; // 0 disables the occlusion test.
+    uint  u_DrawCount;
+};
+
+layout (binding = 0) uniform sampler2D u_DepthPyramid;
+
+// The box is hidden if its nearest depth is behind the farthest depth of the pyramid over its
+// screen rect. The level is picked so the rect spans at most 2x2 texels.
+bool occluded(vec3 center, vec3 extents)
+{
+    vec3 ndc_min = vec3(1.0);
+    vec3 ndc_max = vec3(-1.0);
+
+    for (int i = 0; i < 8; i++)
+    {
+        vec3 corner = center + extents * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = u_OcclusionViewProjection * vec4(corner, 1.0);
+
+        // Crossing the camera plane, the projected rect is unbounded.
+        if (clip.w <= 0.0)
+            return false;
+
+        vec3 ndc = clip.xyz / clip.w;
+        ndc_min = min(ndc_min, ndc);
+        ndc_max = max(ndc_max, ndc);
+    }
+
+    vec2 size = vec2(u_OcclusionSize);
+    vec2 texel_min = clamp(ndc_min.xy * 0.5 + 0.5, 0.0, 1.0) * size;
+    vec2 texel_max = clamp(ndc_max.xy * 0.5 + 0.5, 0.0, 1.0) * size;
+    vec2 extent = texel_max - texel_min;
+
+    int level = int(ceil(log2(max(max(extent.x, extent.y), 1.0))));
+    level = min(level, int(u_OcclusionLevels) - 1);
+
+    // Texel x of a level covers texels x << level and up of level 0, the last one the remainder.
+    ivec2 last = max(ivec2(u_OcclusionSize) >> level, ivec2(1)) - 1;
+    ivec2 first_texel = min(ivec2(texel_min) >> level, last);
+    ivec2 last_texel = min(ivec2(texel_max) >> level, last);
+
+    float farthest = 0.0;
+
+    for (int y = first_texel.y; y <= last_texel.y; y++)
+    {
+        for (int x = first_texel.x; x <= last_texel.x; x++)
+            farthest = max(farthest, texelFetch(u_DepthPyramid, ivec2(x, y), level).r);
+    }
+
+    return ndc_min.z * 0.5 + 0.5 > farthest;
+}
+
+void main()
+{
+    uint instance = gl_GlobalInvocationID.x;
+
+    if (instance >= u_InstanceCount)
+        return;
+
+    vec3 center = bounds[instance].center.xyz;
+    vec3 extents = bounds[instance].extents.xyz;
+
+    for (int i = 0; i < 6; i++)
+    {
+        if (dot(u_Planes[i].xyz, center) + dot(abs(u_Planes[i].xyz), extents) < -u_Planes[i].w)
+            return;
+    }
+
+    if (u_OcclusionLevels > 0u && occluded(center, extents))
+        return;
+
+    uint draw = floatBitsToUint(bounds[instance].center.w);
+    uint slot = atomicAdd(draws[draw].instance_count, 1u);
+    uint dst = (draws[draw].base_instance + slot) * u_InstanceWords;
+    uint src = instance * u_InstanceWords;
+
+    for (uint i = 0; i < u_InstanceWords; i++)
+        visible_data[dst + i] = instance_data[src + i];
+})";
+
+// Runs after the culling shader, one invocation per draw. Draws with visible instances are
+// appended to the compacted commands and counted for the indirect count draw.
+const char* kCompactDrawsCS = R"(layout (local_size_x = 64) in;
+
+struct DrawCommand
+{
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int  base_vertex;
+    uint base_instance;
+};
+
+layout (std430, binding = 2) readonly buffer DrawCommands
+{
+    DrawCommand draws[];
+};
+
+layout (std430, binding = 4) writeonly buffer VisibleDrawCommands
+{
+    DrawCommand visible_draws[];
+};
+
+layout (std430, binding = 5) buffer DrawCount
+{
+    uint draw_count;
+};
+
+// Matches the culling shader, only u_DrawCount is read.
+layout (std140, binding = 0) uniform CullData
+{
+    vec4  u_Planes[6];
+    mat4  u_OcclusionViewProjection;
+    uint  u_InstanceCount;
+    uint  u_InstanceWords;
+    uvec2 u_OcclusionSize;
+    uint  u_OcclusionLevels;
+    uint  u_DrawCount;
+};
+
+void main()
+{
+    uint draw = gl_GlobalInvocationID.x;
+
+    if (draw >= u_DrawCount || draws[draw].instance_count == 0u)
+        return;
+
+    visible_draws[atomicAdd(draw_count, 1u)] = draws[draw];
+})";
+
+// Gribb-Hartmann: the clip space planes are sums of the fourth row with the other rows. Planes
+// are not normalized, the box test only needs the sign.
+static void extract_frustum_planes(const float* m, float planes[6][4])
+{
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			planes[i * 2][j] = m[j * 4 + 3] + m[j * 4 + i];
+			planes[i * 2 + 1][j] = m[j * 4 + 3] - m[j * 4 + i];
+		}
+	}
+}
+
+GpuCulling::GpuCulling() : m_device(nullptr),
+						   m_shader(nullptr),
+						   m_program(nullptr),
+						   m_compact_shader(nullptr),
+						   m_compact_program(nullptr),
+						   m_bounds_buffer(nullptr),
+						   m_instance_data_buffer(nullptr),
+						   m_draw_buffer(nullptr),
+						   m_visible_draw_buffer(nullptr),
+						   m_draw_count_buffer(nullptr),
+						   m_visible_buffer(nullptr),
+						   m_uniform_buffer(nullptr)
+{
+	memset(&m_desc, 0, sizeof(GpuCullingDesc));
+}
+
+GpuCulling::~GpuCulling()
+{
+
+}
+
+bool GpuCulling::init(RenderDevice* device, const GpuCullingDesc& desc)
+{
+	if (desc.instance_size == 0 || desc.instance_size % 4 != 0 || desc.max_instances == 0 || desc.max_draws == 0)
+	{
+		LOG_ERROR("Invalid GPU Culling description");
+		return false;
+	}
+
+	if (!device->compute_supported())
+	{
+		LOG_ERROR("GPU Culling requires compute shaders");
+		return false;
+	}
+
+	m_device = device;
+	m_desc = desc;
+
+	m_shader = device->create_shader(kCullingCS, ShaderType::COMPUTE);
+
+	if (m_shader)
+		m_program = device->create_shader_program(&m_shader, 1);
+
+	bool compact = device->indirect_count_supported();
+
+	if (m_program && compact)
+	{
+		m_compact_shader = device->create_shader(kCompactDrawsCS, ShaderType::COMPUTE);
+
+		if (m_compact_shader)
+			m_compact_program = device->create_shader_program(&m_compact_shader, 1);
+	}
+
+	if (!m_program || (compact && !m_compact_program))
+	{
+		LOG_ERROR("Failed to create GPU Culling program");
+		shutdown();
+		return false;
+	}
+
+	BufferCreateDesc buffer_desc = {};
+
+	buffer_desc.usage_type = BufferUsageType::STREAM;
+
+	buffer_desc.size = sizeof(CullBounds) * desc.max_instances;
+	m_bounds_buffer = device->create_storage_buffer(buffer_desc);
+
+	buffer_desc.size = desc.instance_size * desc.max_instances;
+	m_instance_data_buffer = device->create_storage_buffer(buffer_desc);
+
+	buffer_desc.size = sizeof(DrawElementsIndirectCommand) * desc.max_draws;
+	m_draw_buffer = device->create_storage_buffer(buffer_desc);
+
+	if (compact)
+	{
+		m_visible_draw_buffer = device->create_storage_buffer(buffer_desc);
+
+		buffer_desc.size = sizeof(uint32_t);
+		m_draw_count_buffer = device->create_storage_buffer(buffer_desc);
+	}
+
+	// Only written by the culling shader.
+	buffer_desc.usage_type = BufferUsageType::DYNAMIC;
+	buffer_desc.size = desc.instance_size * desc.max_instances;
+	m_visible_buffer = device->create_vertex_buffer(buffer_desc);
+
+	buffer_desc.usage_type = BufferUsageType::STREAM;
+	buffer_desc.size = sizeof(CullUniforms);
+	m_uniform_buffer = device->create_uniform_buffer(buffer_desc);
+
+	if (!m_bounds_buffer || !m_instance_data_buffer || !m_draw_buffer || !m_visible_buffer || !m_uniform_buffer || (compact && (!m_visible_draw_buffer || !m_draw_count_buffer)))
+	{
+		LOG_ERROR("Failed to create GPU Culling buffers");
+		shutdown();
+		return false;
+	}
+
+	m_draws.reserve(desc.max_draws);
+	m_draw_instances.reserve(desc.max_draws);
+	m_bounds.reserve(desc.max_instances);
+	m_instance_data.reserve(desc.instance_size * desc.max_instances);
+
+	return true;
+}
+
+void GpuCulling::shutdown()
+{
+	if (!m_device)
+		return;
+
+	if (m_program)
+	{
+		m_device->destroy_shader_program(m_program);
+		m_program = nullptr;
+	}
+
+	if (m_shader)
+	{
+		m_device->destroy_shader(m_shader);
+		m_shader = nullptr;
+	}
+
+	if (m_compact_program)
+	{
+		m_device->destroy_shader_program(m_compact_program);
+		m_compact_program = nullptr;
+	}
+
+	if (m_compact_shader)
+	{
+		m_device->destroy_shader(m_compact_shader);
+		m_compact_shader = nullptr;
+	}
+
+	if (m_bounds_buffer)
+	{
+		m_device->destroy_storage_buffer(m_bounds_buffer);
+		m_bounds_buffer = nullptr;
+	}
+
+	if (m_instance_data_buffer)
+	{
+		m_device->destroy_storage_buffer(m_instance_data_buffer);
+		m_instance_data_buffer = nullptr;
+	}
+
+	if (m_draw_buffer)
+	{
+		m_device->destroy_storage_buffer(m_draw_buffer);
+		m_draw_buffer = nullptr;
+	}
+
+	if (m_visible_draw_buffer)
+	{
+		m_device->destroy_storage_buffer(m_visible_draw_buffer);
+		m_visible_draw_buffer = nullptr;
+	}
+
+	if (m_draw_count_buffer)
+	{
+		m_device->destroy_storage_buffer(m_draw_count_buffer);
+		m_draw_count_buffer = nullptr;
+	}
+
+	if (m_visible_buffer)
+	{
+		m_device->destroy_vertex_buffer(m_visible_buffer);
+		m_visible_buffer = nullptr;
+	}
+
+	if (m_uniform_buffer)
+	{
+		m_device->destroy_uniform_buffer(m_uniform_buffer);
+		m_uniform_buffer = nullptr;
+	}
+
+	m_draws.clear();
+	m_draw_instances.clear();
+	m_bounds.clear();
+	m_instance_data.clear();
+}
+
+void GpuCulling::begin_frame()
+{
+	m_draws.clear();
+	m_draw_instances.clear();
+	m_bounds.clear();
+	m_instance_data.clear();
+}
+
+uint32_t GpuCulling::add_draw(uint32_t index_count, uint32_t base_index, uint32_t base_vertex)
+{
+	if (m_draws.size() == m_desc.max_draws)
+		return GL_INVALID_INDEX;
+
+	DrawElementsIndirectCommand cmd;
+
+	cmd.index_count = index_count;
+	cmd.instance_count = 0;
+	cmd.first_index = base_index;
+	cmd.base_vertex = (int32_t)base_vertex;
+	cmd.base_instance = 0;
+
+	m_draws.push_back(cmd);
+	m_draw_instances.push_back(0);
+
+	return (uint32_t)m_draws.size() - 1;
+}
+
+bool GpuCulling::add_instance(uint32_t draw, const CullBounds& bounds, const void* instance_data)
+{
+	if (m_bounds.size() == m_desc.max_instances || draw >= m_draws.size())
+		return false;
+
+	m_bounds.push_back(bounds);
+	m_bounds.back().draw = draw;
+	m_draw_instances[draw]++;
+
+	const uint8_t* data = (const uint8_t*)instance_data;
+	m_instance_data.insert(m_instance_data.end(), data, data + m_desc.instance_size);
+
+	return true;
+}
+
+void GpuCulling::cull(const float* view_projection, DepthPyramid* occlusion)
+{
+	if (m_bounds.empty())
+		return;
+
+	// Every draw gets room for all of its instances, the shader counts the visible ones.
+	uint32_t base_instance = 0;
+
+	for (size_t i = 0; i < m_draws.size(); i++)
+	{
+		m_draws[i].base_instance = base_instance;
+		base_instance += m_draw_instances[i];
+	}
+
+	CullUniforms uniforms;
+	memset(&uniforms, 0, sizeof(CullUniforms));
+
+	extract_frustum_planes(view_projection, uniforms.planes);
+	uniforms.instance_count = (uint32_t)m_bounds.size();
+	uniforms.instance_words = m_desc.instance_size / 4;
+	uniforms.draw_count = (uint32_t)m_draws.size();
+
+	if (occlusion && occlusion->valid())
+	{
+		memcpy(&uniforms.occlusion_view_projection[0], occlusion->view_projection(), sizeof(uniforms.occlusion_view_projection));
+		uniforms.occlusion_levels = occlusion->levels();
+		uniforms.occlusion_size[0] = occlusion->width();
+		uniforms.occlusion_size[1] = occlusion->height();
+
+		m_device->bind_texture(occlusion->texture(), ShaderType::COMPUTE, 0);
+	}
+
+	m_device->update_buffer(m_bounds_buffer, 0, sizeof(CullBounds) * m_bounds.size(), m_bounds.data());
+	m_device->update_buffer(m_instance_data_buffer, 0, m_instance_data.size(), m_instance_data.data());
+	m_device->update_buffer(m_draw_buffer, 0, sizeof(DrawElementsIndirectCommand) * m_draws.size(), m_draws.data());
+	m_device->update_buffer(m_uniform_buffer, 0, sizeof(CullUniforms), &uniforms);
+
+	if (m_compact_program)
+	{
+		uint32_t draw_count = 0;
+		m_device->update_buffer(m_draw_count_buffer, 0, sizeof(uint32_t), &draw_count);
+	}
+
+	m_device->bind_shader_program(m_program);
+	m_device->bind_uniform_buffer(m_uniform_buffer, ShaderType::COMPUTE, 0);
+	m_device->bind_storage_buffer(m_bounds_buffer, ShaderType::COMPUTE, 0);
+	m_device->bind_storage_buffer(m_instance_data_buffer, ShaderType::COMPUTE, 1);
+	m_device->bind_storage_buffer(m_draw_buffer, ShaderType::COMPUTE, 2);
+	m_device->bind_storage_buffer(m_visible_buffer, ShaderType::COMPUTE, 3);
+
+	m_device->dispatch((uniforms.instance_count + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+
+	if (m_compact_program)
+	{
+		// The instance counts have to be final before the draws with none are dropped.
+		m_device->memory_barrier(BarrierType::SHADER_STORAGE);
+
+		m_device->bind_shader_program(m_compact_program);
+		m_device->bind_storage_buffer(m_visible_draw_buffer, ShaderType::COMPUTE, 4);
+		m_device->bind_storage_buffer(m_draw_count_buffer, ShaderType::COMPUTE, 5);
+
+		m_device->dispatch((uniforms.draw_count + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+	}
+
+	// The draw arguments are read as indirect commands and the visible data as instance attributes.
+	m_device->memory_barrier(BarrierType::COMMAND | BarrierType::VERTEX_ATTRIB);
+}
+
+void GpuCulling::draw()
+{
+	if (m_bounds.empty())
+		return;
+
+	if (m_compact_program)
+		m_device->draw_indexed_indirect_count(m_visible_draw_buffer, 0, m_draw_count_buffer, 0, (uint32_t)m_draws.size());
+	else
+		m_device->draw_indexed_indirect(m_draw_buffer, 0, (uint32_t)m_draws.size());
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "gfx_types.h"
+
+class RenderDevice;
+class DepthPyramid;
+
+struct GpuCullingDesc
+{
+    uint32_t instance_size; // Bytes of per-instance data, a multiple of 4. The instance_size of the input layouts used.
+    uint32_t max_instances; // Per frame.
+    uint32_t max_draws;     // Per frame.
+};
+
+// World space axis aligned box. Matches the layout read by the culling shader.
+struct CullBounds
+{
+    float    center[3];
+    uint32_t draw; // Set by add_instance.
+    float    extents[3];
+    float    padding;
+};
+
+// Frustum and occlusion culls instances on the GPU and compacts the visible ones into indirect
+// draw arguments, so visibility costs the CPU nothing beyond uploading the bounds.
+//
+// Every draw is one mesh, usually a GeometryAllocation, and every instance belongs to one draw.
+// A compute shader tests the bounds of each instance and appends the data of the visible ones
+// to its draw's range of instance_buffer(), counting them in the draw's instance_count. All
+// draws are then issued with a single multi-draw indirect, so they have to share the program,
+// PSO and vertex array. The vertex array must have instance_buffer() bound for its per-instance
+// elements, see GeometryPoolDesc. Instances within a draw end up in no particular order.
+//
+// Where the device supports indirect count draws, a second pass compacts the draws with visible
+// instances into a separate argument buffer and counts them, so culled draws cost no commands.
+// Otherwise every draw is issued and the culled ones have zero instances.
+class GpuCulling
+{
+public:
+    GpuCulling();
+    ~GpuCulling();
+
+    bool init(RenderDevice* device, const GpuCullingDesc& desc);
+    void shutdown();
+
+    // Discards the draws and instances of the previous frame.
+    void begin_frame();
+    // Returns GL_INVALID_INDEX if the frame is out of draws.
+    uint32_t add_draw(uint32_t index_count, uint32_t base_index, uint32_t base_vertex);
+    // Returns false if the frame is out of instances.
+    bool add_instance(uint32_t draw, const CullBounds& bounds, const void* instance_data);
+    // Uploads this frame's draws and instances and runs the culling shader against the frustum of
+    // the column-major view_projection matrix. Leaves a culling program bound. Can be called
+    // again for another view once the previous results have been drawn.
+    //
+    // Instances are also tested against occlusion if it is given and valid, usually the pyramid
+    // of the previous frame. Objects that were hidden last frame and come into view appear a
+    // frame late.
+    void cull(const float* view_projection, DepthPyramid* occlusion = nullptr);
+    // Issues every draw. The caller binds the program, PSO and vertex array beforehand.
+    void draw();
+
+    inline VertexBuffer* instance_buffer() const { return m_visible_buffer; }
+    // One command per draw, in add_draw order, including the culled ones.
+    inline StorageBuffer* draw_argument_buffer() const { return m_draw_buffer; }
+    inline uint32_t num_draws() const { return (uint32_t)m_draws.size(); }
+    inline uint32_t num_instances() const { return (uint32_t)m_bounds.size(); }
+
+private:
+    // Matches the uniform block of the culling shader.
+    struct CullUniforms
+    {
+        float    planes[6][4];
+        float    occlusion_view_projection[16];
+        uint32_t instance_count;
+        uint32_t instance_words;
+        uint32_t occlusion_size[2];
+        uint32_t occlusion_levels;
+        uint32_t draw_count;
+        uint32_t padding[2];
+    };
+
+private:
+    RenderDevice*                            m_device;
+    GpuCullingDesc                           m_desc;
+    Shader*                                  m_shader;
+    ShaderProgram*                           m_program;
+    Shader*                                  m_compact_shader;  // Null without indirect count support.
+    ShaderProgram*                           m_compact_program;
+    StorageBuffer*                           m_bounds_buffer;
+    StorageBuffer*                           m_instance_data_buffer;
+    StorageBuffer*                           m_draw_buffer;
+    StorageBuffer*                           m_visible_draw_buffer; // Compacted commands of the draws with visible instances.
+    StorageBuffer*                           m_draw_count_buffer;
+    VertexBuffer*                            m_visible_buffer;
+    UniformBuffer*                           m_uniform_buffer;
+    std::vector<DrawElementsIndirectCommand> m_draws;          // instance_count is always 0, the shader fills it in.
+    std::vector<uint32_t>                    m_draw_instances; // Instances added to each draw.
+    std::vector<CullBounds>                  m_bounds;
+    std::vector<uint8_t>                     m_instance_data;
+};
@@ -0,0 +1,158 @@
+#include "HeadlessContext.h"
+#include "logger.h"
+
+#include <EGL/eglext.h>
+#include <string.h>
+
+static bool has_extension(const char* extensions, const char* name)
+{
+	if (!extensions)
+		return false;
+
+	size_t length = strlen(name);
+	const char* start = extensions;
+
+	while ((start = strstr(start, name)) != nullptr)
+	{
+		if ((start == extensions || start[-1] == ' ') && (start[length] == ' ' || start[length] == '\0'))
+			return true;
+
+		start += length;
+	}
+
+	return false;
+}
+
+HeadlessContext::HeadlessContext() : m_display(EGL_NO_DISPLAY),
+									 m_surface(EGL_NO_SURFACE),
+									 m_context(EGL_NO_CONTEXT)
+{
+
+}
+
+HeadlessContext::~HeadlessContext()
+{
+
+}
+
+bool HeadlessContext::init(int major_version, int minor_version)
+{
+	// Client extensions are queried without a display. The surfaceless platform needs neither X11
+	// nor a DRM device, otherwise fall back to whatever the default display is.
+	const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+	if (has_extension(client_extensions, "EGL_MESA_platform_surfaceless") && has_extension(client_extensions, "EGL_EXT_platform_base"))
+	{
+		PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+		if (get_platform_display)
+			m_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	}
+
+	if (m_display == EGL_NO_DISPLAY)
+		m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	if (m_display == EGL_NO_DISPLAY || !eglInitialize(m_display, nullptr, nullptr))
+	{
+		LOG_ERROR("Failed to initialize EGL display");
+		m_display = EGL_NO_DISPLAY;
+		return false;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		LOG_ERROR("EGL display does not support desktop OpenGL");
+		shutdown();
+		return false;
+	}
+
+	bool surfaceless = has_extension(eglQueryString(m_display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+	EGLint config_attribs[] =
+	{
+		EGL_SURFACE_TYPE,    surfaceless ? 0 : EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+
+	EGLConfig config;
+	EGLint num_configs = 0;
+
+	if (!eglChooseConfig(m_display, config_attribs, &config, 1, &num_configs) || num_configs == 0)
+	{
+		LOG_ERROR("No suitable EGL config");
+		shutdown();
+		return false;
+	}
+
+	EGLint context_attribs[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION,       major_version,
+		EGL_CONTEXT_MINOR_VERSION,       minor_version,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#if defined(GFX_ERROR_CHECK_ASYNC)
+		EGL_CONTEXT_OPENGL_DEBUG,        EGL_TRUE,
+#endif
+		EGL_NONE
+	};
+
+	m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT, context_attribs);
+
+	if (m_context == EGL_NO_CONTEXT)
+	{
+		LOG_ERROR("Failed to create OpenGL " + std::to_string(major_version) + "." + std::to_string(minor_version) + " core context");
+		shutdown();
+		return false;
+	}
+
+	// Without surfaceless contexts a tiny pbuffer is made current, it is never rendered to.
+	if (!surfaceless)
+	{
+		EGLint pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		m_surface = eglCreatePbufferSurface(m_display, config, pbuffer_attribs);
+
+		if (m_surface == EGL_NO_SURFACE)
+		{
+			LOG_ERROR("Failed to create EGL pbuffer");
+			shutdown();
+			return false;
+		}
+	}
+
+	if (!eglMakeCurrent(m_display, m_surface, m_surface, m_context))
+	{
+		LOG_ERROR("Failed to make EGL context current");
+		shutdown();
+		return false;
+	}
+
+	return true;
+}
+
+void HeadlessContext::shutdown()
+{
+	if (m_display == EGL_NO_DISPLAY)
+		return;
+
+	eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+	if (m_context != EGL_NO_CONTEXT)
+	{
+		eglDestroyContext(m_display, m_context);
+		m_context = EGL_NO_CONTEXT;
+	}
+
+	if (m_surface != EGL_NO_SURFACE)
+	{
+		eglDestroySurface(m_display, m_surface);
+		m_surface = EGL_NO_SURFACE;
+	}
+
+	eglTerminate(m_display);
+	m_display = EGL_NO_DISPLAY;
+}
+
+void* HeadlessContext::get_proc_address(const char* name)
+{
+	return (void*)eglGetProcAddress(name);
+}
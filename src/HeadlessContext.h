@@ -0,0 +1,25 @@
+#pragma once
+
+#include <EGL/egl.h>
+
+// Core profile OpenGL context without a window or display server, created through EGL. Uses the
+// Mesa surfaceless platform when available, so it also runs with software drivers like llvmpipe
+// on machines without a GPU. Rendering has to target a Framebuffer since there is no default
+// framebuffer to draw to.
+class HeadlessContext
+{
+public:
+    HeadlessContext();
+    ~HeadlessContext();
+
+    bool init(int major_version, int minor_version);
+    void shutdown();
+
+    // Pass to RenderDevice::init.
+    static void* get_proc_address(const char* name);
+
+private:
+    EGLDisplay m_display;
+    EGLSurface m_surface;
+    EGLContext m_context;
+};
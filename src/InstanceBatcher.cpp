@@ -0,0 +1,179 @@
+#include "InstanceBatcher.h"
+#include "RenderDevice.h"
+#include "logger.h"
+#include "utility.h"
+
+size_t InstanceBatcher::GroupKeyHash::operator()(const GroupKey& key) const
+{
+	return (size_t)Utility::hash_fnv1a(&key, sizeof(GroupKey));
+}
+
+InstanceBatcher::InstanceBatcher() : m_device(nullptr),
+									 m_instance_buffer(nullptr),
+									 m_region(0)
+{
+	memset(&m_desc, 0, sizeof(InstanceBatcherDesc));
+}
+
+InstanceBatcher::~InstanceBatcher()
+{
+
+}
+
+bool InstanceBatcher::init(RenderDevice* device, const InstanceBatcherDesc& desc)
+{
+	if (desc.instance_size == 0 || desc.max_instances == 0 || desc.num_frames == 0)
+	{
+		LOG_ERROR("Invalid Instance Batcher description");
+		return false;
+	}
+
+	m_device = device;
+	m_desc = desc;
+	m_region = 0;
+
+	BufferCreateDesc buffer_desc = {};
+
+	buffer_desc.size = desc.instance_size * desc.max_instances * desc.num_frames;
+	buffer_desc.usage_type = BufferUsageType::STREAM;
+
+	m_instance_buffer = device->create_vertex_buffer(buffer_desc);
+
+	if (!m_instance_buffer)
+	{
+		LOG_ERROR("Failed to create instance buffer");
+		return false;
+	}
+
+	m_instance_groups.reserve(desc.max_instances);
+	m_instance_data.reserve(desc.instance_size * desc.max_instances);
+	m_upload.resize(desc.instance_size * desc.max_instances);
+
+	return true;
+}
+
+void InstanceBatcher::shutdown()
+{
+	if (m_instance_buffer)
+	{
+		m_device->destroy_vertex_buffer(m_instance_buffer);
+		m_instance_buffer = nullptr;
+	}
+
+	m_groups.clear();
+	m_group_map.clear();
+	m_instance_groups.clear();
+	m_instance_data.clear();
+	m_upload.clear();
+}
+
+void InstanceBatcher::begin_frame()
+{
+	m_region = (m_region + 1) % m_desc.num_frames;
+
+	m_groups.clear();
+	m_group_map.clear();
+	m_instance_groups.clear();
+	m_instance_data.clear();
+}
+
+bool InstanceBatcher::add(const RenderQueueDraw& draw, const void* instance_data, float depth)
+{
+	if (m_instance_groups.size() == m_desc.max_instances)
+		return false;
+
+	GroupKey key;
+	memset(&key, 0, sizeof(GroupKey));
+
+	key.program = draw.program;
+	key.vertex_array = draw.vertex_array;
+	key.pso = draw.pso;
+	key.num_textures = draw.num_textures;
+	key.uniform_buffer = draw.uniform_buffer;
+	key.uniform_slot = draw.uniform_slot;
+	key.uniform_offset = draw.uniform_offset;
+	key.uniform_size = draw.uniform_size;
+	key.index_count = draw.index_count;
+	key.base_index = draw.base_index;
+	key.base_vertex = draw.base_vertex;
+	key.material_id = draw.material_id;
+
+	for (uint32_t i = 0; i < draw.num_textures && i < MAX_DRAW_TEXTURES; i++)
+	{
+		key.textures[i] = draw.textures[i];
+		key.samplers[i] = draw.samplers[i];
+	}
+
+	auto it = m_group_map.find(key);
+	uint32_t group_index;
+
+	if (it == m_group_map.end())
+	{
+		Group group;
+
+		group.draw = draw;
+		group.depth = depth;
+		group.count = 0;
+		group.first = 0;
+
+		group_index = (uint32_t)m_groups.size();
+		m_groups.push_back(group);
+		m_group_map[key] = group_index;
+	}
+	else
+	{
+		group_index = it->second;
+
+		if (depth < m_groups[group_index].depth)
+			m_groups[group_index].depth = depth;
+	}
+
+	m_groups[group_index].count++;
+	m_instance_groups.push_back(group_index);
+
+	const uint8_t* data = (const uint8_t*)instance_data;
+	m_instance_data.insert(m_instance_data.end(), data, data + m_desc.instance_size);
+
+	return true;
+}
+
+void InstanceBatcher::submit(RenderQueue& queue, uint32_t pass)
+{
+	if (m_instance_groups.empty())
+		return;
+
+	uint32_t first = 0;
+
+	for (size_t i = 0; i < m_groups.size(); i++)
+	{
+		m_groups[i].first = first;
+		first += m_groups[i].count;
+	}
+
+	// Scatter the instances into group order. first is used as the write cursor and restored after.
+	for (size_t i = 0; i < m_instance_groups.size(); i++)
+	{
+		Group& group = m_groups[m_instance_groups[i]];
+
+		memcpy(&m_upload[group.first * m_desc.instance_size], &m_instance_data[i * m_desc.instance_size], m_desc.instance_size);
+		group.first++;
+	}
+
+	uint32_t region_base = m_region * m_desc.max_instances;
+
+	m_device->update_buffer(m_instance_buffer,
+							region_base * m_desc.instance_size,
+							m_instance_groups.size() * m_desc.instance_size,
+							m_upload.data());
+
+	for (size_t i = 0; i < m_groups.size(); i++)
+	{
+		Group& group = m_groups[i];
+
+		group.first -= group.count;
+		group.draw.instance_count = group.count;
+		group.draw.base_instance = region_base + group.first;
+
+		queue.push(group.draw, pass, false, group.depth);
+	}
+}
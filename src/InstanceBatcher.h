@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <unordered_map>
+#include "gfx_types.h"
+#include "RenderQueue.h"
+
+class RenderDevice;
+
+struct InstanceBatcherDesc
+{
+    uint32_t instance_size; // Bytes of per-instance data, the instance_size of the input layouts used.
+    uint32_t max_instances; // Per frame.
+    uint32_t num_frames;    // Frames in flight. Each gets its own region of the instance buffer.
+};
+
+// Merges draws of the same mesh with the same material into instanced draws. Every draw added
+// comes with its per-instance data, e.g. a world matrix, which is packed by group into a shared
+// instance buffer. Each group is then pushed to a RenderQueue as a single draw whose base_instance
+// points at its first instance.
+//
+// Vertex arrays of the added draws must have instance_buffer() bound for their per-instance
+// elements, see VertexArrayCreateDesc and GeometryPoolDesc. Only meant for opaque draws: instances
+// within a group are not depth sorted.
+class InstanceBatcher
+{
+public:
+    InstanceBatcher();
+    ~InstanceBatcher();
+
+    bool init(RenderDevice* device, const InstanceBatcherDesc& desc);
+    void shutdown();
+
+    // Discards the groups of the previous frame and moves on to the next region of the buffer.
+    void begin_frame();
+    // Returns false if the frame is out of instances, the draw then has to be drawn on its own.
+    // The instance_count and base_instance of the draw are ignored.
+    bool add(const RenderQueueDraw& draw, const void* instance_data, float depth);
+    // Uploads this frame's instances and pushes one draw per group. Groups are sorted by their
+    // nearest instance.
+    void submit(RenderQueue& queue, uint32_t pass);
+
+    inline VertexBuffer* instance_buffer() const { return m_instance_buffer; }
+    inline uint32_t num_instances() const { return (uint32_t)m_instance_groups.size(); }
+    inline uint32_t num_groups() const { return (uint32_t)m_groups.size(); }
+
+private:
+    // Everything that has to match for two draws to be merged. Zero filled before use so padding
+    // compares equal.
+    struct GroupKey
+    {
+        ShaderProgram*       program;
+        VertexArray*         vertex_array;
+        PipelineStateObject* pso;
+        Texture*             textures[MAX_DRAW_TEXTURES];
+        SamplerState*        samplers[MAX_DRAW_TEXTURES];
+        uint32_t             num_textures;
+        UniformBuffer*       uniform_buffer;
+        uint32_t             uniform_slot;
+        size_t               uniform_offset;
+        size_t               uniform_size;
+        uint32_t             index_count;
+        uint32_t             base_index;
+        uint32_t             base_vertex;
+        uint16_t             material_id;
+
+        inline bool operator==(const GroupKey& other) const { return memcmp(this, &other, sizeof(GroupKey)) == 0; }
+    };
+
+    struct GroupKeyHash
+    {
+        size_t operator()(const GroupKey& key) const;
+    };
+
+    struct Group
+    {
+        RenderQueueDraw draw;
+        float           depth;
+        uint32_t        count;
+        uint32_t        first;
+    };
+
+private:
+    RenderDevice*                                       m_device;
+    InstanceBatcherDesc                                 m_desc;
+    VertexBuffer*                                       m_instance_buffer;
+    uint32_t                                            m_region;
+    std::vector<Group>                                  m_groups;
+    std::unordered_map<GroupKey, uint32_t, GroupKeyHash> m_group_map;
+    std::vector<uint32_t>                               m_instance_groups; // Group of every instance, in add order.
+    std::vector<uint8_t>                                m_instance_data;   // Instance data in add order.
+    std::vector<uint8_t>                                m_upload;          // Instance data in group order.
+};
@@ -0,0 +1,107 @@
+#include "RangeAllocator.h"
+
+#include <iterator>
+
+RangeAllocator::RangeAllocator() : m_size(0), m_free_size(0)
+{
+
+}
+
+void RangeAllocator::init(uint32_t size)
+{
+	m_size = size;
+	reset();
+}
+
+void RangeAllocator::reset()
+{
+	m_free_by_offset.clear();
+	m_free_by_size.clear();
+	m_free_size = 0;
+
+	if (m_size > 0)
+		insert_free_range(0, m_size);
+}
+
+uint32_t RangeAllocator::allocate(uint32_t size, uint32_t alignment)
+{
+	if (size == 0)
+		return RANGE_ALLOCATOR_INVALID_OFFSET;
+
+	alignment = alignment > 0 ? alignment : 1;
+
+	// The smallest free range that fits usually does, unless its alignment padding pushes the
+	// allocation past its end.
+	for (auto it = m_free_by_size.lower_bound(std::make_pair(size, 0u)); it != m_free_by_size.end(); ++it)
+	{
+		uint32_t range_offset = it->second;
+		uint32_t range_size = it->first;
+		uint64_t aligned = ((uint64_t)range_offset + alignment - 1) / alignment * alignment;
+
+		if (aligned + size > (uint64_t)range_offset + range_size)
+			continue;
+
+		remove_free_range(m_free_by_offset.find(range_offset));
+
+		uint32_t padding = (uint32_t)aligned - range_offset;
+		uint32_t remainder = range_size - padding - size;
+
+		if (padding > 0)
+			insert_free_range(range_offset, padding);
+
+		if (remainder > 0)
+			insert_free_range((uint32_t)aligned + size, remainder);
+
+		return (uint32_t)aligned;
+	}
+
+	return RANGE_ALLOCATOR_INVALID_OFFSET;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size)
+{
+	if (size == 0)
+		return;
+
+	auto next = m_free_by_offset.lower_bound(offset);
+
+	if (next != m_free_by_offset.end() && next->first == offset + size)
+	{
+		size += next->second;
+		auto erase = next++;
+		remove_free_range(erase);
+	}
+
+	if (next != m_free_by_offset.begin())
+	{
+		auto prev = std::prev(next);
+
+		if (prev->first + prev->second == offset)
+		{
+			offset = prev->first;
+			size += prev->second;
+			remove_free_range(prev);
+		}
+	}
+
+	insert_free_range(offset, size);
+}
+
+uint32_t RangeAllocator::largest_free_range() const
+{
+	return m_free_by_size.empty() ? 0 : m_free_by_size.rbegin()->first;
+}
+
+void RangeAllocator::insert_free_range(uint32_t offset, uint32_t size)
+{
+	m_free_by_offset[offset] = size;
+	m_free_by_size.insert(std::make_pair(size, offset));
+	m_free_size += size;
+}
+
+void RangeAllocator::remove_free_range(std::map<uint32_t, uint32_t>::iterator it)
+{
+	m_free_by_size.erase(std::make_pair(it->second, it->first));
+	m_free_size -= it->second;
+	m_free_by_offset.erase(it);
+}
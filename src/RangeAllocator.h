@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <utility>
+
+#define RANGE_ALLOCATOR_INVALID_OFFSET UINT32_MAX
+
+// Sub-allocates ranges out of a fixed size region, e.g. a large GPU buffer. Free ranges are kept
+// both by offset, to coalesce neighbours on free, and by size then offset, for best-fit allocation.
+// Allocation and free are O(log n) in the number of free ranges, except that an allocation whose
+// alignment padding does not fit the best range moves on to the next larger one. The allocator
+// never touches the region itself, so it works for any kind of memory.
+class RangeAllocator
+{
+public:
+    RangeAllocator();
+
+    void init(uint32_t size);
+    void reset();
+
+    // Returns RANGE_ALLOCATOR_INVALID_OFFSET if no free range fits. Alignment does not have to be
+    // a power of two, so vertex data can be aligned to its stride.
+    uint32_t allocate(uint32_t size, uint32_t alignment);
+    void free(uint32_t offset, uint32_t size);
+
+    inline uint32_t size() const { return m_size; }
+    inline uint32_t free_size() const { return m_free_size; }
+    uint32_t largest_free_range() const;
+
+private:
+    void insert_free_range(uint32_t offset, uint32_t size);
+    void remove_free_range(std::map<uint32_t, uint32_t>::iterator it);
+
+private:
+    uint32_t                                m_size;
+    uint32_t                                m_free_size;
+    std::map<uint32_t, uint32_t>            m_free_by_offset; // offset -> size
+    std::set<std::pair<uint32_t, uint32_t>> m_free_by_size;   // (size, offset)
+};
@@ -0,0 +1,514 @@
+#include "RenderGraph.h"
+#include "RenderDevice.h"
+#include "logger.h"
+#include "utility.h"
+
+#include <string.h>
+
+RenderGraphBuilder::RenderGraphBuilder(RenderGraph* graph, uint32_t pass) : m_graph(graph), m_pass(pass)
+{
+
+}
+
+RenderGraphResource RenderGraphBuilder::create_texture(const char* name, const RenderGraphTextureDesc& desc)
+{
+	RenderGraph::VirtualTexture texture = {};
+
+	texture.name = name;
+	texture.desc = desc;
+
+	m_graph->m_textures.push_back(texture);
+
+	return (RenderGraphResource)m_graph->m_textures.size() - 1;
+}
+
+void RenderGraphBuilder::read(RenderGraphResource resource)
+{
+	if (resource >= m_graph->m_textures.size())
+	{
+		LOG_ERROR("Pass " + m_graph->m_passes[m_pass].name + " reads an invalid resource");
+		return;
+	}
+
+	m_graph->m_passes[m_pass].reads.push_back(resource);
+}
+
+void RenderGraphBuilder::write(RenderGraphResource resource)
+{
+	RenderGraph::Pass& pass = m_graph->m_passes[m_pass];
+
+	if (resource >= m_graph->m_textures.size() || pass.color_writes.size() == MAX_RENDER_TARGETS)
+	{
+		LOG_ERROR("Pass " + pass.name + " writes an invalid resource or too many render targets");
+		return;
+	}
+
+	pass.color_writes.push_back(resource);
+	m_graph->m_textures[resource].writers.push_back(m_pass);
+}
+
+void RenderGraphBuilder::write_depth(RenderGraphResource resource)
+{
+	RenderGraph::Pass& pass = m_graph->m_passes[m_pass];
+
+	if (resource >= m_graph->m_textures.size() || pass.depth_write != RENDER_GRAPH_INVALID_RESOURCE)
+	{
+		LOG_ERROR("Pass " + pass.name + " writes an invalid resource or more than one depth target");
+		return;
+	}
+
+	pass.depth_write = resource;
+	m_graph->m_textures[resource].writers.push_back(m_pass);
+}
+
+void RenderGraphBuilder::set_side_effect()
+{
+	m_graph->m_passes[m_pass].side_effect = true;
+}
+
+RenderGraph::RenderGraph() : m_device(nullptr),
+							 m_width(0),
+							 m_height(0),
+							 m_size_changed(false),
+							 m_frame(0),
+							 m_compiled(false),
+							 m_valid(false)
+{
+	memset(&m_stats, 0, sizeof(RenderGraphStats));
+}
+
+RenderGraph::~RenderGraph()
+{
+
+}
+
+void RenderGraph::init(RenderDevice* device)
+{
+	m_device = device;
+}
+
+void RenderGraph::shutdown()
+{
+	reset();
+
+	for (auto& it : m_framebuffer_pool)
+		m_device->destroy_framebuffer(it.second.framebuffer, false);
+
+	m_framebuffer_pool.clear();
+
+	for (size_t i = 0; i < m_texture_pool.size(); i++)
+		m_device->destroy_texture(m_texture_pool[i].texture);
+
+	m_texture_pool.clear();
+}
+
+void RenderGraph::set_reference_size(uint16_t width, uint16_t height)
+{
+	if (width != m_width || height != m_height)
+	{
+		m_width = width;
+		m_height = height;
+		m_size_changed = true;
+	}
+}
+
+void RenderGraph::reset()
+{
+	m_textures.clear();
+	m_passes.clear();
+	m_compiled = false;
+	m_frame++;
+}
+
+RenderGraphResource RenderGraph::import_texture(const char* name, Texture2D* texture)
+{
+	VirtualTexture imported = {};
+
+	imported.name = name;
+	imported.imported = texture;
+	imported.texture = texture;
+
+	m_textures.push_back(imported);
+
+	return (RenderGraphResource)m_textures.size() - 1;
+}
+
+void RenderGraph::add_pass(const char* name, const SetupFunc& setup, const ExecuteFunc& execute)
+{
+	Pass pass;
+
+	pass.name = name;
+	pass.execute = execute;
+	pass.depth_write = RENDER_GRAPH_INVALID_RESOURCE;
+	pass.side_effect = false;
+	pass.culled = false;
+	pass.ref_count = 0;
+	pass.framebuffer = nullptr;
+
+	m_passes.push_back(pass);
+
+	RenderGraphBuilder builder(this, (uint32_t)m_passes.size() - 1);
+	setup(builder);
+}
+
+bool RenderGraph::compile()
+{
+	memset(&m_stats, 0, sizeof(RenderGraphStats));
+
+	cull_passes();
+	compute_lifetimes();
+	m_valid = assign_textures();
+
+	for (size_t i = 0; i < m_passes.size(); i++)
+	{
+		Pass& pass = m_passes[i];
+
+		if (pass.culled)
+			m_stats.culled_passes++;
+		else if (m_valid && (pass.color_writes.size() > 0 || pass.depth_write != RENDER_GRAPH_INVALID_RESOURCE))
+		{
+			pass.framebuffer = acquire_framebuffer(pass);
+			m_valid = m_valid && pass.framebuffer;
+		}
+	}
+
+	release_unused();
+
+	m_stats.passes = (uint32_t)m_passes.size();
+	m_stats.pooled_textures = (uint32_t)m_texture_pool.size();
+	m_compiled = true;
+
+	return m_valid;
+}
+
+bool RenderGraph::execute()
+{
+	if (!m_compiled)
+		compile();
+
+	if (!m_valid)
+	{
+		LOG_ERROR("Render graph failed to compile, skipping execution");
+		return false;
+	}
+
+	for (size_t i = 0; i < m_passes.size(); i++)
+	{
+		Pass& pass = m_passes[i];
+
+		if (pass.culled)
+			continue;
+
+		m_device->bind_framebuffer(pass.framebuffer);
+
+		if (pass.framebuffer)
+		{
+			Texture2D* target = texture(pass.color_writes.size() > 0 ? pass.color_writes[0] : pass.depth_write);
+			m_device->set_viewport(target->width, target->height, 0, 0);
+		}
+		else
+			m_device->set_viewport(m_width, m_height, 0, 0);
+
+		pass.execute(*m_device, *this);
+	}
+
+	return true;
+}
+
+Texture2D* RenderGraph::texture(RenderGraphResource resource)
+{
+	return resource < m_textures.size() ? m_textures[resource].texture : nullptr;
+}
+
+// Reference counting from the outputs backwards: a pass is culled once none of the textures it
+// writes are read by a kept pass, which in turn releases the textures it reads.
+void RenderGraph::cull_passes()
+{
+	std::vector<RenderGraphResource> unreferenced;
+
+	for (size_t i = 0; i < m_textures.size(); i++)
+		m_textures[i].ref_count = m_textures[i].imported ? 1 : 0;
+
+	for (size_t i = 0; i < m_passes.size(); i++)
+	{
+		Pass& pass = m_passes[i];
+
+		pass.culled = false;
+		pass.ref_count = (uint32_t)pass.color_writes.size() + (pass.depth_write != RENDER_GRAPH_INVALID_RESOURCE ? 1 : 0);
+
+		for (size_t j = 0; j < pass.reads.size(); j++)
+			m_textures[pass.reads[j]].ref_count++;
+	}
+
+	auto cull_pass = [&](Pass& pass)
+	{
+		pass.culled = true;
+
+		for (size_t j = 0; j < pass.reads.size(); j++)
+		{
+			if (--m_textures[pass.reads[j]].ref_count == 0)
+				unreferenced.push_back(pass.reads[j]);
+		}
+	};
+
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		if (m_textures[i].ref_count == 0)
+			unreferenced.push_back((RenderGraphResource)i);
+	}
+
+	for (size_t i = 0; i < m_passes.size(); i++)
+	{
+		if (m_passes[i].ref_count == 0 && !m_passes[i].side_effect)
+			cull_pass(m_passes[i]);
+	}
+
+	while (!unreferenced.empty())
+	{
+		VirtualTexture& texture = m_textures[unreferenced.back()];
+		unreferenced.pop_back();
+
+		for (size_t i = 0; i < texture.writers.size(); i++)
+		{
+			Pass& writer = m_passes[texture.writers[i]];
+
+			if (!writer.culled && !writer.side_effect && --writer.ref_count == 0)
+				cull_pass(writer);
+		}
+	}
+}
+
+void RenderGraph::compute_lifetimes()
+{
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		m_textures[i].first_pass = UINT32_MAX;
+		m_textures[i].last_pass = 0;
+	}
+
+	auto use = [&](RenderGraphResource resource, uint32_t pass)
+	{
+		VirtualTexture& texture = m_textures[resource];
+
+		texture.first_pass = pass < texture.first_pass ? pass : texture.first_pass;
+		texture.last_pass = pass > texture.last_pass ? pass : texture.last_pass;
+	};
+
+	for (uint32_t i = 0; i < m_passes.size(); i++)
+	{
+		Pass& pass = m_passes[i];
+
+		if (pass.culled)
+			continue;
+
+		for (size_t j = 0; j < pass.reads.size(); j++)
+			use(pass.reads[j], i);
+
+		for (size_t j = 0; j < pass.color_writes.size(); j++)
+			use(pass.color_writes[j], i);
+
+		if (pass.depth_write != RENDER_GRAPH_INVALID_RESOURCE)
+			use(pass.depth_write, i);
+	}
+}
+
+// Walks the kept passes in order, handing each transient a pooled texture right before its first
+// use and returning it right after its last, so the next transient of the same size and format
+// can take it over.
+bool RenderGraph::assign_textures()
+{
+	bool success = true;
+
+	for (uint32_t i = 0; i < m_passes.size(); i++)
+	{
+		if (m_passes[i].culled)
+			continue;
+
+		for (size_t j = 0; j < m_textures.size(); j++)
+		{
+			VirtualTexture& texture = m_textures[j];
+
+			if (texture.imported || texture.first_pass != i)
+				continue;
+
+			uint16_t width = texture.desc.width;
+			uint16_t height = texture.desc.height;
+
+			if (width == 0)
+			{
+				width = (uint16_t)(m_width * texture.desc.scale + 0.5f);
+				height = (uint16_t)(m_height * texture.desc.scale + 0.5f);
+			}
+
+			texture.texture = acquire_texture(width > 0 ? width : 1, height > 0 ? height : 1, texture.desc.format);
+			m_stats.transient_textures++;
+
+			if (!texture.texture)
+			{
+				LOG_ERROR("Failed to create transient texture " + texture.name);
+				success = false;
+			}
+		}
+
+		for (size_t j = 0; j < m_textures.size(); j++)
+		{
+			VirtualTexture& texture = m_textures[j];
+
+			if (!texture.imported && texture.texture && texture.last_pass == i)
+				release_texture(texture.texture);
+		}
+	}
+
+	for (size_t i = 0; i < m_texture_pool.size(); i++)
+	{
+		if (m_texture_pool[i].last_used_frame == m_frame)
+			m_stats.physical_textures++;
+	}
+
+	return success;
+}
+
+void RenderGraph::release_unused()
+{
+	for (size_t i = m_texture_pool.size(); i > 0; i--)
+	{
+		PooledTexture& pooled = m_texture_pool[i - 1];
+
+		if (pooled.last_used_frame != m_frame && (m_size_changed || m_frame - pooled.last_used_frame > RENDER_GRAPH_MAX_UNUSED_FRAMES))
+			destroy_pooled_texture((uint32_t)i - 1);
+	}
+
+	for (auto it = m_framebuffer_pool.begin(); it != m_framebuffer_pool.end();)
+	{
+		if (m_frame - it->second.last_used_frame > RENDER_GRAPH_MAX_UNUSED_FRAMES)
+		{
+			m_device->destroy_framebuffer(it->second.framebuffer, false);
+			it = m_framebuffer_pool.erase(it);
+		}
+		else
+			++it;
+	}
+
+	m_size_changed = false;
+}
+
+Texture2D* RenderGraph::acquire_texture(uint16_t width, uint16_t height, uint32_t format)
+{
+	for (size_t i = 0; i < m_texture_pool.size(); i++)
+	{
+		PooledTexture& pooled = m_texture_pool[i];
+
+		if (!pooled.in_use && pooled.format == format && pooled.texture->width == width && pooled.texture->height == height)
+		{
+			pooled.in_use = true;
+			pooled.last_used_frame = m_frame;
+
+			return pooled.texture;
+		}
+	}
+
+	Texture2DCreateDesc desc = {};
+
+	desc.width = width;
+	desc.height = height;
+	desc.format = format;
+	desc.create_render_target_view = true;
+	desc.mipmap_levels = 1;
+
+	PooledTexture pooled;
+
+	pooled.texture = m_device->create_texture_2d(desc);
+
+	if (!pooled.texture)
+		return nullptr;
+
+	pooled.format = format;
+	pooled.last_used_frame = m_frame;
+	pooled.in_use = true;
+
+	m_texture_pool.push_back(pooled);
+
+	return pooled.texture;
+}
+
+void RenderGraph::release_texture(Texture2D* texture)
+{
+	for (size_t i = 0; i < m_texture_pool.size(); i++)
+	{
+		if (m_texture_pool[i].texture == texture)
+		{
+			m_texture_pool[i].in_use = false;
+			return;
+		}
+	}
+}
+
+// Framebuffers are keyed by the resource ids of their attachments, which unlike GL names are
+// never reused for a different texture.
+Framebuffer* RenderGraph::acquire_framebuffer(const Pass& pass)
+{
+	uint32_t ids[MAX_RENDER_TARGETS + 1];
+	FramebufferCreateDesc desc = {};
+
+	for (size_t i = 0; i < pass.color_writes.size(); i++)
+	{
+		desc.render_targets[i] = texture(pass.color_writes[i]);
+		ids[i] = desc.render_targets[i]->resource_id;
+	}
+
+	desc.num_render_targets = (uint16_t)pass.color_writes.size();
+	desc.depth_target = pass.depth_write != RENDER_GRAPH_INVALID_RESOURCE ? texture(pass.depth_write) : nullptr;
+	ids[desc.num_render_targets] = desc.depth_target ? desc.depth_target->resource_id : UINT32_MAX;
+
+	uint64_t key = Utility::hash_fnv1a(&ids[0], sizeof(uint32_t) * (desc.num_render_targets + 1));
+	auto it = m_framebuffer_pool.find(key);
+
+	if (it != m_framebuffer_pool.end())
+	{
+		it->second.last_used_frame = m_frame;
+		return it->second.framebuffer;
+	}
+
+	PooledFramebuffer pooled;
+
+	pooled.framebuffer = m_device->create_framebuffer(desc);
+
+	if (!pooled.framebuffer)
+	{
+		LOG_ERROR("Failed to create framebuffer for pass " + pass.name);
+		return nullptr;
+	}
+
+	pooled.last_used_frame = m_frame;
+
+	m_framebuffer_pool[key] = pooled;
+
+	return pooled.framebuffer;
+}
+
+void RenderGraph::destroy_pooled_texture(uint32_t index)
+{
+	Texture2D* texture = m_texture_pool[index].texture;
+
+	for (auto it = m_framebuffer_pool.begin(); it != m_framebuffer_pool.end();)
+	{
+		Framebuffer* framebuffer = it->second.framebuffer;
+		bool attached = framebuffer->depth_target == texture;
+
+		for (int i = 0; i < framebuffer->num_render_targets; i++)
+			attached = attached || framebuffer->render_targets[i] == texture;
+
+		if (attached)
+		{
+			m_device->destroy_framebuffer(framebuffer, false);
+			it = m_framebuffer_pool.erase(it);
+		}
+		else
+			++it;
+	}
+
+	m_device->destroy_texture(texture);
+
+	m_texture_pool[index] = m_texture_pool.back();
+	m_texture_pool.pop_back();
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include "gfx_types.h"
+
+class RenderDevice;
+class RenderGraph;
+
+#define RENDER_GRAPH_INVALID_RESOURCE UINT32_MAX
+// Pooled textures and framebuffers not used by the graph for this many frames are destroyed.
+#define RENDER_GRAPH_MAX_UNUSED_FRAMES 8
+
+typedef uint32_t RenderGraphResource;
+
+struct RenderGraphTextureDesc
+{
+    uint16_t width;  // 0 to size the texture relative to the reference size of the graph.
+    uint16_t height;
+    float    scale;  // Fraction of the reference size, used if width is 0.
+    uint32_t format;
+};
+
+struct RenderGraphStats
+{
+    uint32_t passes;
+    uint32_t culled_passes;
+    uint32_t transient_textures; // Transient textures used by the passes that were kept.
+    uint32_t physical_textures;  // Pooled textures they were aliased onto.
+    uint32_t pooled_textures;    // Pooled textures alive, used or not.
+};
+
+// Declares the resources a pass reads and writes. Only valid inside the setup callback.
+class RenderGraphBuilder
+{
+public:
+    RenderGraphResource create_texture(const char* name, const RenderGraphTextureDesc& desc);
+    void read(RenderGraphResource resource);
+    // Color targets are attached in the order they are written.
+    void write(RenderGraphResource resource);
+    void write_depth(RenderGraphResource resource);
+    // Keeps the pass even if nothing reads its output, e.g. when it draws to the backbuffer.
+    void set_side_effect();
+
+private:
+    friend class RenderGraph;
+
+    RenderGraphBuilder(RenderGraph* graph, uint32_t pass);
+
+    RenderGraph* m_graph;
+    uint32_t     m_pass;
+};
+
+// Frame graph built from scratch every frame: reset(), add_pass() for every pass, compile() and
+// execute(). Compiling culls passes whose output is never consumed, computes the lifetime of every
+// transient texture and aliases transients with disjoint lifetimes onto the same pooled texture if
+// their size and format match. Pooled textures and the framebuffers built from them persist across
+// frames, so a steady-state frame creates no GL objects.
+//
+// Before a pass executes, the graph binds a framebuffer with its written textures attached and sets
+// the viewport to their size. Passes without attachments draw to the default framebuffer. Contents
+// of transient textures are undefined when first written in a frame.
+class RenderGraph
+{
+public:
+    typedef std::function<void(RenderGraphBuilder&)> SetupFunc;
+    typedef std::function<void(RenderDevice&, RenderGraph&)> ExecuteFunc;
+
+    RenderGraph();
+    ~RenderGraph();
+
+    void init(RenderDevice* device);
+    void shutdown();
+
+    // Transient textures sized relative to the reference size follow it. Pooled textures of other
+    // sizes are released as soon as they are no longer used, rather than lingering.
+    void set_reference_size(uint16_t width, uint16_t height);
+
+    void reset();
+    // Imported textures are owned by the caller and are never aliased. Passes writing them are
+    // never culled.
+    RenderGraphResource import_texture(const char* name, Texture2D* texture);
+    void add_pass(const char* name, const SetupFunc& setup, const ExecuteFunc& execute);
+    // Both return false if a transient texture or framebuffer could not be created, in which case
+    // no pass is executed this frame.
+    bool compile();
+    bool execute();
+
+    // Physical texture backing a resource, valid from compile() until the next reset().
+    Texture2D* texture(RenderGraphResource resource);
+    inline const RenderGraphStats& stats() const { return m_stats; }
+
+private:
+    friend class RenderGraphBuilder;
+
+    struct VirtualTexture
+    {
+        std::string            name;
+        RenderGraphTextureDesc desc;
+        Texture2D*             imported;
+        Texture2D*             texture;
+        std::vector<uint32_t>  writers;
+        uint32_t               ref_count;
+        uint32_t               first_pass;
+        uint32_t               last_pass;
+    };
+
+    struct Pass
+    {
+        std::string                      name;
+        ExecuteFunc                      execute;
+        std::vector<RenderGraphResource> reads;
+        std::vector<RenderGraphResource> color_writes;
+        RenderGraphResource              depth_write;
+        bool                             side_effect;
+        bool                             culled;
+        uint32_t                         ref_count;
+        Framebuffer*                     framebuffer;
+    };
+
+    struct PooledTexture
+    {
+        Texture2D* texture;
+        uint32_t   format;
+        uint32_t   last_used_frame;
+        bool       in_use;
+    };
+
+    struct PooledFramebuffer
+    {
+        Framebuffer* framebuffer;
+        uint32_t     last_used_frame;
+    };
+
+    void cull_passes();
+    void compute_lifetimes();
+    bool assign_textures();
+    void release_unused();
+    Texture2D* acquire_texture(uint16_t width, uint16_t height, uint32_t format);
+    void release_texture(Texture2D* texture);
+    Framebuffer* acquire_framebuffer(const Pass& pass);
+    void destroy_pooled_texture(uint32_t index);
+
+private:
+    RenderDevice*                                     m_device;
+    uint16_t                                          m_width;
+    uint16_t                                          m_height;
+    bool                                              m_size_changed;
+    uint32_t                                          m_frame;
+    bool                                              m_compiled;
+    bool                                              m_valid;
+    std::vector<VirtualTexture>                       m_textures;
+    std::vector<Pass>                                 m_passes;
+    std::vector<PooledTexture>                        m_texture_pool;
+    std::unordered_map<uint64_t, PooledFramebuffer>   m_framebuffer_pool;
+    RenderGraphStats                                  m_stats;
+};
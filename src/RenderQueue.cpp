@@ -0,0 +1,235 @@
+#include "RenderQueue.h"
+#include "RenderDevice.h"
+#include "CommandBuffer.h"
+
+#include <string.h>
+
+#define KEY_PASS_SHIFT          60
+#define KEY_TRANSLUCENT_SHIFT   59
+
+#define OPAQUE_PROGRAM_SHIFT    47
+#define OPAQUE_MATERIAL_SHIFT   31
+#define OPAQUE_VAO_SHIFT        19
+#define OPAQUE_DEPTH_BITS       19
+
+#define TRANSLUCENT_BUCKET_SHIFT   56
+#define TRANSLUCENT_UNSORTED_SHIFT 55
+
+#define TRANSLUCENT_DEPTH_SHIFT    31
+#define TRANSLUCENT_DEPTH_BITS     24
+#define TRANSLUCENT_BLEND_SHIFT    23
+#define TRANSLUCENT_PROGRAM_SHIFT  11
+
+#define UNSORTED_BLEND_SHIFT       47
+#define UNSORTED_PROGRAM_SHIFT     35
+#define UNSORTED_MATERIAL_SHIFT    19
+#define UNSORTED_VAO_SHIFT         7
+
+#define KEY_MASK(bits) ((uint64_t(1) << (bits)) - 1)
+
+static inline uint64_t quantize_depth(float depth, uint32_t bits)
+{
+	if (depth < 0.0f)
+		depth = 0.0f;
+	else if (depth > 1.0f)
+		depth = 1.0f;
+
+	return (uint64_t)(depth * (float)KEY_MASK(bits));
+}
+
+RenderQueue::RenderQueue()
+{
+
+}
+
+RenderQueue::~RenderQueue()
+{
+
+}
+
+void RenderQueue::reset()
+{
+	m_draws.clear();
+	m_items.clear();
+}
+
+uint64_t RenderQueue::make_key(const RenderQueueDraw& draw, uint32_t pass, bool translucent, float depth)
+{
+	uint64_t program = draw.program ? draw.program->id : 0;
+	uint64_t vertex_array = draw.vertex_array ? draw.vertex_array->id : 0;
+	uint64_t key = (uint64_t(pass) & KEY_MASK(4)) << KEY_PASS_SHIFT;
+
+	if (translucent)
+	{
+		uint64_t blend = draw.pso ? draw.pso->blend_id : 0;
+
+		key |= uint64_t(1) << KEY_TRANSLUCENT_SHIFT;
+		key |= (uint64_t(draw.translucent_bucket) & KEY_MASK(3)) << TRANSLUCENT_BUCKET_SHIFT;
+
+		if (draw.pso && draw.pso->order_independent_blend)
+		{
+			key |= uint64_t(1) << TRANSLUCENT_UNSORTED_SHIFT;
+			key |= (blend & KEY_MASK(8)) << UNSORTED_BLEND_SHIFT;
+			key |= (program & KEY_MASK(12)) << UNSORTED_PROGRAM_SHIFT;
+			key |= (uint64_t(draw.material_id) & KEY_MASK(16)) << UNSORTED_MATERIAL_SHIFT;
+			key |= (vertex_array & KEY_MASK(12)) << UNSORTED_VAO_SHIFT;
+		}
+		else
+		{
+			uint64_t inverted_depth = KEY_MASK(TRANSLUCENT_DEPTH_BITS) - quantize_depth(depth, TRANSLUCENT_DEPTH_BITS);
+
+			key |= inverted_depth << TRANSLUCENT_DEPTH_SHIFT;
+			key |= (blend & KEY_MASK(8)) << TRANSLUCENT_BLEND_SHIFT;
+			key |= (program & KEY_MASK(12)) << TRANSLUCENT_PROGRAM_SHIFT;
+			key |= uint64_t(draw.material_id) & KEY_MASK(11);
+		}
+	}
+	else
+	{
+		key |= (program & KEY_MASK(12)) << OPAQUE_PROGRAM_SHIFT;
+		key |= (uint64_t(draw.material_id) & KEY_MASK(16)) << OPAQUE_MATERIAL_SHIFT;
+		key |= (vertex_array & KEY_MASK(12)) << OPAQUE_VAO_SHIFT;
+		key |= quantize_depth(depth, OPAQUE_DEPTH_BITS);
+	}
+
+	return key;
+}
+
+void RenderQueue::push(const RenderQueueDraw& draw, uint32_t pass, bool translucent, float depth)
+{
+	RenderQueueItem item;
+
+	item.key = make_key(draw, pass, translucent, depth);
+	item.index = (uint32_t)m_draws.size();
+
+	m_draws.push_back(draw);
+	m_items.push_back(item);
+}
+
+void RenderQueue::sort()
+{
+	size_t count = m_items.size();
+
+	if (count < 2)
+		return;
+
+	m_scratch.resize(count);
+
+	// LSD radix sort, 8 bits per pass. All histograms are built up front in a single sweep so that
+	// passes where every key shares the same byte can be skipped entirely.
+	uint32_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t key = m_items[i].key;
+
+		for (int pass = 0; pass < 8; pass++)
+			histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+	}
+
+	RenderQueueItem* src = m_items.data();
+	RenderQueueItem* dst = m_scratch.data();
+
+	for (int pass = 0; pass < 8; pass++)
+	{
+		uint32_t* histogram = histograms[pass];
+
+		if (histogram[(src[0].key >> (pass * 8)) & 0xFF] == count)
+			continue;
+
+		uint32_t offsets[256];
+		uint32_t sum = 0;
+
+		for (int i = 0; i < 256; i++)
+		{
+			offsets[i] = sum;
+			sum += histogram[i];
+		}
+
+		for (size_t i = 0; i < count; i++)
+			dst[offsets[(src[i].key >> (pass * 8)) & 0xFF]++] = src[i];
+
+		RenderQueueItem* temp = src;
+		src = dst;
+		dst = temp;
+	}
+
+	if (src != m_items.data())
+		m_items.swap(m_scratch);
+}
+
+void RenderQueue::execute(RenderDevice& device)
+{
+	execute_draws(device);
+}
+
+void RenderQueue::execute(CommandBuffer& cmd_buf)
+{
+	execute_draws(cmd_buf);
+}
+
+template <typename T>
+void RenderQueue::execute_draws(T& target)
+{
+	PipelineStateObject* last_pso = nullptr;
+	ShaderProgram*       last_program = nullptr;
+	VertexArray*         last_vertex_array = nullptr;
+	Texture*             last_textures[MAX_DRAW_TEXTURES];
+	SamplerState*        last_samplers[MAX_DRAW_TEXTURES];
+	UniformBuffer*       last_uniform_buffer = nullptr;
+	size_t               last_uniform_offset = 0;
+
+	memset(last_textures, 0, sizeof(last_textures));
+	memset(last_samplers, 0, sizeof(last_samplers));
+
+	for (size_t i = 0; i < m_items.size(); i++)
+	{
+		const RenderQueueDraw& draw = m_draws[m_items[i].index];
+
+		if (draw.pso && draw.pso != last_pso)
+		{
+			target.bind_pipeline_state_object(draw.pso);
+			last_pso = draw.pso;
+		}
+
+		if (draw.program != last_program)
+		{
+			target.bind_shader_program(draw.program);
+			last_program = draw.program;
+		}
+
+		if (draw.vertex_array != last_vertex_array)
+		{
+			target.bind_vertex_array(draw.vertex_array);
+			last_vertex_array = draw.vertex_array;
+		}
+
+		for (uint32_t slot = 0; slot < draw.num_textures; slot++)
+		{
+			if (draw.samplers[slot] != last_samplers[slot])
+			{
+				target.bind_sampler_state(draw.samplers[slot], ShaderType::FRAGMENT, slot);
+				last_samplers[slot] = draw.samplers[slot];
+			}
+
+			if (draw.textures[slot] != last_textures[slot])
+			{
+				target.bind_texture(draw.textures[slot], ShaderType::FRAGMENT, slot);
+				last_textures[slot] = draw.textures[slot];
+			}
+		}
+
+		if (draw.uniform_buffer && (draw.uniform_buffer != last_uniform_buffer || draw.uniform_offset != last_uniform_offset))
+		{
+			target.bind_uniform_buffer_range(draw.uniform_buffer, ShaderType::VERTEX, draw.uniform_slot, draw.uniform_offset, draw.uniform_size);
+			last_uniform_buffer = draw.uniform_buffer;
+			last_uniform_offset = draw.uniform_offset;
+		}
+
+		if (draw.instance_count > 0)
+			target.draw_indexed_base_vertex_instanced(draw.index_count, draw.base_index, draw.base_vertex, draw.instance_count, draw.base_instance);
+		else
+			target.draw_indexed_base_vertex(draw.index_count, draw.base_index, draw.base_vertex);
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "gfx_types.h"
+
+class RenderDevice;
+class CommandBuffer;
+
+#define MAX_DRAW_TEXTURES 8
+
+// Sort key layout, most significant bit first.
+//
+// Opaque      : | pass : 4 | 0 | program : 12 | material : 16 | vertex array : 12 | depth : 19 |
+// Translucent : | pass : 4 | 1 | bucket : 3 | 0 | inverted depth : 24 | blend : 8 | program : 12 | material : 11 |
+//               | pass : 4 | 1 | bucket : 3 | 1 | blend : 8 | program : 12 | material : 16 | vertex array : 12 | 0 : 7 |
+//
+// Opaque draws are grouped by state first and sorted front-to-back within identical state.
+// Translucent draws always go after the opaque draws of the same pass and form a sub-queue of
+// buckets, e.g. particles and then muzzle flashes, drawn in bucket order. Within a bucket, draws
+// whose PSO blends order independently (additive, min, max) go last and are grouped by blend
+// mode and state, skipping the depth sort entirely. The rest are sorted back-to-front, with
+// identical blend modes adjacent where depths tie.
+
+struct RenderQueueDraw
+{
+    ShaderProgram*       program;
+    VertexArray*         vertex_array;
+    PipelineStateObject* pso;
+    Texture*             textures[MAX_DRAW_TEXTURES];
+    SamplerState*        samplers[MAX_DRAW_TEXTURES];
+    uint32_t             num_textures;
+    UniformBuffer*       uniform_buffer; // Optional per-draw data, bound as a range.
+    uint32_t             uniform_slot;
+    size_t               uniform_offset;
+    size_t               uniform_size;
+    uint32_t             index_count;
+    uint32_t             base_index;
+    uint32_t             base_vertex;
+    uint32_t             instance_count; // 0 for a regular draw.
+    uint32_t             base_instance;
+    uint16_t             material_id;
+    uint8_t              translucent_bucket; // Only used by translucent draws, 0 to 7.
+};
+
+struct RenderQueueItem
+{
+    uint64_t key;
+    uint32_t index;
+};
+
+class RenderQueue
+{
+public:
+    RenderQueue();
+    ~RenderQueue();
+
+    void reset();
+
+    // Depth is the normalized view space depth of the draw in the range [0, 1].
+    void push(const RenderQueueDraw& draw, uint32_t pass, bool translucent, float depth);
+    void sort();
+
+    // Issues the sorted draws, only binding state that differs from the previous draw.
+    void execute(RenderDevice& device);
+    void execute(CommandBuffer& cmd_buf);
+
+    inline uint32_t size() const { return (uint32_t)m_items.size(); }
+
+    static uint64_t make_key(const RenderQueueDraw& draw, uint32_t pass, bool translucent, float depth);
+
+private:
+    template <typename T>
+    void execute_draws(T& target);
+
+private:
+    std::vector<RenderQueueDraw> m_draws;
+    std::vector<RenderQueueItem> m_items;
+    std::vector<RenderQueueItem> m_scratch;
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <new>
+#include <type_traits>
+
+// 32-bit generational handle: the low bits index a slot in a ResourcePool, the high bits hold
+// the generation of that slot at allocation time. A handle becomes stale as soon as its slot
+// is freed, so lookups through a destroyed handle fail instead of aliasing a newer resource.
+
+#define RESOURCE_HANDLE_INDEX_BITS      20
+#define RESOURCE_HANDLE_GENERATION_BITS 12
+#define RESOURCE_HANDLE_INDEX_MASK      ((1u << RESOURCE_HANDLE_INDEX_BITS) - 1)
+#define RESOURCE_HANDLE_GENERATION_MASK ((1u << RESOURCE_HANDLE_GENERATION_BITS) - 1)
+#define INVALID_RESOURCE_HANDLE         0
+
+template <typename T>
+struct ResourceHandle
+{
+    uint32_t value;
+
+    ResourceHandle() : value(INVALID_RESOURCE_HANDLE) {}
+    explicit ResourceHandle(uint32_t v) : value(v) {}
+
+    inline bool valid() const { return value != INVALID_RESOURCE_HANDLE; }
+    inline uint32_t index() const { return value & RESOURCE_HANDLE_INDEX_MASK; }
+    inline uint32_t generation() const { return value >> RESOURCE_HANDLE_INDEX_BITS; }
+    inline bool operator==(const ResourceHandle& other) const { return value == other.value; }
+    inline bool operator!=(const ResourceHandle& other) const { return value != other.value; }
+};
+
+// Fixed-size chunks of densely packed objects. Chunks are never moved or freed while the pool
+// is alive, so pointers handed out remain stable and steady-state allocation performs no heap
+// traffic once enough capacity has been reserved. The pooled type is expected to have a
+// uint32_t resource_id member, which receives the handle of the object.
+template <typename T, uint32_t CHUNK_SIZE = 256>
+class ResourcePool
+{
+public:
+    ResourcePool() : m_live_count(0)
+    {
+
+    }
+
+    ~ResourcePool()
+    {
+        for (uint32_t i = 0; i < m_alive.size(); i++)
+        {
+            if (m_alive[i])
+                slot(i)->~T();
+        }
+
+        for (uint32_t i = 0; i < m_chunks.size(); i++)
+            ::operator delete(m_chunks[i]);
+    }
+
+    ResourcePool(const ResourcePool&) = delete;
+    ResourcePool& operator=(const ResourcePool&) = delete;
+
+    void reserve(uint32_t capacity)
+    {
+        while (m_alive.size() < capacity)
+            grow();
+    }
+
+    T* allocate()
+    {
+        if (m_free_list.empty())
+        {
+            if (m_alive.size() + CHUNK_SIZE > RESOURCE_HANDLE_INDEX_MASK)
+                return nullptr;
+
+            grow();
+        }
+
+        uint32_t index = m_free_list.back();
+        m_free_list.pop_back();
+
+        T* object = new (slot(index)) T();
+
+        m_alive[index] = 1;
+        m_live_count++;
+        object->resource_id = (uint32_t(m_generations[index]) << RESOURCE_HANDLE_INDEX_BITS) | index;
+
+        return object;
+    }
+
+    void free(T* object)
+    {
+        if (!object || !get(object->resource_id))
+            return;
+
+        uint32_t index = object->resource_id & RESOURCE_HANDLE_INDEX_MASK;
+
+        object->~T();
+
+        m_alive[index] = 0;
+        m_live_count--;
+
+        // Generation 0 is skipped so that a valid handle can never be INVALID_RESOURCE_HANDLE.
+        uint16_t generation = (m_generations[index] + 1) & RESOURCE_HANDLE_GENERATION_MASK;
+        m_generations[index] = generation == 0 ? 1 : generation;
+
+        m_free_list.push_back(index);
+    }
+
+    T* get(uint32_t handle)
+    {
+        uint32_t index = handle & RESOURCE_HANDLE_INDEX_MASK;
+        uint32_t generation = handle >> RESOURCE_HANDLE_INDEX_BITS;
+
+        if (index >= m_alive.size() || !m_alive[index] || m_generations[index] != generation)
+            return nullptr;
+
+        return slot(index);
+    }
+
+    template <typename F>
+    void for_each(F func)
+    {
+        for (uint32_t i = 0; i < m_alive.size(); i++)
+        {
+            if (m_alive[i])
+                func(slot(i));
+        }
+    }
+
+    inline uint32_t size() const { return m_live_count; }
+    inline uint32_t capacity() const { return (uint32_t)m_alive.size(); }
+
+private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+
+    inline T* slot(uint32_t index)
+    {
+        return reinterpret_cast<T*>(&m_chunks[index / CHUNK_SIZE][index % CHUNK_SIZE]);
+    }
+
+    void grow()
+    {
+        uint32_t first = (uint32_t)m_alive.size();
+
+        m_chunks.push_back(static_cast<Storage*>(::operator new(sizeof(Storage) * CHUNK_SIZE)));
+        m_alive.resize(first + CHUNK_SIZE, 0);
+        m_generations.resize(first + CHUNK_SIZE, 1);
+
+        // Pushed in reverse so that slots are handed out in ascending order.
+        for (uint32_t i = first + CHUNK_SIZE; i > first; i--)
+            m_free_list.push_back(i - 1);
+    }
+
+private:
+    std::vector<Storage*> m_chunks;
+    std::vector<uint8_t>  m_alive;
+    std::vector<uint16_t> m_generations;
+    std::vector<uint32_t> m_free_list;
+    uint32_t              m_live_count;
+};
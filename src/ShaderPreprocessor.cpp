@@ -0,0 +1,560 @@
+#include "ShaderPreprocessor.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <stdlib.h>
+
+struct ConditionalBlock
+{
+	bool parent_active;
+	bool taken;	// A branch of this block has already been emitted.
+	bool active;
+	bool seen_else;
+};
+
+static inline bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool is_identifier_char(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static inline std::string_view trim_left(std::string_view str)
+{
+	size_t i = 0;
+
+	while (i < str.size() && is_space(str[i]))
+		i++;
+
+	return str.substr(i);
+}
+
+static inline std::string_view trim(std::string_view str)
+{
+	str = trim_left(str);
+
+	size_t end = str.size();
+
+	while (end > 0 && is_space(str[end - 1]))
+		end--;
+
+	return str.substr(0, end);
+}
+
+// Consumes leading whitespace followed by an identifier, returning the identifier.
+static inline std::string_view take_identifier(std::string_view& str)
+{
+	str = trim_left(str);
+
+	size_t i = 0;
+
+	while (i < str.size() && is_identifier_char(str[i]))
+		i++;
+
+	std::string_view identifier = str.substr(0, i);
+	str = str.substr(i);
+
+	return identifier;
+}
+
+static inline bool consume(std::string_view& str, std::string_view token)
+{
+	str = trim_left(str);
+
+	if (str.substr(0, token.size()) != token)
+		return false;
+
+	str = str.substr(token.size());
+	return true;
+}
+
+static std::string directory_of(const std::string& path)
+{
+	size_t pos = path.find_last_of("/\\");
+	return pos == std::string::npos ? std::string() : path.substr(0, pos + 1);
+}
+
+// Guards against macros that expand to themselves, e.g. #define A A.
+#define MAX_EXPRESSION_DEPTH 16
+
+// Precedence climbing evaluator for #if and #elif. Supports integer literals, macros whose value
+// is an expression, defined(X) and defined X, parentheses, unary ! and -, comparisons, && and ||.
+// Identifiers that are not defined evaluate to 0, as they do in C. Anything else, including
+// trailing tokens, is an error rather than a guess at the branch.
+struct ExpressionParser
+{
+	std::string_view                                               expr;
+	const std::unordered_map<std::string_view, std::string_view>& defines;
+	uint32_t                                                       depth;
+	bool                                                           error;
+
+	bool parse(int64_t& result)
+	{
+		result = parse_binary(0);
+		expr = trim_left(expr);
+
+		return !error && expr.empty();
+	}
+
+	// Returns the precedence of the operator at the front of expr and its length, 0 if there is none.
+	int peek_operator(size_t& length)
+	{
+		static const struct { const char* token; int precedence; } kOperators[] =
+		{
+			{ "||", 1 }, { "&&", 2 }, { "==", 3 }, { "!=", 3 }, { "<=", 4 }, { ">=", 4 }, { "<", 4 }, { ">", 4 }
+		};
+
+		expr = trim_left(expr);
+
+		for (size_t i = 0; i < sizeof(kOperators) / sizeof(kOperators[0]); i++)
+		{
+			std::string_view token = kOperators[i].token;
+
+			if (expr.substr(0, token.size()) == token)
+			{
+				length = token.size();
+				return kOperators[i].precedence;
+			}
+		}
+
+		return 0;
+	}
+
+	int64_t parse_binary(int min_precedence)
+	{
+		int64_t lhs = parse_unary();
+		size_t length = 0;
+		int precedence;
+
+		while (!error && (precedence = peek_operator(length)) > min_precedence)
+		{
+			std::string_view op = expr.substr(0, length);
+			expr = expr.substr(length);
+
+			int64_t rhs = parse_binary(precedence);
+
+			if (op == "||")
+				lhs = lhs || rhs;
+			else if (op == "&&")
+				lhs = lhs && rhs;
+			else if (op == "==")
+				lhs = lhs == rhs;
+			else if (op == "!=")
+				lhs = lhs != rhs;
+			else if (op == "<=")
+				lhs = lhs <= rhs;
+			else if (op == ">=")
+				lhs = lhs >= rhs;
+			else if (op == "<")
+				lhs = lhs < rhs;
+			else
+				lhs = lhs > rhs;
+		}
+
+		return lhs;
+	}
+
+	int64_t parse_unary()
+	{
+		if (consume(expr, "!"))
+			return !parse_unary();
+
+		if (consume(expr, "-"))
+			return -parse_unary();
+
+		if (consume(expr, "("))
+		{
+			int64_t value = parse_binary(0);
+
+			if (!consume(expr, ")"))
+				error = true;
+
+			return value;
+		}
+
+		std::string_view identifier = take_identifier(expr);
+
+		if (identifier.empty())
+		{
+			error = true;
+			return 0;
+		}
+
+		if (identifier[0] >= '0' && identifier[0] <= '9')
+			return parse_number(identifier);
+
+		if (identifier == "defined")
+		{
+			bool paren = consume(expr, "(");
+			std::string_view name = take_identifier(expr);
+
+			if (name.empty() || (paren && !consume(expr, ")")))
+				error = true;
+
+			return defines.count(name) != 0;
+		}
+
+		auto it = defines.find(identifier);
+
+		if (it == defines.end())
+			return 0;
+
+		// The value of a macro is itself an expression, an empty one is not.
+		if (depth >= MAX_EXPRESSION_DEPTH || trim(it->second).empty())
+		{
+			error = true;
+			return 0;
+		}
+
+		ExpressionParser nested = { it->second, defines, depth + 1, false };
+		int64_t value = 0;
+
+		if (!nested.parse(value))
+			error = true;
+
+		return value;
+	}
+
+	int64_t parse_number(std::string_view literal)
+	{
+		// Unsigned suffixes are accepted and ignored.
+		while (!literal.empty() && (literal.back() == 'u' || literal.back() == 'U'))
+			literal.remove_suffix(1);
+
+		std::string text(literal);
+		char* end = nullptr;
+		int64_t value = strtoll(text.c_str(), &end, 0);
+
+		if (text.empty() || end != text.c_str() + text.size())
+			error = true;
+
+		return value;
+	}
+};
+
+static bool evaluate(std::string_view expr, const std::unordered_map<std::string_view, std::string_view>& defines, bool& result)
+{
+	ExpressionParser parser = { expr, defines, 0, false };
+	int64_t value = 0;
+
+	if (!parser.parse(value))
+		return false;
+
+	result = value != 0;
+	return true;
+}
+
+static uint64_t hash_defines(const StringList& defines, uint64_t seed)
+{
+	// Sorted so that the same set of defines maps to the same permutation regardless of order.
+	std::vector<std::string_view> sorted(defines.begin(), defines.end());
+	std::sort(sorted.begin(), sorted.end());
+
+	uint64_t hash = seed;
+
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		hash = Utility::hash_fnv1a(sorted[i].data(), sorted[i].size(), hash);
+		hash = Utility::hash_fnv1a("\n", 1, hash);
+	}
+
+	return hash;
+}
+
+ShaderPreprocessor::ShaderPreprocessor()
+{
+
+}
+
+ShaderPreprocessor::~ShaderPreprocessor()
+{
+
+}
+
+void ShaderPreprocessor::add_include_directory(const std::string& path)
+{
+	if (path.empty())
+		return;
+
+	char last = path[path.size() - 1];
+	m_include_dirs.push_back(last == '/' || last == '\\' ? path : path + "/");
+}
+
+const std::string* ShaderPreprocessor::preprocess(std::string_view source, const StringList& defines)
+{
+	uint64_t key = hash_defines(defines, Utility::hash_fnv1a(source.data(), source.size()));
+	return run(key, source, std::string(), defines);
+}
+
+const std::string* ShaderPreprocessor::preprocess_file(const std::string& path, const StringList& defines)
+{
+	// Keyed by path rather than contents, so a cache hit does not even touch the file cache.
+	uint64_t key = Utility::hash_fnv1a("file:", 5);
+	key = hash_defines(defines, Utility::hash_fnv1a(path.c_str(), path.size(), key));
+
+	auto it = m_output_cache.find(key);
+
+	if (it != m_output_cache.end())
+		return &it->second;
+
+	const std::string* source = load_include(path);
+
+	if (!source)
+	{
+		LOG_ERROR("Failed to read shader source : " + path);
+		return nullptr;
+	}
+
+	return run(key, *source, path, defines);
+}
+
+void ShaderPreprocessor::clear_cache()
+{
+	m_include_cache.clear();
+	m_output_cache.clear();
+}
+
+const std::string* ShaderPreprocessor::run(uint64_t key, std::string_view source, const std::string& path, const StringList& defines)
+{
+	auto it = m_output_cache.find(key);
+
+	if (it != m_output_cache.end())
+		return &it->second;
+
+	Context context;
+	context.output.reserve(source.size());
+
+	// Entries are NAME or NAME=VALUE, a bare name has the value 1 like -DNAME.
+	for (size_t i = 0; i < defines.size(); i++)
+	{
+		std::string_view define = defines[i];
+		size_t equals = define.find('=');
+
+		if (equals == std::string_view::npos)
+			context.defines[define] = "1";
+		else
+			context.defines[define.substr(0, equals)] = define.substr(equals + 1);
+	}
+
+	if (!process(source, path, context, 0))
+		return nullptr;
+
+	return &m_output_cache.emplace(key, std::move(context.output)).first->second;
+}
+
+const std::string* ShaderPreprocessor::load_include(const std::string& path)
+{
+	auto it = m_include_cache.find(path);
+
+	if (it != m_include_cache.end())
+		return &it->second;
+
+	std::string source;
+
+	if (!Utility::ReadText(path, source))
+		return nullptr;
+
+	// Map nodes are never relocated, so views into cached files stay valid for the whole run.
+	return &m_include_cache.emplace(path, std::move(source)).first->second;
+}
+
+const std::string* ShaderPreprocessor::resolve_include(std::string_view name, const std::string& path, std::string& resolved)
+{
+	resolved = directory_of(path) + std::string(name);
+
+	if (const std::string* source = load_include(resolved))
+		return source;
+
+	for (size_t i = 0; i < m_include_dirs.size(); i++)
+	{
+		resolved = m_include_dirs[i] + std::string(name);
+
+		if (const std::string* source = load_include(resolved))
+			return source;
+	}
+
+	return nullptr;
+}
+
+bool ShaderPreprocessor::process(std::string_view source, const std::string& path, Context& context, uint32_t depth)
+{
+	if (depth > MAX_SHADER_INCLUDE_DEPTH)
+	{
+		LOG_ERROR("Shader include depth exceeded : " + path);
+		return false;
+	}
+
+	std::vector<ConditionalBlock> blocks;
+	size_t pos = 0;
+
+	while (pos < source.size())
+	{
+		size_t end = source.find('\n', pos);
+
+		if (end == std::string_view::npos)
+			end = source.size();
+
+		std::string_view line = source.substr(pos, end - pos);
+		pos = end + 1;
+
+		bool active = blocks.empty() || blocks.back().active;
+		std::string_view trimmed = trim_left(line);
+
+		if (trimmed.empty() || trimmed[0] != '#')
+		{
+			if (active)
+			{
+				context.output.append(line.data(), line.size());
+				context.output.push_back('\n');
+			}
+
+			continue;
+		}
+
+		std::string_view args = trimmed.substr(1);
+		std::string_view directive = take_identifier(args);
+
+		// Conditionals
+
+		if (directive == "ifdef" || directive == "ifndef" || directive == "if")
+		{
+			bool cond = false;
+
+			if (active)
+			{
+				if (directive == "if")
+				{
+					if (!evaluate(args, context.defines, cond))
+					{
+						LOG_ERROR("Invalid #if expression '" + std::string(trim(args)) + "' in shader : " + path);
+						return false;
+					}
+				}
+				else
+					cond = (context.defines.count(take_identifier(args)) != 0) == (directive == "ifdef");
+			}
+
+			blocks.push_back({ active, cond, cond, false });
+			continue;
+		}
+		else if (directive == "elif" || directive == "else" || directive == "endif")
+		{
+			if (blocks.empty() || (blocks.back().seen_else && directive != "endif"))
+			{
+				LOG_ERROR("Unexpected #" + std::string(directive) + " in shader : " + path);
+				return false;
+			}
+
+			ConditionalBlock& block = blocks.back();
+
+			if (directive == "endif")
+				blocks.pop_back();
+			else
+			{
+				bool cond = block.parent_active && !block.taken;
+
+				if (directive == "elif")
+				{
+					// Only evaluated when the branch could be taken, as in C.
+					bool value = false;
+
+					if (cond && !evaluate(args, context.defines, value))
+					{
+						LOG_ERROR("Invalid #elif expression '" + std::string(trim(args)) + "' in shader : " + path);
+						return false;
+					}
+
+					cond = cond && value;
+				}
+				else
+					block.seen_else = true;
+
+				block.active = cond;
+				block.taken = block.taken || cond;
+			}
+
+			continue;
+		}
+
+		if (!active)
+			continue;
+
+		// Directives handled here
+
+		if (directive == "include")
+		{
+			args = trim(args);
+
+			if (args.size() < 2 || !((args[0] == '"' && args.back() == '"') || (args[0] == '<' && args.back() == '>')))
+			{
+				LOG_ERROR("Malformed #include in shader : " + path);
+				return false;
+			}
+
+			std::string_view name = args.substr(1, args.size() - 2);
+			std::string resolved;
+			const std::string* include = resolve_include(name, path, resolved);
+
+			if (!include)
+			{
+				LOG_ERROR("Failed to resolve shader include : " + std::string(name));
+				return false;
+			}
+
+			if (context.once_files.count(resolved) != 0)
+				continue;
+
+			if (!process(*include, resolved, context, depth + 1))
+				return false;
+
+			continue;
+		}
+		else if (directive == "pragma")
+		{
+			std::string_view pragma_args = args;
+
+			if (take_identifier(pragma_args) == "once")
+			{
+				if (!path.empty())
+					context.once_files.insert(path);
+
+				continue;
+			}
+		}
+		else if (directive == "define")
+		{
+			std::string_view define_args = args;
+			std::string_view name = take_identifier(define_args);
+
+			// Comments are left to the GLSL compiler, they are not part of the value.
+			size_t comment = std::min(define_args.find("//"), define_args.find("/*"));
+
+			if (comment != std::string_view::npos)
+				define_args = define_args.substr(0, comment);
+
+			// Function-like macros are not expanded, their value is left unbalanced so that using
+			// one in an #if fails to evaluate.
+			context.defines[name] = !define_args.empty() && define_args[0] == '(' ? "(" : trim(define_args);
+		}
+		else if (directive == "undef")
+		{
+			std::string_view undef_args = args;
+			context.defines.erase(take_identifier(undef_args));
+		}
+
+		// Everything else, including #define and #undef, is left for the GLSL compiler.
+		context.output.append(line.data(), line.size());
+		context.output.push_back('\n');
+	}
+
+	if (!blocks.empty())
+	{
+		LOG_ERROR("Unterminated conditional in shader : " + (path.empty() ? std::string("<source>") : path));
+		return false;
+	}
+
+	return true;
+}
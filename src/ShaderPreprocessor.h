@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "utility.h"
+
+#define MAX_SHADER_INCLUDE_DEPTH 32
+
+// Single-pass GLSL preprocessor for shader permutations. Handles nested #ifdef/#ifndef/#if/#elif/
+// #else/#endif, #include "file" and #pragma once. #if and #elif accept integer literals, macros,
+// defined(X), parentheses, !, -, comparisons, && and || with C precedence. #define and #undef are
+// tracked for them and also passed through, along with every other directive (#version,
+// #extension, ...), to the GLSL compiler untouched. Macros are not expanded in the source.
+//
+// Included files are read from disk once and kept in memory. Outputs are cached by the hash of the
+// source and its define set, so requesting the same permutation twice does no work.
+class ShaderPreprocessor
+{
+public:
+    ShaderPreprocessor();
+    ~ShaderPreprocessor();
+
+    // Includes are resolved relative to the including file first, then against the include
+    // directories in the order they were added.
+    void add_include_directory(const std::string& path);
+
+    // Defines are NAME or NAME=VALUE. Returns nullptr if an #include could not be resolved, the
+    // conditionals are unbalanced or an #if expression could not be evaluated.
+    // The returned string is owned by the preprocessor and lives until clear_cache().
+    const std::string* preprocess(std::string_view source, const StringList& defines);
+    const std::string* preprocess_file(const std::string& path, const StringList& defines);
+
+    void clear_cache();
+
+    inline uint32_t cached_outputs() const { return (uint32_t)m_output_cache.size(); }
+
+private:
+    struct Context
+    {
+        std::unordered_map<std::string_view, std::string_view> defines; // Name to value.
+        std::unordered_set<std::string>                         once_files;
+        std::string                                             output;
+    };
+
+    // Path is the file the source was read from, or empty for in-memory sources.
+    bool process(std::string_view source, const std::string& path, Context& context, uint32_t depth);
+    const std::string* load_include(const std::string& path);
+    const std::string* resolve_include(std::string_view name, const std::string& path, std::string& resolved);
+    const std::string* run(uint64_t key, std::string_view source, const std::string& path, const StringList& defines);
+
+private:
+    std::vector<std::string>                       m_include_dirs;
+    std::unordered_map<std::string, std::string>   m_include_cache;
+    std::unordered_map<uint64_t, std::string>      m_output_cache;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+// On-disk texture container read by the TextureStreamer. Mips are stored finest first and each
+// one is tightly packed, so a mip can be read straight into a pixel unpack buffer.
+
+#define TEXTURE_FILE_MAGIC    0x58455441 // "ATEX"
+#define TEXTURE_FILE_VERSION  1
+#define MAX_TEXTURE_FILE_MIPS 16
+
+struct TextureFileMip
+{
+    uint64_t offset; // From the start of the file.
+    uint32_t size;
+    uint16_t width;
+    uint16_t height;
+};
+
+struct TextureFileHeader
+{
+    uint32_t       magic;
+    uint32_t       version;
+    uint32_t       format; // TextureFormat
+    uint16_t       width;
+    uint16_t       height;
+    uint32_t       mip_levels;
+    TextureFileMip mips[MAX_TEXTURE_FILE_MIPS];
+};
@@ -0,0 +1,536 @@
+#include "TextureStreamer.h"
+#include "RenderDevice.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <float.h>
+#include <algorithm>
+
+#define REQUEST_QUEUED 0
+#define REQUEST_LOADED 1
+#define REQUEST_FAILED 2
+
+// Offsets into the pixel unpack buffer must be aligned to the size of the pixel type.
+#define STAGING_ALIGNMENT 16
+
+static inline size_t align_staging(size_t size)
+{
+	return (size + STAGING_ALIGNMENT - 1) & ~(size_t)(STAGING_ALIGNMENT - 1);
+}
+
+TextureStreamer::TextureStreamer() : m_device(nullptr),
+									 m_staging(nullptr),
+									 m_streaming_enabled(false),
+									 m_staging_head(0),
+									 m_resident_bytes(0),
+									 m_pending_bytes(0),
+									 m_io_stop(false)
+{
+
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	stop_io_thread();
+}
+
+bool TextureStreamer::init(RenderDevice* device, const TextureStreamerDesc& desc)
+{
+	m_device = device;
+	m_desc = desc;
+	m_streaming_enabled = device->texture_copy_supported();
+
+	// The staging buffer needs GL 4.4, one level above the copies, and is null below it.
+	if (m_streaming_enabled)
+	{
+		m_staging = device->create_staging_buffer(desc.staging_size);
+		m_streaming_enabled = m_staging != nullptr;
+	}
+
+	if (!m_streaming_enabled)
+	{
+		LOG_WARNING("Texture streaming unavailable, textures will be loaded whole.");
+		return true;
+	}
+
+	m_io_stop = false;
+	m_io_thread = std::thread(&TextureStreamer::io_thread_func, this);
+
+	return true;
+}
+
+void TextureStreamer::shutdown()
+{
+	stop_io_thread();
+
+	for (size_t i = 0; i < m_batches.size(); i++)
+		m_device->release_fence(m_batches[i].fence);
+
+	m_batches.clear();
+	m_allocations.clear();
+	m_requests.clear();
+	m_io_queue.clear();
+
+	while (!m_textures.empty())
+		unload(m_textures.back());
+
+	if (m_staging)
+	{
+		m_device->destroy_staging_buffer(m_staging);
+		m_staging = nullptr;
+	}
+
+	m_staging_head = 0;
+	m_resident_bytes = 0;
+	m_pending_bytes = 0;
+}
+
+StreamedTexture* TextureStreamer::load(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+
+	if (!file)
+	{
+		LOG_ERROR("Failed to open texture : " + path);
+		return nullptr;
+	}
+
+	TextureFileHeader header;
+
+	if (fread(&header, sizeof(TextureFileHeader), 1, file) != 1 ||
+		header.magic != TEXTURE_FILE_MAGIC ||
+		header.version != TEXTURE_FILE_VERSION ||
+		header.mip_levels == 0 ||
+		header.mip_levels > MAX_TEXTURE_FILE_MIPS)
+	{
+		LOG_ERROR("Invalid texture file : " + path);
+		fclose(file);
+		return nullptr;
+	}
+
+	StreamedTexture* texture = new StreamedTexture();
+
+	texture->path = path;
+	texture->header = header;
+	texture->streaming = false;
+	texture->screen_size = 0.0f;
+	texture->priority = 0.0f;
+
+	uint32_t last_mip = header.mip_levels - 1;
+
+	texture->tail_mip = m_streaming_enabled ? last_mip : 0;
+
+	for (uint32_t i = 0; i < last_mip && m_streaming_enabled; i++)
+	{
+		if (header.mips[i].width <= m_desc.resident_mip_size && header.mips[i].height <= m_desc.resident_mip_size)
+		{
+			texture->tail_mip = i;
+			break;
+		}
+	}
+
+	texture->min_mip = texture->tail_mip;
+
+	for (uint32_t i = 0; i < texture->tail_mip; i++)
+	{
+		if (align_staging(header.mips[i].size) <= m_desc.staging_size)
+		{
+			texture->min_mip = i;
+			break;
+		}
+	}
+
+	texture->texture = create_storage(texture, texture->tail_mip);
+	texture->resident_mip = texture->tail_mip;
+
+	if (!texture->texture)
+	{
+		LOG_ERROR("Failed to create texture storage : " + path);
+
+		fclose(file);
+		delete texture;
+
+		return nullptr;
+	}
+
+	std::vector<uint8_t> data;
+
+	for (uint32_t i = texture->tail_mip; i <= last_mip; i++)
+	{
+		data.resize(header.mips[i].size);
+
+		if (fseek(file, (long)header.mips[i].offset, SEEK_SET) != 0 || fread(data.data(), 1, data.size(), file) != data.size())
+		{
+			LOG_ERROR("Failed to read texture : " + path);
+
+			fclose(file);
+			m_device->destroy_texture(texture->texture);
+			delete texture;
+
+			return nullptr;
+		}
+
+		m_device->update_texture_2d(texture->texture, i - texture->tail_mip, data.data());
+	}
+
+	fclose(file);
+
+	m_textures.push_back(texture);
+
+	return texture;
+}
+
+void TextureStreamer::unload(StreamedTexture* texture)
+{
+	for (size_t i = 0; i < m_requests.size(); i++)
+	{
+		if (m_requests[i]->texture == texture)
+		{
+			m_pending_bytes -= m_requests[i]->size;
+			m_requests[i]->texture = nullptr;
+		}
+	}
+
+	for (uint32_t i = texture->resident_mip; i < texture->tail_mip; i++)
+		m_resident_bytes -= texture->header.mips[i].size;
+
+	m_device->destroy_texture(texture->texture);
+	m_textures.erase(std::find(m_textures.begin(), m_textures.end(), texture));
+
+	delete texture;
+}
+
+void TextureStreamer::request(StreamedTexture* texture, float screen_size)
+{
+	if (screen_size > texture->screen_size)
+		texture->screen_size = screen_size;
+}
+
+void TextureStreamer::update()
+{
+	if (!m_streaming_enabled)
+		return;
+
+	retire_uploads();
+	submit_uploads();
+	schedule();
+}
+
+void TextureStreamer::io_thread_func()
+{
+	while (true)
+	{
+		StreamRequest* request;
+
+		{
+			std::unique_lock<std::mutex> lock(m_io_mutex);
+			m_io_cv.wait(lock, [this]() { return m_io_stop || !m_io_queue.empty(); });
+
+			if (m_io_stop)
+				return;
+
+			request = m_io_queue.front();
+			m_io_queue.pop_front();
+		}
+
+		bool success = false;
+		FILE* file = fopen(request->path.c_str(), "rb");
+
+		if (file)
+		{
+			// The destination is the persistently mapped staging ring, so there is no extra copy.
+			success = fseek(file, (long)request->file_offset, SEEK_SET) == 0 && fread(request->dst, 1, request->size, file) == request->size;
+			fclose(file);
+		}
+
+		request->state.store(success ? REQUEST_LOADED : REQUEST_FAILED, std::memory_order_release);
+	}
+}
+
+void TextureStreamer::stop_io_thread()
+{
+	if (!m_io_thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_io_mutex);
+		m_io_stop = true;
+	}
+
+	m_io_cv.notify_one();
+	m_io_thread.join();
+}
+
+void TextureStreamer::retire_uploads()
+{
+	while (!m_batches.empty() && m_device->fence_signaled(m_batches.front().fence))
+	{
+		for (uint32_t i = 0; i < m_batches.front().num_allocations; i++)
+			m_allocations.pop_front();
+
+		m_batches.pop_front();
+	}
+}
+
+void TextureStreamer::submit_uploads()
+{
+	size_t uploaded = 0;
+	uint32_t num_allocations = 0;
+
+	// Requests complete in the order they were issued, so uploads and staging releases stay FIFO.
+	while (!m_requests.empty())
+	{
+		StreamRequest* request = m_requests.front().get();
+		uint32_t state = request->state.load(std::memory_order_acquire);
+
+		if (state == REQUEST_QUEUED)
+			break;
+
+		if (uploaded > 0 && uploaded + request->size > m_desc.max_upload_per_frame)
+			break;
+
+		StreamedTexture* texture = request->texture;
+
+		if (texture)
+		{
+			texture->streaming = false;
+			m_pending_bytes -= request->size;
+
+			if (state == REQUEST_LOADED)
+			{
+				Texture2D* storage = create_storage(texture, request->mip);
+
+				// The texture keeps its current mips, the request is dropped and can be issued again.
+				if (storage)
+				{
+					m_device->copy_texture_mips(storage, 1, texture->texture, 0, texture->texture->mip_levels);
+					m_device->update_texture_2d(storage, 0, m_staging, request->staging_offset);
+					m_device->replace_texture_storage(texture->texture, storage);
+
+					texture->resident_mip = request->mip;
+					m_resident_bytes += request->size;
+					uploaded += request->size;
+				}
+				else
+					LOG_ERROR("Failed to create texture storage : " + request->path);
+			}
+			else
+				LOG_ERROR("Failed to stream texture mip : " + request->path);
+		}
+
+		m_requests.pop_front();
+		num_allocations++;
+	}
+
+	if (num_allocations > 0)
+	{
+		UploadBatch batch;
+		batch.fence.sync = nullptr;
+		batch.num_allocations = num_allocations;
+
+		m_device->insert_fence(batch.fence);
+		m_batches.push_back(batch);
+	}
+}
+
+void TextureStreamer::schedule()
+{
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		m_textures[i]->priority = m_textures[i]->screen_size;
+		m_textures[i]->screen_size = 0.0f;
+	}
+
+	while (m_resident_bytes + m_pending_bytes > m_desc.memory_budget)
+	{
+		StreamedTexture* victim = find_eviction_victim(FLT_MAX);
+
+		if (!victim)
+			break;
+
+		if (!evict_mip(victim))
+			break;
+	}
+
+	std::vector<StreamedTexture*> candidates;
+
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		if (!m_textures[i]->streaming && m_textures[i]->resident_mip > desired_mip(m_textures[i]))
+			candidates.push_back(m_textures[i]);
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const StreamedTexture* a, const StreamedTexture* b) { return a->priority > b->priority; });
+
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		StreamedTexture* texture = candidates[i];
+		uint32_t mip = texture->resident_mip - 1;
+		size_t size = texture->header.mips[mip].size;
+
+		// Make room by dropping detail from textures that matter less than this one.
+		while (m_resident_bytes + m_pending_bytes + size > m_desc.memory_budget)
+		{
+			StreamedTexture* victim = find_eviction_victim(texture->priority);
+
+			if (!victim)
+				break;
+
+			if (!evict_mip(victim))
+				break;
+		}
+
+		if (m_resident_bytes + m_pending_bytes + size > m_desc.memory_budget)
+			continue;
+
+		// The staging ring is full, nothing else fits until uploads retire.
+		if (!issue_request(texture, mip))
+			break;
+	}
+}
+
+bool TextureStreamer::issue_request(StreamedTexture* texture, uint32_t mip)
+{
+	const TextureFileMip& file_mip = texture->header.mips[mip];
+	size_t offset;
+
+	if (!allocate_staging(align_staging(file_mip.size), offset))
+		return false;
+
+	std::unique_ptr<StreamRequest> request(new StreamRequest());
+
+	request->texture = texture;
+	request->mip = mip;
+	request->path = texture->path;
+	request->file_offset = file_mip.offset;
+	request->size = file_mip.size;
+	request->dst = m_staging->persistent_data + offset;
+	request->staging_offset = offset;
+	request->state.store(REQUEST_QUEUED, std::memory_order_relaxed);
+
+	texture->streaming = true;
+	m_pending_bytes += file_mip.size;
+
+	{
+		std::lock_guard<std::mutex> lock(m_io_mutex);
+		m_io_queue.push_back(request.get());
+	}
+
+	m_io_cv.notify_one();
+	m_requests.push_back(std::move(request));
+
+	return true;
+}
+
+bool TextureStreamer::allocate_staging(size_t size, size_t& offset)
+{
+	size_t capacity = m_desc.staging_size;
+
+	if (size > capacity)
+		return false;
+
+	if (m_allocations.empty())
+		offset = 0;
+	else
+	{
+		size_t tail = m_allocations.front().offset;
+
+		if (m_staging_head > tail)
+		{
+			if (m_staging_head + size <= capacity)
+				offset = m_staging_head;
+			else if (size <= tail)
+				offset = 0;
+			else
+				return false;
+		}
+		else if (m_staging_head + size <= tail)
+			offset = m_staging_head;
+		else
+			return false;
+	}
+
+	m_staging_head = offset + size;
+	m_allocations.push_back({ offset, size });
+
+	return true;
+}
+
+uint32_t TextureStreamer::desired_mip(const StreamedTexture* texture) const
+{
+	uint32_t mip = texture->tail_mip;
+
+	if (texture->priority > 0.0f)
+	{
+		float size = (float)std::max(texture->header.width, texture->header.height);
+		mip = 0;
+
+		while (mip < texture->tail_mip && size * 0.5f >= texture->priority)
+		{
+			size *= 0.5f;
+			mip++;
+		}
+	}
+
+	return std::max(mip, texture->min_mip);
+}
+
+StreamedTexture* TextureStreamer::find_eviction_victim(float max_priority)
+{
+	StreamedTexture* victim = nullptr;
+	bool victim_needed = true;
+
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		StreamedTexture* texture = m_textures[i];
+
+		if (texture->streaming || texture->resident_mip >= texture->tail_mip || texture->priority >= max_priority)
+			continue;
+
+		// Detail that is no longer wanted goes first, then the lowest priority.
+		bool needed = texture->resident_mip >= desired_mip(texture);
+
+		if (!victim || (victim_needed && !needed) || (victim_needed == needed && texture->priority < victim->priority))
+		{
+			victim = texture;
+			victim_needed = needed;
+		}
+	}
+
+	return victim;
+}
+
+bool TextureStreamer::evict_mip(StreamedTexture* texture)
+{
+	Texture2D* storage = create_storage(texture, texture->resident_mip + 1);
+
+	// Without the smaller storage the texture stays as it is.
+	if (!storage)
+	{
+		LOG_ERROR("Failed to create texture storage : " + texture->path);
+		return false;
+	}
+
+	m_device->copy_texture_mips(storage, 0, texture->texture, 1, storage->mip_levels);
+	m_device->replace_texture_storage(texture->texture, storage);
+
+	m_resident_bytes -= texture->header.mips[texture->resident_mip].size;
+	texture->resident_mip++;
+
+	return true;
+}
+
+Texture2D* TextureStreamer::create_storage(StreamedTexture* texture, uint32_t first_mip)
+{
+	Texture2DCreateDesc desc;
+
+	desc.width = texture->header.mips[first_mip].width;
+	desc.height = texture->header.mips[first_mip].height;
+	desc.data = nullptr;
+	desc.format = texture->header.format;
+	desc.create_render_target_view = false;
+	desc.generate_mipmaps = false;
+	desc.mipmap_levels = texture->header.mip_levels - first_mip;
+
+	return m_device->create_texture_2d(desc);
+}
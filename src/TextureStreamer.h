@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "gfx_types.h"
+#include "TextureFile.h"
+
+class RenderDevice;
+
+struct TextureStreamerDesc
+{
+    size_t   memory_budget;        // Bytes of streamed (non-tail) mip data allowed to be resident.
+    size_t   staging_size;         // Size of the pixel unpack ring. Mips larger than this are never streamed.
+    size_t   max_upload_per_frame; // Bytes handed to the driver per update().
+    uint16_t resident_mip_size;    // Mips no larger than this are loaded up front and never evicted.
+};
+
+struct StreamedTexture
+{
+    Texture2D*        texture; // Level 0 of the storage is always resident_mip.
+    std::string       path;
+    TextureFileHeader header;
+    uint32_t          tail_mip;     // This and all coarser mips are always resident.
+    uint32_t          min_mip;      // Finest mip that fits through the staging ring.
+    uint32_t          resident_mip; // Finest mip currently resident.
+    bool              streaming;    // A read of resident_mip - 1 is in flight.
+    float             screen_size;  // Largest on-screen size in pixels requested this frame.
+    float             priority;     // screen_size of the last update.
+};
+
+// Streams texture mips in from TextureFile containers. Loading a texture only reads its small
+// tail mips; finer mips are read by a background I/O thread straight into a persistently mapped
+// pixel unpack ring and uploaded from there, one level at a time. Texture storage only ever
+// holds the resident mips, so the memory budget bounds actual VRAM use: gaining or losing a
+// level reallocates the storage and copies the shared mips over on the GPU.
+//
+// All functions except the I/O thread itself must be called from the thread owning the GL
+// context. Requires GL 4.3 for texture copies, without it textures are loaded whole.
+class TextureStreamer
+{
+public:
+    TextureStreamer();
+    ~TextureStreamer();
+
+    bool init(RenderDevice* device, const TextureStreamerDesc& desc);
+    void shutdown();
+
+    StreamedTexture* load(const std::string& path);
+    void unload(StreamedTexture* texture);
+
+    // Reports a use of the texture this frame covering roughly screen_size pixels along its
+    // largest axis. Textures that are not reported decay to their tail and are evicted first.
+    void request(StreamedTexture* texture, float screen_size);
+
+    // Retires finished uploads, uploads mips read since the last update and schedules new reads
+    // and evictions by priority. Call once per frame.
+    void update();
+
+    inline size_t resident_bytes() const { return m_resident_bytes; }
+    inline size_t pending_bytes() const { return m_pending_bytes; }
+
+private:
+    struct StreamRequest
+    {
+        StreamedTexture*      texture; // Cleared if the texture is unloaded while in flight.
+        uint32_t              mip;
+        std::string           path;
+        uint64_t              file_offset;
+        uint32_t              size;
+        uint8_t*              dst;
+        size_t                staging_offset;
+        std::atomic<uint32_t> state;
+    };
+
+    struct StagingAllocation
+    {
+        size_t offset;
+        size_t size;
+    };
+
+    struct UploadBatch
+    {
+        Fence    fence;
+        uint32_t num_allocations; // Staging allocations released once the fence signals.
+    };
+
+    void io_thread_func();
+    void stop_io_thread();
+    void retire_uploads();
+    void submit_uploads();
+    void schedule();
+    bool issue_request(StreamedTexture* texture, uint32_t mip);
+    bool allocate_staging(size_t size, size_t& offset);
+    uint32_t desired_mip(const StreamedTexture* texture) const;
+    StreamedTexture* find_eviction_victim(float max_priority);
+    // Returns false if the smaller storage could not be created, the texture is left unchanged.
+    bool evict_mip(StreamedTexture* texture);
+    // Returns nullptr if the texture could not be created.
+    Texture2D* create_storage(StreamedTexture* texture, uint32_t first_mip);
+
+private:
+    RenderDevice*                               m_device;
+    TextureStreamerDesc                         m_desc;
+    StagingBuffer*                              m_staging;
+    bool                                        m_streaming_enabled;
+    std::vector<StreamedTexture*>               m_textures;
+    std::deque<std::unique_ptr<StreamRequest>>  m_requests;
+    std::deque<StagingAllocation>               m_allocations;
+    std::deque<UploadBatch>                     m_batches;
+    size_t                                      m_staging_head;
+    size_t                                      m_resident_bytes;
+    size_t                                      m_pending_bytes;
+
+    std::thread                                 m_io_thread;
+    std::mutex                                  m_io_mutex;
+    std::condition_variable                     m_io_cv;
+    std::deque<StreamRequest*>                  m_io_queue;
+    bool                                        m_io_stop;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "glad.h"
+
+// OpenGL error checking. Exactly one of the following is defined by the build (see the
+// GFX_ERROR_CHECK cache variable in CMake):
+//
+// GFX_ERROR_CHECK_OFF    : GL calls are issued as-is. No glGetError, no debug output.
+// GFX_ERROR_CHECK_ASYNC  : Errors are reported by the driver through a KHR_debug callback that
+//                          is routed into the Logger. Each call only records its source location
+//                          so the callback can tell where the offending call came from.
+// GFX_ERROR_CHECK_STRICT : Every GL call is followed by a glGetError loop. Slow, but catches
+//                          errors on drivers without KHR_debug.
+
+#if !defined(GFX_ERROR_CHECK_OFF) && !defined(GFX_ERROR_CHECK_ASYNC) && !defined(GFX_ERROR_CHECK_STRICT)
+    #if defined(NDEBUG)
+        #define GFX_ERROR_CHECK_OFF
+    #else
+        #define GFX_ERROR_CHECK_STRICT
+    #endif
+#endif
+
+struct GLCallSite
+{
+    const char* file;
+    int         line;
+};
+
+extern GLCallSite g_gl_call_site;
+
+// Logs every pending glGetError code against the given source location.
+extern void gl_check_errors(const char* file, int line);
+
+// Expands to a single statement, so it is safe as the body of an unbraced if or else.
+#if defined(GFX_ERROR_CHECK_STRICT)
+    #define GL_CHECK_ERROR(x) do { x; gl_check_errors(__FILE__, __LINE__); } while (0)
+#elif defined(GFX_ERROR_CHECK_ASYNC)
+    #define GL_CHECK_ERROR(x) do { g_gl_call_site.file = __FILE__; g_gl_call_site.line = __LINE__; x; } while (0)
+#else
+    #define GL_CHECK_ERROR(x) x
+#endif
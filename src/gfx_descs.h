@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 
 #define MAX_RENDER_TARGETS 16
 
@@ -17,6 +18,20 @@ struct RenderDeviceInitData
     size_t size;
 };
 
+struct ResourceReserveDesc
+{
+    uint32_t shaders;
+    uint32_t shader_programs;
+    uint32_t vertex_buffers;
+    uint32_t index_buffers;
+    uint32_t uniform_buffers;
+    uint32_t textures;
+    uint32_t texture_arrays;
+    uint32_t vertex_arrays;
+    uint32_t sampler_states;
+    uint32_t framebuffers;
+};
+
 struct Texture1DCreateDesc
 {
     uint16_t width;
@@ -37,6 +52,19 @@ struct Texture2DCreateDesc
     uint16_t mipmap_levels;
 };
 
+// data holds level 0 of every layer back to back, or is null.
+struct Texture2DArrayCreateDesc
+{
+    uint16_t width;
+    uint16_t height;
+    uint16_t array_size;
+    void*    data;
+    uint32_t format;
+    bool     create_render_target_view;
+    bool     generate_mipmaps;
+    uint16_t mipmap_levels;
+};
+
 struct Texture3DCreateDesc
 {
     uint16_t width;
@@ -68,11 +96,26 @@ struct BufferCreateDesc
     uint32_t data_type;
 };
 
+struct UniformRingBufferCreateDesc
+{
+    uint32_t size_per_frame;
+    uint32_t num_frames;
+};
+
+struct DrawBatchCreateDesc
+{
+    uint32_t max_draws;
+    uint32_t draw_data_stride; // Size of the per-draw data, 0 if the batch has none.
+};
+
+// Per-instance elements are read from the instance buffer of the vertex array, their offsets are
+// relative to the start of an instance.
 struct InputLayoutCreateDesc
 {
     InputElement* elements;
     uint32_t	  vertex_size;
     uint32_t	  num_elements;
+    uint32_t	  instance_size;
 };
 
 struct VertexArrayCreateDesc
@@ -80,6 +123,7 @@ struct VertexArrayCreateDesc
     VertexBuffer* vertex_buffer;
     IndexBuffer*  index_buffer;
     InputLayout*  layout;
+    VertexBuffer* instance_buffer; // Required if the layout has per-instance elements.
 };
 
 struct FramebufferCreateDesc
@@ -141,9 +185,26 @@ struct ShaderProgramCreateDesc
     Shader* tessellation_evaluation;
 };
 
+#define MAX_BLEND_TARGETS 8
+
+// Zero filled means blending disabled with every channel written.
+struct RenderTargetBlendDesc
+{
+    bool     enable;
+    uint32_t src_color;           // BlendFactor
+    uint32_t dst_color;
+    uint32_t color_op;            // BlendOp
+    uint32_t src_alpha;
+    uint32_t dst_alpha;
+    uint32_t alpha_op;
+    uint8_t  color_write_disable; // ColorWriteMask channels that are left untouched.
+};
+
+// Without independent_blend render_targets[0] applies to every render target.
 struct BlendStateCreateDesc
 {
-    
+    bool                  independent_blend;
+    RenderTargetBlendDesc render_targets[MAX_BLEND_TARGETS];
 };
 
 struct PipelineStateObjectCreateDesc
@@ -13,6 +13,16 @@ namespace ShaderType
     };
 };
 
+namespace ProgramStatus
+{
+    enum
+    {
+        PENDING = 0,
+        READY   = 1,
+        FAILED  = 2
+    };
+};
+
 namespace DepthTest
 {
     enum
@@ -98,7 +108,16 @@ namespace GraphicsCommandType
         BindVertexArray       = 7,
         BindFramebuffer       = 8,
         BindUniformBuffer     = 9,
-        CopyUniformData       = 10
+        CopyUniformData       = 10,
+        BindShaderProgram     = 11,
+        BindPipelineState     = 12,
+        BindUniformBufferRange= 13,
+        SetViewport           = 14,
+        ClearFramebuffer      = 15,
+        DrawInstanced         = 16,
+        DrawIndexedInstanced  = 17,
+        DrawIndexedBaseVertexInstanced = 18,
+        BindBlendState        = 19
     };
 };
 
@@ -165,7 +184,16 @@ namespace TextureFormat
 		R8_SNORM		   = 23,
         D32_FLOAT_S8_UINT  = 24,
         D24_FLOAT_S8_UINT  = 25,
-        D16_FLOAT          = 26
+        D16_FLOAT          = 26,
+        BC1_UNORM          = 27,
+        BC1_UNORM_SRGB     = 28,
+        BC3_UNORM          = 29,
+        BC3_UNORM_SRGB     = 30,
+        BC4_UNORM          = 31,
+        BC5_UNORM          = 32,
+        BC7_UNORM          = 33,
+        BC7_UNORM_SRGB     = 34,
+        R32_FLOAT          = 35
     };
 };
 
@@ -183,6 +211,48 @@ namespace TextureFilteringMode
     };
 };
 
+namespace BlendFactor
+{
+    enum
+    {
+        ZERO                = 0,
+        ONE                 = 1,
+        SRC_COLOR           = 2,
+        ONE_MINUS_SRC_COLOR = 3,
+        DST_COLOR           = 4,
+        ONE_MINUS_DST_COLOR = 5,
+        SRC_ALPHA           = 6,
+        ONE_MINUS_SRC_ALPHA = 7,
+        DST_ALPHA           = 8,
+        ONE_MINUS_DST_ALPHA = 9,
+        SRC_ALPHA_SATURATE  = 10
+    };
+};
+
+namespace BlendOp
+{
+    enum
+    {
+        ADD              = 0,
+        SUBTRACT         = 1,
+        REVERSE_SUBTRACT = 2,
+        MIN              = 3,
+        MAX              = 4
+    };
+};
+
+namespace ColorWriteMask
+{
+    enum
+    {
+        RED   = 1,
+        GREEN = 2,
+        BLUE  = 4,
+        ALPHA = 8,
+        ALL   = 15
+    };
+};
+
 namespace BufferType
 {
     enum
@@ -215,6 +285,35 @@ namespace BufferMapType
     };
 };
 
+namespace ImageAccess
+{
+    enum
+    {
+        READ_ONLY  = 0,
+        WRITE_ONLY = 1,
+        READ_WRITE = 2
+    };
+};
+
+// Writes made by compute shaders and image stores are only visible to the listed kinds of later
+// reads once a barrier with the matching bit has been issued.
+namespace BarrierType
+{
+    enum
+    {
+        VERTEX_ATTRIB  = 1,
+        INDEX          = 2,
+        UNIFORM        = 4,
+        TEXTURE_FETCH  = 8,
+        SHADER_IMAGE   = 16,
+        COMMAND        = 32,
+        BUFFER_UPDATE  = 64,
+        FRAMEBUFFER    = 128,
+        SHADER_STORAGE = 256,
+        ALL            = 511
+    };
+};
+
 namespace DataType
 {
     enum
@@ -2,18 +2,29 @@
 
 #include <vector>
 #include <unordered_map>
+#include <string>
 #include <stdint.h>
+#include <atomic>
 
 //#if defined(GFX_BACKEND_GL4)
 
 #include "glad.h"
+#include "ResourcePool.h"
 
 #define MAX_RENDER_TARGETS 16
+#define MAX_TEXTURE_UNITS 32
+#define MAX_UNIFORM_BUFFER_SLOTS 32
+#define MAX_UNIFORM_RING_REGIONS 4
+#define MAX_STORAGE_BUFFER_SLOTS 16
+#define MAX_IMAGE_UNITS 8
+
+// Sentinel stored in the state cache for values that are not known to match the driver.
+#define GL_STATE_UNKNOWN 0xFFFFFFFF
+#define GL_STATE_UNKNOWN_FLAG 0xFF
 
 struct Shader;
 
 using ShaderMap = std::unordered_map<uint32_t, Shader*>;
-using BindingMap = std::unordered_map<uint32_t, uint32_t>;
 
 struct InputElement
 {
@@ -22,51 +33,73 @@ struct InputElement
     bool		normalized;
     uint32_t	offset;
     const char* semantic_name;
+    uint32_t    instance_step_rate; // 0 for per-vertex data, otherwise the number of instances each value is used for.
 };
 
 struct InputLayout
 {
     InputElement elements[10];
     uint32_t	 vertex_size;
+    uint32_t	 instance_size; // Stride of the instance buffer, 0 if there are no per-instance elements.
     uint32_t	 num_elements;
 };
 
 struct Texture
 {
     GLuint   id;
-    uint16_t resource_id;
+    uint32_t resource_id;
     GLenum   gl_texture_target;
+    GLenum   internal_format;
+    GLenum   format; // Client pixel format and type used for uploads.
+    GLenum   type;
+    uint32_t block_size; // Bytes per 4x4 block for block compressed formats, 0 otherwise.
 };
 
 struct Texture1D : Texture
 {
-    
+    uint16_t width;
+    uint16_t mip_levels;
 };
 
 struct Texture2D : Texture
 {
     uint16_t width;
     uint16_t height;
+    uint16_t mip_levels;
+};
+
+struct Texture2DArray : Texture
+{
+    uint16_t width;
+    uint16_t height;
+    uint16_t array_size;
+    uint16_t mip_levels;
 };
 
 struct Texture3D : Texture
 {
-    
+    uint16_t width;
+    uint16_t height;
+    uint16_t depth;
+    uint16_t mip_levels;
 };
 
 struct TextureCube : Texture
 {
-    
+    uint16_t width;
+    uint16_t height;
+    uint16_t mip_levels;
 };
 
 struct Buffer
 {
     GLuint   id;
-    uint16_t resource_id;
+    uint32_t resource_id;
     void*	 data;
     uint32_t size;
     uint32_t usage_type;
     GLenum   buffer_type;
+    uint8_t* persistent_data; // Non-null if the whole buffer is persistently mapped.
 };
 
 struct VertexBuffer : Buffer
@@ -84,10 +117,74 @@ struct UniformBuffer : Buffer
     
 };
 
+// A persistently mapped uniform buffer split into one region per frame in flight. Allocations
+// are lock-free so worker threads can write uniform data while recording command buffers.
+struct UniformRingBuffer : UniformBuffer
+{
+    uint32_t              alignment;
+    uint32_t              region_size;
+    uint32_t              num_regions;
+    uint32_t              current_region;
+    std::atomic<uint32_t> head;
+    GLsync                fences[MAX_UNIFORM_RING_REGIONS];
+};
+
+// A persistently mapped GL_PIXEL_UNPACK_BUFFER. The mapping is coherent, so any thread may write
+// to it as long as the GPU is no longer reading the range (see Fence).
+struct StagingBuffer : Buffer
+{
+
+};
+
+// Read and written by shaders. Can also be the source of indirect draw and dispatch arguments.
+struct StorageBuffer : Buffer
+{
+
+};
+
+struct Fence
+{
+    GLsync sync;
+};
+
+// GPU time spent between begin_gpu_timer and end_gpu_timer. GL_TIME_ELAPSED queries cannot be
+// nested, so only one timer may be running at a time.
+struct GpuTimer
+{
+    GLuint query;
+    bool   pending; // Ended, but the result has not been read yet.
+};
+
+// Matches the layout expected by glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand
+{
+    uint32_t index_count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    int32_t  base_vertex;
+    uint32_t base_instance;
+};
+
+// A set of indexed draws sharing program, vertex array and pipeline state that is submitted with a
+// single glMultiDrawElementsIndirect. Per-draw data lives in a shader storage buffer indexed by
+// gl_DrawID (GL 4.6 / ARB_shader_draw_parameters), batches without per-draw data don't need it.
+// base_instance is also set to the draw index for shaders that fetch it through an instanced
+// attribute instead.
+struct DrawBatch
+{
+    GLuint                                   indirect_buffer;
+    GLuint                                   draw_data_buffer;
+    uint32_t                                 max_draws;
+    uint32_t                                 draw_data_stride;
+    uint32_t                                 uploaded_draws;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<uint8_t>                     draw_data;
+};
+
 struct VertexArray
 {
     GLuint      id;
-    uint16_t	  resource_id;
+    uint32_t	  resource_id;
     VertexBuffer* vb;
     IndexBuffer*  ib;
 };
@@ -95,17 +192,41 @@ struct VertexArray
 struct Shader
 {
     GLuint      id;
-    BindingMap  sampler_bindings;
+    uint32_t    resource_id;
     uint32_t    type;
     std::string source;
+    bool        compiled;
+    bool        pending; // Compile issued, status not queried yet.
+};
+
+struct UniformBlockBinding
+{
+    uint32_t binding;
+    uint32_t size;
+};
+
+struct SamplerBinding
+{
+    GLint    location;
+    uint32_t unit;
+    GLenum   type;
 };
 
+// Bindings are reflected once at link time. Shaders declare them with layout(binding = N); on
+// GL 4.1 they are assigned consecutively in active resource order instead.
 struct ShaderProgram
 {
-    GLuint    id;
-    uint16_t  resource_id;
-    ShaderMap shader_map;
-    int       shader_count;
+    GLuint              id;
+    uint32_t            resource_id;
+    ShaderMap           shader_map;
+    int                 shader_count;
+    uint32_t            num_uniform_blocks;
+    UniformBlockBinding uniform_blocks[MAX_UNIFORM_BUFFER_SLOTS];
+    uint32_t            num_samplers;
+    SamplerBinding      samplers[MAX_TEXTURE_UNITS];
+    uint32_t            sampler_mask; // Texture units read by the program.
+    uint32_t            status;
+    uint64_t            cache_key;
 };
 
 struct RasterizerState
@@ -139,34 +260,158 @@ struct DepthStencilState
     GLenum back_stencil_pass_depth_pass;
 };
 
+// Shared by every create_sampler_state call with an equivalent description, see
+// DeviceData::sampler_cache. Destroyed once every creation has been matched by a destroy.
 struct SamplerState
 {
-    GLuint id;
-    uint16_t resource_id;
+    GLuint                 id;
+    uint32_t               resource_id;
+    uint32_t               ref_count;
+    uint64_t               hash;
+    SamplerStateCreateDesc desc; // Normalized copy, compared on hash hits.
+};
+
+struct BlendTargetState
+{
+    bool      enable;
+    GLenum    src_color;
+    GLenum    dst_color;
+    GLenum    color_op;
+    GLenum    src_alpha;
+    GLenum    dst_alpha;
+    GLenum    alpha_op;
+    uint8_t   color_mask; // ColorWriteMask channels written.
 };
 
 struct BlendState
 {
-    
+    bool             independent;
+    BlendTargetState targets[MAX_BLEND_TARGETS]; // Only targets[0] is used unless independent.
 };
 
 struct Framebuffer
 {
     GLuint   id;
-    uint16_t resource_id;
+    uint32_t resource_id;
     uint16_t num_render_targets;
     Texture* render_targets[MAX_RENDER_TARGETS];
     Texture* depth_target;
 };
 
+// Shared by every create_pipeline_state_object call with the same description, see
+// DeviceData::pso_cache. Destroyed once every creation has been matched by a destroy.
 struct PipelineStateObject
 {
-    DepthStencilState* depth_stencil_state;
-    RasterizerState*   rasterizer_state;
-    BlendState*        blend_state;
-    uint32_t           primitive;
+    DepthStencilState*            depth_stencil_state;
+    RasterizerState*              rasterizer_state;
+    BlendState*                   blend_state;
+    uint32_t                      primitive;
+    uint32_t                      id;        // Unique for the lifetime of the device, keys pso_diffs.
+    uint32_t                      blend_id;  // Equal for PSOs with identical blend state, see DeviceData::blend_ids.
+    bool                          order_independent_blend; // Blending on every target commutes, e.g. additive.
+    uint32_t                      ref_count;
+    uint64_t                      hash;
+    PipelineStateObjectCreateDesc desc;      // Zero padded copy, compared on hash hits.
+};
+
+struct StencilFaceCache
+{
+    GLenum func;
+    GLuint mask;
+    GLenum fail;
+    GLenum pass_depth_fail;
+    GLenum pass_depth_pass;
+};
+
+struct BlendTargetCache
+{
+    uint8_t enable;
+    uint8_t color_mask;
+    GLenum  src_color;
+    GLenum  dst_color;
+    GLenum  color_op;
+    GLenum  src_alpha;
+    GLenum  dst_alpha;
+    GLenum  alpha_op;
+};
+
+struct UniformBufferBindingCache
+{
+    GLuint id;
+    size_t offset;
+    size_t size;
 };
 
+struct ImageBindingCache
+{
+    GLuint id;
+    GLint  level;
+    GLenum access;
+};
+
+// Shadow copy of the GL state last issued by the RenderDevice. Filled with GL_STATE_UNKNOWN
+// on invalidation so the next bind of every piece of state always reaches the driver.
+struct GLStateCache
+{
+    GLuint  program;
+    GLuint  vertex_array;
+    GLuint  framebuffer;
+    GLuint  active_texture_unit;
+    GLuint  textures[MAX_TEXTURE_UNITS];
+    GLuint  samplers[MAX_TEXTURE_UNITS];
+    UniformBufferBindingCache uniform_buffers[MAX_UNIFORM_BUFFER_SLOTS];
+    GLuint  draw_indirect_buffer;
+    GLuint  dispatch_indirect_buffer;
+    GLuint  parameter_buffer;
+    GLuint  storage_buffers[MAX_STORAGE_BUFFER_SLOTS];
+    ImageBindingCache images[MAX_IMAGE_UNITS];
+    
+    uint8_t enable_cull_face;
+    uint8_t enable_multisample;
+    uint8_t enable_scissor;
+    uint8_t enable_depth;
+    uint8_t enable_stencil;
+    uint8_t depth_mask;
+    
+    GLenum  cull_face;
+    GLenum  polygon_mode;
+    GLenum  front_face;
+    GLenum  depth_func;
+    
+    StencilFaceCache front_stencil;
+    StencilFaceCache back_stencil;
+
+    BlendTargetCache blend[MAX_BLEND_TARGETS];
+    
+    GLint   viewport[4];
+    float   clear_color[4];
+};
+
+struct DeviceFrameStats
+{
+    uint32_t issued_state_calls;
+    uint32_t filtered_state_calls;
+    uint32_t draw_calls;
+    uint32_t dispatch_calls;
+};
+
+using ShaderHandle            = ResourceHandle<Shader>;
+using ShaderProgramHandle     = ResourceHandle<ShaderProgram>;
+using VertexBufferHandle      = ResourceHandle<VertexBuffer>;
+using IndexBufferHandle       = ResourceHandle<IndexBuffer>;
+using UniformBufferHandle     = ResourceHandle<UniformBuffer>;
+using UniformRingBufferHandle = ResourceHandle<UniformRingBuffer>;
+using Texture1DHandle         = ResourceHandle<Texture1D>;
+using Texture2DHandle         = ResourceHandle<Texture2D>;
+using Texture2DArrayHandle    = ResourceHandle<Texture2DArray>;
+using Texture3DHandle         = ResourceHandle<Texture3D>;
+using TextureCubeHandle       = ResourceHandle<TextureCube>;
+using VertexArrayHandle       = ResourceHandle<VertexArray>;
+using SamplerStateHandle      = ResourceHandle<SamplerState>;
+using FramebufferHandle       = ResourceHandle<Framebuffer>;
+using StagingBufferHandle     = ResourceHandle<StagingBuffer>;
+using StorageBufferHandle     = ResourceHandle<StorageBuffer>;
+
 struct DeviceData
 {
     void*          window;
@@ -174,8 +419,51 @@ struct DeviceData
     uint16_t       height;
     GLenum		   primitive_type;
     ShaderProgram* current_program;
-    GLuint		   last_sampler_location;
     IndexBuffer*   current_index_buffer = nullptr;
+    bool           dsa = false; // GL 4.5 Direct State Access is available.
+    bool           program_interface_query = false; // GL 4.3 program introspection is available.
+    bool           parallel_shader_compile = false;
+    bool           indirect_count = false; // glMultiDrawElementsIndirectCount is loaded.
+    bool           draw_parameters = false; // gl_DrawID is available to shaders.
+    float          max_anisotropy = 0.0f; // 0 if anisotropic filtering is unsupported.
+    GLint          uniform_buffer_alignment = 256;
+    GLint          storage_buffer_alignment = 256;
+    ShaderProgram* placeholder_program = nullptr;
+    bool           program_cache_enabled = false;
+    std::string    program_cache_dir;
+    uint64_t       driver_hash = 0;
+    GLStateCache   state;
+    DeviceFrameStats stats;
+
+    // PSOs by description hash, and the state fields that differ between two PSOs keyed by
+    // (from id << 32 | to id), filled in on the first bind of each pair. current_pso is the PSO
+    // whose state is known to be applied, null once any of that state is set by other means.
+    std::unordered_map<uint64_t, PipelineStateObject*> pso_cache;
+    std::unordered_map<uint64_t, uint32_t>             pso_diffs;
+    PipelineStateObject*                               current_pso = nullptr;
+    uint32_t                                           next_pso_id = 1;
+    // Small ids for every distinct blend description a PSO was created with, for sort keys.
+    std::unordered_map<uint64_t, uint32_t>             blend_ids;
+
+    // Samplers by normalized description hash.
+    std::unordered_map<uint64_t, SamplerState*>        sampler_cache;
+
+    ResourcePool<Shader>            shader_pool;
+    ResourcePool<ShaderProgram>     shader_program_pool;
+    ResourcePool<VertexBuffer>      vertex_buffer_pool;
+    ResourcePool<IndexBuffer>       index_buffer_pool;
+    ResourcePool<UniformBuffer>     uniform_buffer_pool;
+    ResourcePool<UniformRingBuffer> uniform_ring_buffer_pool;
+    ResourcePool<Texture1D>         texture_1d_pool;
+    ResourcePool<Texture2D>         texture_2d_pool;
+    ResourcePool<Texture2DArray>    texture_2d_array_pool;
+    ResourcePool<Texture3D>         texture_3d_pool;
+    ResourcePool<TextureCube>       texture_cube_pool;
+    ResourcePool<VertexArray>       vertex_array_pool;
+    ResourcePool<SamplerState>      sampler_state_pool;
+    ResourcePool<Framebuffer>       framebuffer_pool;
+    ResourcePool<StagingBuffer>     staging_buffer_pool;
+    ResourcePool<StorageBuffer>     storage_buffer_pool;
 };
 
 //#endif
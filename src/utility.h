@@ -4,14 +4,33 @@
 #include <vector>
 #include <sstream>
 #include <cassert>
+#include <stdint.h>
 
 using String = std::string;
 using StringList = std::vector<std::string>;
 using PositionList = std::vector<size_t>;
 
+#define FNV1A_64_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV1A_64_PRIME        0x100000001b3ULL
+
 namespace Utility
 {
 	extern bool ReadText(std::string path, std::string& out);
+
+    // 64-bit FNV-1a. Pass the previous result as the seed to hash several buffers as one.
+    inline uint64_t hash_fnv1a(const void* data, size_t size, uint64_t seed = FNV1A_64_OFFSET_BASIS)
+    {
+        const uint8_t* bytes = (const uint8_t*)data;
+        uint64_t hash = seed;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= FNV1A_64_PRIME;
+        }
+
+        return hash;
+    }
     
     inline int find(std::string _keyword, std::string _source, int _startIndex = -1)
     {
@@ -140,84 +159,5 @@ namespace Utility
         
         return positions;
     }
-    
-    inline String GenerateSource(String source, StringList defines)
-    {
-        String result = "";
-        String remaining = source;
-        
-        while (true)
-        {
-            bool is_ifndef = false;
-            size_t pos = remaining.find("#ifdef ");
-            size_t ndef_pos = remaining.find("#ifndef ");
-            
-            if (ndef_pos < pos)
-            {
-                is_ifndef = true;
-                pos = ndef_pos;
-            }
-            
-            if (pos != std::string::npos)
-            {
-                if (pos != 0)
-                    result += remaining.substr(0, pos - 1);
-                
-                remaining = remaining.substr(pos, remaining.size() - pos);
-                
-                size_t new_line_pos = remaining.find_first_of('\n');
-                String line = remaining.substr(0, new_line_pos);
-                
-                StringList tokens = Split(line, ' ');
-                
-                size_t else_pos = remaining.find("#else");
-                size_t endif_pos = remaining.find("#endif");
-                bool has_else = false;
-                
-                // Assert to ensure this is a valid source file.
-                assert(endif_pos != std::string::npos);
-                // Find if 'else' exists
-                if (else_pos != std::string::npos && else_pos < endif_pos)
-                {
-                    has_else = true;
-                }
-                
-                bool cond;
-                
-                if (is_ifndef)
-                    cond = !DefineExists(tokens[1], defines);
-                else
-                    cond = DefineExists(tokens[1], defines);
-                
-                if (cond)
-                {
-                    if (has_else)
-                    {
-                        result += remaining.substr(new_line_pos + 1, (else_pos - 1) - (new_line_pos + 1));
-                    }
-                    else
-                    {
-                        result += remaining.substr(new_line_pos + 1, endif_pos - (new_line_pos + 1));
-                    }
-                }
-                else
-                {
-                    if (has_else)
-                    {
-                        result += remaining.substr(else_pos + 5, (endif_pos - 1) - (else_pos + 5));
-                    }
-                }
-                
-                remaining = remaining.substr(endif_pos + 6, remaining.size() - (endif_pos + 6));
-            }
-            else
-            {
-                result += remaining;
-                break;
-            }
-        }
-        
-        return result;
-    }
 }
 
@@ -0,0 +1,446 @@
+#include "BlockEncoder.h"
+
+#include <math.h>
+#include <float.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_ENCODER_SSE2
+#include <emmintrin.h>
+#endif
+
+// Structure-of-arrays, so that four pixels of a channel fit in one SSE register.
+struct BlockPixels
+{
+	float channels[4][16];
+};
+
+static const int kBC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static inline float clamp_unorm8(float v)
+{
+	return v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v);
+}
+
+static void load_block(const uint8_t* rgba, BlockPixels& pixels)
+{
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 4; c++)
+			pixels.channels[c][i] = rgba[i * 4 + c];
+	}
+}
+
+// Picks the nearest palette entry for every pixel, comparing num_channels channels starting at
+// first_channel.
+static void select_indices(const BlockPixels& pixels, const float palette[][4], int palette_size, int first_channel, int num_channels, uint8_t* indices)
+{
+#if defined(BLOCK_ENCODER_SSE2)
+	for (int i = 0; i < 16; i += 4)
+	{
+		__m128 best_error = _mm_set1_ps(FLT_MAX);
+		__m128 best_index = _mm_setzero_ps();
+
+		for (int p = 0; p < palette_size; p++)
+		{
+			__m128 error = _mm_setzero_ps();
+
+			for (int c = first_channel; c < first_channel + num_channels; c++)
+			{
+				__m128 d = _mm_sub_ps(_mm_loadu_ps(&pixels.channels[c][i]), _mm_set1_ps(palette[p][c]));
+				error = _mm_add_ps(error, _mm_mul_ps(d, d));
+			}
+
+			__m128 closer = _mm_cmplt_ps(error, best_error);
+
+			best_error = _mm_min_ps(error, best_error);
+			best_index = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps((float)p)), _mm_andnot_ps(closer, best_index));
+		}
+
+		int32_t result[4];
+		_mm_storeu_si128((__m128i*)result, _mm_cvtps_epi32(best_index));
+
+		for (int k = 0; k < 4; k++)
+			indices[i + k] = (uint8_t)result[k];
+	}
+#else
+	for (int i = 0; i < 16; i++)
+	{
+		float best_error = FLT_MAX;
+
+		for (int p = 0; p < palette_size; p++)
+		{
+			float error = 0.0f;
+
+			for (int c = first_channel; c < first_channel + num_channels; c++)
+			{
+				float d = pixels.channels[c][i] - palette[p][c];
+				error += d * d;
+			}
+
+			if (error < best_error)
+			{
+				best_error = error;
+				indices[i] = (uint8_t)p;
+			}
+		}
+	}
+#endif
+}
+
+// Fits a line through the block along its principal axis and returns the extremes of the
+// projected pixels. e1 is the end the axis points towards.
+static void fit_endpoints(const BlockPixels& pixels, int num_channels, float e0[4], float e1[4])
+{
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float cov[4][4];
+
+	memset(cov, 0, sizeof(cov));
+
+	for (int c = 0; c < num_channels; c++)
+	{
+		for (int i = 0; i < 16; i++)
+			mean[c] += pixels.channels[c][i];
+
+		mean[c] /= 16.0f;
+	}
+
+	for (int i = 0; i < 16; i++)
+	{
+		for (int a = 0; a < num_channels; a++)
+		{
+			for (int b = 0; b < num_channels; b++)
+				cov[a][b] += (pixels.channels[a][i] - mean[a]) * (pixels.channels[b][i] - mean[b]);
+		}
+	}
+
+	// Power iteration, seeded with the row of the channel with the largest variance.
+	int seed = 0;
+
+	for (int c = 1; c < num_channels; c++)
+	{
+		if (cov[c][c] > cov[seed][seed])
+			seed = c;
+	}
+
+	float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	for (int c = 0; c < num_channels; c++)
+		axis[c] = cov[seed][c];
+
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float norm = 0.0f;
+
+		for (int a = 0; a < num_channels; a++)
+		{
+			for (int b = 0; b < num_channels; b++)
+				next[a] += cov[a][b] * axis[b];
+
+			norm = fmaxf(norm, fabsf(next[a]));
+		}
+
+		if (norm < 1e-6f)
+			break;
+
+		for (int c = 0; c < num_channels; c++)
+			axis[c] = next[c] / norm;
+	}
+
+	float length = 0.0f;
+
+	for (int c = 0; c < num_channels; c++)
+		length += axis[c] * axis[c];
+
+	length = sqrtf(length);
+
+	for (int c = 0; c < 4; c++)
+	{
+		e0[c] = c < num_channels ? mean[c] : 0.0f;
+		e1[c] = e0[c];
+	}
+
+	// Uniform block.
+	if (length < 1e-6f)
+		return;
+
+	float t_min = FLT_MAX;
+	float t_max = -FLT_MAX;
+
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+
+		for (int c = 0; c < num_channels; c++)
+			t += (pixels.channels[c][i] - mean[c]) * axis[c] / length;
+
+		t_min = fminf(t_min, t);
+		t_max = fmaxf(t_max, t);
+	}
+
+	for (int c = 0; c < num_channels; c++)
+	{
+		e0[c] = clamp_unorm8(mean[c] + axis[c] / length * t_min);
+		e1[c] = clamp_unorm8(mean[c] + axis[c] / length * t_max);
+	}
+}
+
+static inline uint16_t pack_565(const float c[4])
+{
+	uint16_t r = (uint16_t)(c[0] * 31.0f / 255.0f + 0.5f);
+	uint16_t g = (uint16_t)(c[1] * 63.0f / 255.0f + 0.5f);
+	uint16_t b = (uint16_t)(c[2] * 31.0f / 255.0f + 0.5f);
+
+	return (r << 11) | (g << 5) | b;
+}
+
+static inline void unpack_565(uint16_t v, float c[4])
+{
+	uint32_t r = (v >> 11) & 31;
+	uint32_t g = (v >> 5) & 63;
+	uint32_t b = v & 31;
+
+	c[0] = (float)((r << 3) | (r >> 2));
+	c[1] = (float)((g << 2) | (g >> 4));
+	c[2] = (float)((b << 3) | (b >> 2));
+	c[3] = 255.0f;
+}
+
+static void encode_bc1_color(const BlockPixels& pixels, uint8_t* block)
+{
+	float e0[4], e1[4];
+	fit_endpoints(pixels, 3, e0, e1);
+
+	uint16_t c0 = pack_565(e1);
+	uint16_t c1 = pack_565(e0);
+
+	// c0 > c1 selects the four color mode.
+	if (c0 < c1)
+	{
+		uint16_t temp = c0;
+		c0 = c1;
+		c1 = temp;
+	}
+
+	uint8_t indices[16];
+	memset(indices, 0, sizeof(indices));
+
+	if (c0 != c1)
+	{
+		float palette[4][4];
+
+		unpack_565(c0, palette[0]);
+		unpack_565(c1, palette[1]);
+
+		for (int c = 0; c < 4; c++)
+		{
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+
+		select_indices(pixels, palette, 4, 0, 3, indices);
+	}
+
+	uint32_t bits = 0;
+
+	for (int i = 0; i < 16; i++)
+		bits |= uint32_t(indices[i]) << (i * 2);
+
+	block[0] = c0 & 0xFF;
+	block[1] = c0 >> 8;
+	block[2] = c1 & 0xFF;
+	block[3] = c1 >> 8;
+
+	for (int i = 0; i < 4; i++)
+		block[4 + i] = (bits >> (i * 8)) & 0xFF;
+}
+
+static void encode_bc4_channel(const BlockPixels& pixels, int channel, uint8_t* block)
+{
+	float min_value = 255.0f;
+	float max_value = 0.0f;
+
+	for (int i = 0; i < 16; i++)
+	{
+		min_value = fminf(min_value, pixels.channels[channel][i]);
+		max_value = fmaxf(max_value, pixels.channels[channel][i]);
+	}
+
+	uint8_t r0 = (uint8_t)(max_value + 0.5f);
+	uint8_t r1 = (uint8_t)(min_value + 0.5f);
+
+	uint8_t indices[16];
+	memset(indices, 0, sizeof(indices));
+
+	// r0 > r1 selects the eight value mode.
+	if (r0 > r1)
+	{
+		float palette[8][4];
+
+		palette[0][channel] = r0;
+		palette[1][channel] = r1;
+
+		for (int i = 2; i < 8; i++)
+			palette[i][channel] = ((8 - i) * r0 + (i - 1) * r1) / 7.0f;
+
+		select_indices(pixels, palette, 8, channel, 1, indices);
+	}
+
+	uint64_t bits = 0;
+
+	for (int i = 0; i < 16; i++)
+		bits |= uint64_t(indices[i]) << (i * 3);
+
+	block[0] = r0;
+	block[1] = r1;
+
+	for (int i = 0; i < 6; i++)
+		block[2 + i] = (bits >> (i * 8)) & 0xFF;
+}
+
+struct BitWriter
+{
+	uint8_t* data;
+	uint32_t pos;
+
+	inline void write(uint32_t value, uint32_t bits)
+	{
+		for (uint32_t i = 0; i < bits; i++, pos++)
+		{
+			if ((value >> i) & 1)
+				data[pos >> 3] |= 1 << (pos & 7);
+		}
+	}
+};
+
+// Mode 6 endpoints are 7 bits per channel plus a p-bit shared by all channels of the endpoint.
+static void quantize_bc7_endpoint(const float e[4], uint8_t q[4], uint8_t& p)
+{
+	float best_error = FLT_MAX;
+
+	for (int pbit = 0; pbit < 2; pbit++)
+	{
+		uint8_t candidate[4];
+		float error = 0.0f;
+
+		for (int c = 0; c < 4; c++)
+		{
+			int v = (int)floorf((e[c] - pbit) * 0.5f + 0.5f);
+			v = v < 0 ? 0 : (v > 127 ? 127 : v);
+
+			candidate[c] = (uint8_t)v;
+
+			float d = (float)((v << 1) | pbit) - e[c];
+			error += d * d;
+		}
+
+		if (error < best_error)
+		{
+			best_error = error;
+			memcpy(q, candidate, 4);
+			p = (uint8_t)pbit;
+		}
+	}
+}
+
+namespace BlockEncoder
+{
+	void encode_bc1(const uint8_t* rgba, uint8_t* block)
+	{
+		BlockPixels pixels;
+		load_block(rgba, pixels);
+		encode_bc1_color(pixels, block);
+	}
+
+	void encode_bc3(const uint8_t* rgba, uint8_t* block)
+	{
+		BlockPixels pixels;
+		load_block(rgba, pixels);
+		encode_bc4_channel(pixels, 3, block);
+		encode_bc1_color(pixels, block + 8);
+	}
+
+	void encode_bc4(const uint8_t* rgba, uint8_t* block)
+	{
+		BlockPixels pixels;
+		load_block(rgba, pixels);
+		encode_bc4_channel(pixels, 0, block);
+	}
+
+	void encode_bc5(const uint8_t* rgba, uint8_t* block)
+	{
+		BlockPixels pixels;
+		load_block(rgba, pixels);
+		encode_bc4_channel(pixels, 0, block);
+		encode_bc4_channel(pixels, 1, block + 8);
+	}
+
+	void encode_bc7(const uint8_t* rgba, uint8_t* block)
+	{
+		BlockPixels pixels;
+		load_block(rgba, pixels);
+
+		float e0[4], e1[4];
+		fit_endpoints(pixels, 4, e0, e1);
+
+		uint8_t q0[4], q1[4];
+		uint8_t p0, p1;
+
+		quantize_bc7_endpoint(e0, q0, p0);
+		quantize_bc7_endpoint(e1, q1, p1);
+
+		float palette[16][4];
+
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				int a = (q0[c] << 1) | p0;
+				int b = (q1[c] << 1) | p1;
+
+				palette[i][c] = (float)(((64 - kBC7Weights4[i]) * a + kBC7Weights4[i] * b + 32) >> 6);
+			}
+		}
+
+		uint8_t indices[16];
+		select_indices(pixels, palette, 16, 0, 4, indices);
+
+		// The MSB of the first index is implicit and must be zero, swap the endpoints if it is not.
+		if (indices[0] & 8)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				uint8_t temp = q0[c];
+				q0[c] = q1[c];
+				q1[c] = temp;
+			}
+
+			uint8_t temp = p0;
+			p0 = p1;
+			p1 = temp;
+
+			for (int i = 0; i < 16; i++)
+				indices[i] = 15 - indices[i];
+		}
+
+		memset(block, 0, BC7_BLOCK_SIZE);
+
+		BitWriter writer = { block, 0 };
+
+		writer.write(1 << 6, 7);
+
+		for (int c = 0; c < 4; c++)
+		{
+			writer.write(q0[c], 7);
+			writer.write(q1[c], 7);
+		}
+
+		writer.write(p0, 1);
+		writer.write(p1, 1);
+		writer.write(indices[0], 3);
+
+		for (int i = 1; i < 16; i++)
+			writer.write(indices[i], 4);
+	}
+}
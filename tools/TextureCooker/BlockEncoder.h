@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// Block encoders for the BCn formats supported by the RenderDevice. Every encoder takes a single
+// 4x4 block of RGBA8 pixels in row-major order and writes one compressed block.
+//
+// Endpoints are fitted along the principal axis of the block and indices are picked by exhaustive
+// nearest-palette search, which is vectorized with SSE2 where available. BC7 only uses mode 6
+// (one subset, RGBA, 4-bit indices): fast and good on smooth content, weaker on blocks with
+// several distinct colors.
+
+#define BC1_BLOCK_SIZE 8
+#define BC3_BLOCK_SIZE 16
+#define BC4_BLOCK_SIZE 8
+#define BC5_BLOCK_SIZE 16
+#define BC7_BLOCK_SIZE 16
+
+namespace BlockEncoder
+{
+    extern void encode_bc1(const uint8_t* rgba, uint8_t* block);
+    extern void encode_bc3(const uint8_t* rgba, uint8_t* block);
+    extern void encode_bc4(const uint8_t* rgba, uint8_t* block);
+    extern void encode_bc5(const uint8_t* rgba, uint8_t* block);
+    extern void encode_bc7(const uint8_t* rgba, uint8_t* block);
+}
@@ -0,0 +1,305 @@
+// Converts source images into pre-mipped, pre-compressed TextureFile containers for the
+// TextureStreamer.
+//
+// Usage: TextureCooker <input> <output> [--format bc1|bc3|bc4|bc5|bc7|rgba8] [--srgb] [--no-mips] [--threads N]
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "BlockEncoder.h"
+#include "TextureFile.h"
+#include "gfx_enums.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+struct CookFormat
+{
+	const char* name;
+	uint32_t    format;
+	uint32_t    srgb_format; // UINT32_MAX if there is no sRGB variant.
+	uint32_t    block_size;  // 0 for uncompressed RGBA8.
+	void        (*encode)(const uint8_t* rgba, uint8_t* block);
+};
+
+static const CookFormat kCookFormats[] =
+{
+	{ "bc1",   TextureFormat::BC1_UNORM,      TextureFormat::BC1_UNORM_SRGB,      BC1_BLOCK_SIZE, BlockEncoder::encode_bc1 },
+	{ "bc3",   TextureFormat::BC3_UNORM,      TextureFormat::BC3_UNORM_SRGB,      BC3_BLOCK_SIZE, BlockEncoder::encode_bc3 },
+	{ "bc4",   TextureFormat::BC4_UNORM,      UINT32_MAX,                         BC4_BLOCK_SIZE, BlockEncoder::encode_bc4 },
+	{ "bc5",   TextureFormat::BC5_UNORM,      UINT32_MAX,                         BC5_BLOCK_SIZE, BlockEncoder::encode_bc5 },
+	{ "bc7",   TextureFormat::BC7_UNORM,      TextureFormat::BC7_UNORM_SRGB,      BC7_BLOCK_SIZE, BlockEncoder::encode_bc7 },
+	{ "rgba8", TextureFormat::R8G8B8A8_UNORM, TextureFormat::R8G8B8A8_UNORM_SRGB, 0,              nullptr }
+};
+
+struct MipLevel
+{
+	uint32_t             width;
+	uint32_t             height;
+	std::vector<uint8_t> pixels;  // RGBA8
+	std::vector<uint8_t> encoded;
+};
+
+static float srgb_to_linear(float v)
+{
+	return v <= 0.04045f ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linear_to_srgb(float v)
+{
+	return v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+}
+
+// 2x2 box filter. Color channels are averaged in linear space for sRGB textures.
+static void downsample(const MipLevel& src, MipLevel& dst, bool srgb)
+{
+	static float s_linear[256];
+	static bool s_linear_ready = false;
+
+	if (!s_linear_ready)
+	{
+		for (int i = 0; i < 256; i++)
+			s_linear[i] = srgb_to_linear(i / 255.0f);
+
+		s_linear_ready = true;
+	}
+
+	dst.width = src.width > 1 ? src.width / 2 : 1;
+	dst.height = src.height > 1 ? src.height / 2 : 1;
+	dst.pixels.resize(dst.width * dst.height * 4);
+
+	for (uint32_t y = 0; y < dst.height; y++)
+	{
+		for (uint32_t x = 0; x < dst.width; x++)
+		{
+			uint32_t x0 = x * 2, x1 = x0 + 1 < src.width ? x0 + 1 : x0;
+			uint32_t y0 = y * 2, y1 = y0 + 1 < src.height ? y0 + 1 : y0;
+
+			const uint8_t* p[4] = { &src.pixels[(y0 * src.width + x0) * 4], &src.pixels[(y0 * src.width + x1) * 4],
+									&src.pixels[(y1 * src.width + x0) * 4], &src.pixels[(y1 * src.width + x1) * 4] };
+
+			for (int c = 0; c < 4; c++)
+			{
+				float value;
+
+				if (srgb && c < 3)
+					value = linear_to_srgb((s_linear[p[0][c]] + s_linear[p[1][c]] + s_linear[p[2][c]] + s_linear[p[3][c]]) * 0.25f) * 255.0f;
+				else
+					value = (p[0][c] + p[1][c] + p[2][c] + p[3][c]) * 0.25f;
+
+				dst.pixels[(y * dst.width + x) * 4 + c] = (uint8_t)(value + 0.5f);
+			}
+		}
+	}
+}
+
+// Encodes one row of blocks, replicating edge pixels for sizes that are not a multiple of 4.
+static void encode_block_row(MipLevel& level, const CookFormat& format, uint32_t block_y)
+{
+	uint32_t blocks_x = (level.width + 3) / 4;
+	uint8_t rgba[64];
+
+	for (uint32_t block_x = 0; block_x < blocks_x; block_x++)
+	{
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			uint32_t x = block_x * 4 + (i & 3);
+			uint32_t y = block_y * 4 + (i >> 2);
+
+			x = x < level.width ? x : level.width - 1;
+			y = y < level.height ? y : level.height - 1;
+
+			memcpy(&rgba[i * 4], &level.pixels[(y * level.width + x) * 4], 4);
+		}
+
+		format.encode(rgba, &level.encoded[(block_y * blocks_x + block_x) * format.block_size]);
+	}
+}
+
+static void print_usage()
+{
+	printf("Usage: TextureCooker <input> <output> [--format bc1|bc3|bc4|bc5|bc7|rgba8] [--srgb] [--no-mips] [--threads N]\n");
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		print_usage();
+		return 1;
+	}
+
+	const char* input = argv[1];
+	const char* output = argv[2];
+	const CookFormat* format = &kCookFormats[4];
+	bool srgb = false;
+	bool mips = true;
+	uint32_t num_threads = std::thread::hardware_concurrency();
+
+	for (int i = 3; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			format = nullptr;
+
+			for (size_t j = 0; j < sizeof(kCookFormats) / sizeof(CookFormat); j++)
+			{
+				if (strcmp(kCookFormats[j].name, name) == 0)
+					format = &kCookFormats[j];
+			}
+
+			if (!format)
+			{
+				printf("Unknown format : %s\n", name);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--srgb") == 0)
+			srgb = true;
+		else if (strcmp(argv[i], "--no-mips") == 0)
+			mips = false;
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			num_threads = (uint32_t)atoi(argv[++i]);
+		else
+		{
+			print_usage();
+			return 1;
+		}
+	}
+
+	if (srgb && format->srgb_format == UINT32_MAX)
+	{
+		printf("Format %s has no sRGB variant\n", format->name);
+		return 1;
+	}
+
+	if (num_threads == 0)
+		num_threads = 1;
+
+	int width, height, channels;
+	stbi_uc* image = stbi_load(input, &width, &height, &channels, 4);
+
+	if (!image)
+	{
+		printf("Failed to load %s : %s\n", input, stbi_failure_reason());
+		return 1;
+	}
+
+	if (width > 0xFFFF || height > 0xFFFF)
+	{
+		printf("Image is too large : %dx%d\n", width, height);
+		stbi_image_free(image);
+		return 1;
+	}
+
+	std::vector<MipLevel> levels(1);
+
+	levels[0].width = width;
+	levels[0].height = height;
+	levels[0].pixels.assign(image, image + width * height * 4);
+
+	stbi_image_free(image);
+
+	while (mips && levels.size() < MAX_TEXTURE_FILE_MIPS && (levels.back().width > 1 || levels.back().height > 1))
+	{
+		levels.push_back(MipLevel());
+		downsample(levels[levels.size() - 2], levels.back(), srgb);
+	}
+
+	// Every row of blocks of every mip is an independent job.
+	struct Job
+	{
+		uint32_t level;
+		uint32_t block_y;
+	};
+
+	std::vector<Job> jobs;
+
+	for (uint32_t i = 0; i < levels.size(); i++)
+	{
+		MipLevel& level = levels[i];
+
+		if (format->block_size == 0)
+		{
+			level.encoded = level.pixels;
+			continue;
+		}
+
+		uint32_t blocks_y = (level.height + 3) / 4;
+		level.encoded.resize(((level.width + 3) / 4) * blocks_y * format->block_size);
+
+		for (uint32_t y = 0; y < blocks_y; y++)
+			jobs.push_back({ i, y });
+	}
+
+	std::atomic<uint32_t> next_job(0);
+	std::vector<std::thread> workers;
+
+	for (uint32_t i = 0; i < num_threads; i++)
+	{
+		workers.push_back(std::thread([&]()
+		{
+			uint32_t job;
+
+			while ((job = next_job.fetch_add(1)) < jobs.size())
+				encode_block_row(levels[jobs[job].level], *format, jobs[job].block_y);
+		}));
+	}
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	TextureFileHeader header;
+	memset(&header, 0, sizeof(TextureFileHeader));
+
+	header.magic = TEXTURE_FILE_MAGIC;
+	header.version = TEXTURE_FILE_VERSION;
+	header.format = srgb ? format->srgb_format : format->format;
+	header.width = (uint16_t)width;
+	header.height = (uint16_t)height;
+	header.mip_levels = (uint32_t)levels.size();
+
+	uint64_t offset = sizeof(TextureFileHeader);
+
+	for (uint32_t i = 0; i < levels.size(); i++)
+	{
+		header.mips[i].offset = offset;
+		header.mips[i].size = (uint32_t)levels[i].encoded.size();
+		header.mips[i].width = (uint16_t)levels[i].width;
+		header.mips[i].height = (uint16_t)levels[i].height;
+
+		offset += levels[i].encoded.size();
+	}
+
+	FILE* file = fopen(output, "wb");
+
+	if (!file)
+	{
+		printf("Failed to open %s for writing\n", output);
+		return 1;
+	}
+
+	bool success = fwrite(&header, sizeof(TextureFileHeader), 1, file) == 1;
+
+	for (uint32_t i = 0; i < levels.size() && success; i++)
+		success = fwrite(levels[i].encoded.data(), 1, levels[i].encoded.size(), file) == levels[i].encoded.size();
+
+	fclose(file);
+
+	if (!success)
+	{
+		printf("Failed to write %s\n", output);
+		return 1;
+	}
+
+	printf("Cooked %s : %dx%d, %u mips, %s%s, %llu bytes\n", output, width, height, header.mip_levels, format->name, srgb ? " (sRGB)" : "", (unsigned long long)offset);
+
+	return 0;
+}